@@ -0,0 +1,33 @@
+#!/bin/bash
+#
+# Throughput scaling of the SO_REUSEPORT multi-reactor mode.
+# Runs the server with 1..MAX_WORKERS event loops and drives each run with
+# werewolf_loadgen, printing one "workers msgs/sec" row per run.
+#
+# Usage: ./bench_scaling.sh [max_workers] [connections] [seconds]
+
+MAX_WORKERS=${1:-$(nproc)}
+CONNECTIONS=${2:-960}
+SECONDS_PER_RUN=${3:-5}
+PORT=${PORT:-8090}
+PLAYERS=6
+
+make -s server loadgen || exit 1
+
+SERVER=./build/server/werewolf_server
+LOADGEN=./build/loadgen/werewolf_loadgen
+
+printf "%-8s %-12s\n" "workers" "msgs/sec"
+for workers in $(seq 1 "$MAX_WORKERS"); do
+    $SERVER -w "$workers" "$PORT" "$PLAYERS" > /dev/null 2>&1 &
+    server_pid=$!
+    sleep 0.5
+
+    result=$($LOADGEN -c "$CONNECTIONS" -t "$workers" -p "$PLAYERS" -d "$SECONDS_PER_RUN" 127.0.0.1 "$PORT")
+    rate=$(echo "$result" | sed -n 's/.*msgs_per_sec=\([0-9]*\).*/\1/p')
+    printf "%-8s %-12s\n" "$workers" "${rate:-failed}"
+
+    kill "$server_pid" 2>/dev/null
+    wait "$server_pid" 2>/dev/null
+done
+exit 0
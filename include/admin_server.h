@@ -0,0 +1,16 @@
+#ifndef __admin_server_h__
+#define __admin_server_h__
+
+/*
+ * Local admin listener on its own thread: answers every HTTP request with
+ * the metrics in Prometheus text format, so scrapes never run on a game
+ * event loop. Binds to the loopback address only.
+ */
+int admin_server_start(const char *port);
+
+// Writes the latency percentiles to stderr whenever the process gets SIGUSR1.
+// Call from the main thread before starting any other thread: it blocks the
+// signal, and threads inherit that, so only the dump thread ever receives it.
+int admin_dump_on_sigusr1(void);
+
+#endif // __admin_server_h__
@@ -0,0 +1,31 @@
+#ifndef __arena_h__
+#define __arena_h__
+
+#include <stddef.h>
+
+/*
+ * Fixed-size bump allocator. Everything a room needs for its whole life is
+ * carved out of one block sized when the room opens, and the block is freed
+ * in one go when the room closes; nothing is freed on its own. Short-lived
+ * scratch is taken between arena_mark() and arena_rewind().
+ */
+#define ARENA_ALIGNMENT 16
+
+typedef struct arena_cdt *arena_t;
+
+// Space an allocation of size takes, for sizing an arena up front
+size_t arena_footprint(size_t size);
+
+arena_t arena_create(size_t capacity);
+void arena_destroy(arena_t arena);
+
+// Zeroed and aligned to ARENA_ALIGNMENT; NULL once the arena is full
+void *arena_alloc(arena_t arena, size_t size);
+// Scratch: allocations made after a mark are dropped by rewinding to it
+size_t arena_mark(arena_t arena);
+void arena_rewind(arena_t arena, size_t mark);
+
+size_t arena_used(arena_t arena);
+size_t arena_capacity(arena_t arena);
+
+#endif // __arena_h__
@@ -0,0 +1,42 @@
+#ifndef __bitset_h__
+#define __bitset_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Growable set of small integers (seat slots), one bit each. All zeroes is
+ * an empty set; setting a bit past the end grows it, so there is no fixed
+ * member cap. Membership changes are a single word operation.
+ */
+typedef struct {
+    uint64_t *words;
+    int word_count;
+    bool fixed;         // Words are borrowed (e.g. from an arena) and never grow
+} bitset_t;
+
+#define BITSET_WORDS(bits) (((bits) + 63) / 64)
+
+// Pre-sizes the set to hold bits [0, bits) so later sets cannot fail
+int bitset_reserve(bitset_t *set, int bits);
+// Empty set over BITSET_WORDS(bits) caller-owned words; setting a bit past
+// them fails instead of growing
+void bitset_init_fixed(bitset_t *set, uint64_t *words, int bits);
+void bitset_free(bitset_t *set);
+
+int bitset_set(bitset_t *set, int bit);
+void bitset_clear(bitset_t *set, int bit);
+bool bitset_test(const bitset_t *set, int bit);
+void bitset_clear_all(bitset_t *set);
+int bitset_count(const bitset_t *set);
+
+// Lowest set bit >= from, or -1. Iterate with
+// for (int b = bitset_next(s, 0); b >= 0; b = bitset_next(s, b + 1))
+int bitset_next(const bitset_t *set, int from);
+
+// Set algebra: dst = a op b. dst may alias a or b.
+int bitset_and(bitset_t *dst, const bitset_t *a, const bitset_t *b);
+int bitset_or(bitset_t *dst, const bitset_t *a, const bitset_t *b);
+int bitset_and_not(bitset_t *dst, const bitset_t *a, const bitset_t *b);
+
+#endif // __bitset_h__
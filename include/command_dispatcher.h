@@ -12,9 +12,15 @@ typedef struct {
     void *arg2;
 } command_t;
 
+// Outgoing commands switch to binary records (see wire.h) once the server
+// accepts the handshake; until then they go out as text lines
+void set_wire_version(int version);
+void send_chat(int sockfd, const char *message);
+
 void dispatch_command(const char *command, int sockfd, void *arg1, void *arg2);
 void help_command(int sockfd, void *arg1, void *arg2);
 void whisper_command(int sockfd, void *arg1, void *arg2);
 void ww_command(int sockfd, void *arg1, void *arg2);
+void vote_command(int sockfd, void *arg1, void *arg2);
 
 #endif
\ No newline at end of file
@@ -1,7 +1,13 @@
 #ifndef __command_handler_h__
 #define __command_handler_h__
-#include "game_manager.h"
+#include "room_registry.h"
+#include "wire.h"
 
-int handle_if_command(const char *buffer, int client_socket, game_manager_t game_manager);
+// Handles /whisper, /vote and /ww. Returns 1 if buffer was a command (even a
+// malformed one), 0 if it is plain chat, RET_ERROR on bad arguments.
+int handle_if_command(const char *buffer, int client_socket, room_t *room);
+// The same commands from a binary protocol record (see wire.h). Same return
+// values; a MESSAGE record on the chat channel is plain chat.
+int handle_wire_command(const wire_record_t *record, int client_socket, room_t *room);
 
 #endif
@@ -5,6 +5,5 @@
 #define RET_SUCCESS 0
 
 #define BUFFER_SIZE 1024
-#define MAX_SUBSCRIPTIONS 16
 
 #endif // __defs_h__
@@ -0,0 +1,42 @@
+#ifndef __event_loop_h__
+#define __event_loop_h__
+
+#include <stdint.h>
+
+/* Interest / readiness flags */
+#define EVENT_READ  0x01
+#define EVENT_WRITE 0x02
+#define EVENT_HUP   0x04
+#define EVENT_ERROR 0x08
+
+#define EVENT_LOOP_MAX_EVENTS 256
+
+typedef struct {
+    int fd;
+    uint32_t events;
+} event_t;
+
+typedef struct event_loop_cdt *event_loop_t;
+
+/*
+ * Readiness multiplexer used by the server main loop.
+ * The default backend is epoll in edge-triggered mode: callers must drain a
+ * ready fd until EAGAIN before waiting again. Building with USE_SELECT=1
+ * swaps in a select() backend with the same API (level-triggered, capped at
+ * FD_SETSIZE) so both can be compared under the same workload.
+ */
+event_loop_t event_loop_create(void);
+void event_loop_destroy(event_loop_t loop);
+
+int event_loop_add(event_loop_t loop, int fd, uint32_t events);
+// Replaces the interest set of a watched fd, e.g. to add EVENT_WRITE only
+// while output is pending
+int event_loop_modify(event_loop_t loop, int fd, uint32_t events);
+int event_loop_remove(event_loop_t loop, int fd);
+
+// Returns the number of ready events written to `events`, or -1 on error
+int event_loop_wait(event_loop_t loop, event_t *events, int max_events, int timeout_ms);
+
+const char *event_loop_backend(void);
+
+#endif // __event_loop_h__
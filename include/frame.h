@@ -0,0 +1,44 @@
+#ifndef __frame_h__
+#define __frame_h__
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "defs.h"
+
+/*
+ * Wire framing, both directions: a 2 byte big-endian payload length followed
+ * by the payload. Payloads are text without a trailing NUL.
+ */
+#define FRAME_HEADER_SIZE 2
+#define FRAME_MAX_PAYLOAD (BUFFER_SIZE - 1)
+#define FRAME_RING_SIZE 4096    // Power of two, holds at least one max frame
+
+void frame_encode_header(char header[FRAME_HEADER_SIZE], size_t len);
+
+// Writes header and payload with a single sendmsg()
+ssize_t frame_send(int fd, const void *payload, size_t len, int flags);
+
+/*
+ * Per-connection receive buffer. Bytes go in through frame_ring_reserve() +
+ * frame_ring_commit() (readv straight into the ring) or frame_ring_push()
+ * (copy), and come out as whole frames through frame_ring_next().
+ */
+typedef struct frame_ring_cdt *frame_ring_t;
+
+frame_ring_t frame_ring_create(void);
+void frame_ring_destroy(frame_ring_t ring);
+
+// Free space as up to two iovecs (two when it wraps); returns the count
+int frame_ring_reserve(frame_ring_t ring, struct iovec iov[2]);
+void frame_ring_commit(frame_ring_t ring, size_t len);
+// Copies up to len bytes in; returns how many fit
+size_t frame_ring_push(frame_ring_t ring, const void *data, size_t len);
+
+// Pops the next complete frame. Returns 1 and a NUL-terminated payload, 0 if
+// more bytes are needed, or RET_ERROR if the peer announced a frame larger
+// than FRAME_MAX_PAYLOAD. Frames that sit contiguously in the ring are
+// returned in place; the payload stays valid until the next call on the ring.
+int frame_ring_next(frame_ring_t ring, const char **payload, size_t *len);
+
+#endif // __frame_h__
@@ -0,0 +1,44 @@
+#ifndef __game_flow_h__
+#define __game_flow_h__
+
+#include "room_registry.h"
+
+/*
+ * Drives a room through its game: tells players what each phase expects,
+ * relays votes, and closes a phase once everyone with a vote has voted or
+ * its deadline (the room's phase_timer) passes. The rules themselves live
+ * in game_manager.
+ */
+
+// Phase deadlines. A phase whose votes are all in closes early.
+typedef struct {
+    int night_sec;          // Werewolves' kill vote
+    int day_sec;            // Discussion before the lynch vote opens
+    int voting_sec;
+} game_timing_t;
+
+extern const game_timing_t GAME_TIMING_STANDARD;
+extern const game_timing_t GAME_TIMING_SPEED;   // "Speed Werewolf"
+
+// Applies to every room; set before the workers start
+void game_flow_set_timing(const game_timing_t *timing);
+
+// Room arena scratch the flow needs at most at once (see room_t.arena)
+size_t game_flow_arena_size(int max_players);
+
+// Renders every "You are a <role>!" line once, for player numbers up to
+// max_players; call before the workers start. Without it they are formatted
+// per game.
+int game_flow_prerender(int max_players);
+
+// Assigns roles, tells every player theirs and opens the first night
+void game_flow_start(room_t *room);
+// /vote <player>; a vote during the day opens the lynch vote
+void game_flow_vote(room_t *room, int socket_id, int target_player_number);
+// Closes the current phase and announces what happened
+void game_flow_advance(room_t *room);
+// After anything that changes who is alive or who voted (e.g. a
+// disconnect): ends the game on a win, closes the phase once all votes are in
+void game_flow_check(room_t *room);
+
+#endif // __game_flow_h__
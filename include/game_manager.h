@@ -2,6 +2,11 @@
 #define __game_manager_h__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "bitset.h"
+#include "journal.h"
 
 // Game roles
 typedef enum {
@@ -23,14 +28,52 @@ typedef enum {
     GAME_STATE_ENDED
 } game_state_t;
 
+typedef enum {
+    TEAM_NONE = 0,
+    TEAM_VILLAGE,
+    TEAM_WEREWOLVES
+} game_team_t;
+
+typedef enum {
+    VOTE_ACCEPTED = 0,
+    VOTE_NOT_NOW,           // No vote is open in this phase
+    VOTE_NOT_ALLOWED,       // The voter is dead or has no vote this phase
+    VOTE_BAD_TARGET         // Not a living player the voter may pick
+} game_vote_result_t;
+
+// What closing a phase did
+typedef struct {
+    game_state_t closed_phase;
+    game_state_t phase;         // Phase the room is now in
+    int eliminated_socket;      // -1 when nobody died
+    int eliminated_number;
+    game_role_t eliminated_role;
+    game_team_t winner;
+} game_phase_result_t;
+
 typedef struct game_manager_cdt *game_manager_t;
 
-game_manager_t game_manager_create(int max_players);
+// Arena bytes one manager takes; it allocates nothing after creation
+size_t game_manager_arena_size(int max_players);
+// Lives in arena, which must hold game_manager_arena_size() more bytes and
+// outlive it. Destroying it only settles the metrics.
+game_manager_t game_manager_create(arena_t arena, int max_players);
 void game_manager_destroy(game_manager_t game_manager);
+// Role assignment is shuffled from a per-manager generator seeded from the
+// clock; a fixed seed replays the same deal
+void game_manager_seed(game_manager_t game_manager, uint64_t seed);
+// Records everything that changes this manager from here on as room's
+// events in journal, starting with its seed; NULL stops recording
+void game_manager_set_journal(game_manager_t game_manager, journal_t journal, int room);
+// Records a player command; its effects are recorded as they happen
+void game_manager_journal_command(game_manager_t game_manager, int socket_id, journal_command_t command,
+                                  int target_player_number, const char *text);
 
+// Returns the player's seat (0..max_players-1) or -1
 int game_manager_add_player(game_manager_t game_manager, int socket_id);
 int game_manager_remove_player(game_manager_t game_manager, int socket_id);
 int game_manager_get_player_count(game_manager_t game_manager);
+int game_manager_get_max_players(game_manager_t game_manager);
 int game_manager_get_alive_count(game_manager_t game_manager);
 
 game_role_t game_manager_get_player_role(game_manager_t game_manager, int socket_id);
@@ -40,9 +83,33 @@ bool game_manager_is_player_protected(game_manager_t game_manager, int socket_id
 bool game_manager_is_player_werewolf(game_manager_t game_manager, int socket_id);
 
 int game_manager_start_game(game_manager_t game_manager);
-int *game_manager_get_players_sockets(game_manager_t game_manager);
+// Fills player_sockets (room for the player count) in seat order; returns the count
+int game_manager_get_players_sockets(game_manager_t game_manager, int *player_sockets);
 game_state_t game_manager_get_phase(game_manager_t game_manager);
 
 int game_manager_get_player_number(game_manager_t game_manager, int socket_id);
 int game_manager_get_socket_by_player_number(game_manager_t game_manager, int player_number);
+
+// Seats are stable for as long as the player is in the room
+int game_manager_get_player_seat(game_manager_t game_manager, int socket_id);
+// seat -> socket_id (-1 when free), max_players entries
+const int *game_manager_get_seat_sockets(game_manager_t game_manager);
+// Seats of the living players, for combining with channel members
+const bitset_t *game_manager_get_alive_seats(game_manager_t game_manager);
+
+/*
+ * Phase engine. Werewolves vote on a kill at night (NIGHT -> DAY), the day
+ * opens a lynch vote (DAY -> VOTING -> NIGHT), and the room ends as soon as
+ * one team has won. Casting or changing a vote is O(1) at any room size; a
+ * tie or no votes eliminates nobody.
+ */
+game_vote_result_t game_manager_cast_vote(game_manager_t game_manager, int socket_id, int target_player_number);
+int game_manager_get_votes_for(game_manager_t game_manager, int player_number);
+// True once every player with a vote this phase has cast one
+bool game_manager_votes_complete(game_manager_t game_manager);
+// Closes the current phase, resolving its vote, and moves to the next one
+int game_manager_advance_phase(game_manager_t game_manager, game_phase_result_t *result);
+int game_manager_end_game(game_manager_t game_manager);
+// Read from the per-role alive counters
+game_team_t game_manager_get_winner(game_manager_t game_manager);
 #endif // __game_manager_h__
@@ -2,8 +2,10 @@
 #define __game_messanger_h__
 
 #include <stdbool.h>
+#include <sys/types.h>
 #include "game_manager.h"
 #include "defs.h"
+#include "bitset.h"
 
 typedef enum {
     CHANNEL_ANNOUNCEMENT,    // Server announcements
@@ -14,28 +16,110 @@ typedef enum {
     CHANNEL_COUNT
 } message_channel_t;
 
+// Members are seat slots (see game_manager_get_player_seat), one bit each
 typedef struct {
     message_channel_t channel;
-    int socket_ids[MAX_SUBSCRIPTIONS];
-    int subscription_count;
+    bitset_t members;
 } channel_subscription_t;
 
 // Message formatting and parsing
 const char *get_channel_color(message_channel_t channel);
 message_channel_t parse_message_channel(const char *message);
-char *format_message(message_channel_t channel, int player_number, const char *message);
-char *format_server_message(const char *message);
-int read_and_format_message(int socket_id, char *buffer, size_t buffer_size);
+// Write "[CHANNEL] Player n: message\n" or "[SERVER] message\n" into out,
+// NUL terminated and cut to fit size; return the length without the NUL
+size_t format_message(char *out, size_t size, message_channel_t channel, int player_number, const char *message);
+size_t format_server_message(char *out, size_t size, const char *message);
 
-// Message sending functions
+// Client side: the server's stream for one connection, decoded as it
+// arrives. A read may end mid-frame or carry many frames; the bytes of a
+// partial frame are kept for the next read.
+typedef struct message_decoder_cdt *message_decoder_t;
+
+// Room one rendered message may need, color codes included
+#define MESSAGE_RENDER_MAX (BUFFER_SIZE + 128)
+
+message_decoder_t message_decoder_create(void);
+void message_decoder_destroy(message_decoder_t decoder);
+// One readv() of what the socket has: bytes read, 0 once the server closed
+// the connection, or -1 with errno (EAGAIN when drained)
+ssize_t message_decoder_read(message_decoder_t decoder, int socket_id);
+// Renders every complete frame into out, colored and NUL terminated, while
+// at least MESSAGE_RENDER_MAX bytes are left, so call it again after
+// emptying out until it returns 0. Empty frames (heartbeats to answer) are
+// counted into *heartbeats. The server's handshake reply switches decoding to
+// binary records, shown like their text form. -1 with errno EPROTO or
+// EMSGSIZE if the stream is corrupt.
+int message_decoder_render(message_decoder_t decoder, char *out, size_t size, int *heartbeats);
+int message_decoder_wire_version(message_decoder_t decoder);
+
+// Protocol per socket (see wire.h), tracked per thread: 0 is text, the
+// default, otherwise the negotiated binary version. Reset to 0 on disconnect.
+int set_socket_wire_version(int socket_id, int version);
+int get_socket_wire_version(int socket_id);
+// If payload is a client hello, answers it and switches the socket to the
+// binary protocol; returns 1 if it was one, 0 otherwise
+int negotiate_wire_protocol(int socket_id, const char *payload, size_t len);
+
+// Delivery hooks: by default each message is written as one frame with
+// frame_send(); the server routes them through its io backend instead (per
+// thread), where a broadcast is encoded once and shared by all recipients
+typedef struct {
+    int (*send)(void *ctx, int socket_id, const void *data, size_t len);
+    int (*broadcast)(void *ctx, const int *socket_ids, int count, const void *data, size_t len);
+} message_transport_t;
+void set_message_transport(const message_transport_t *transport, void *ctx);
+
+// Message sending functions. Each recipient gets the text or binary form
+// depending on its socket's protocol.
 int send_message(int socket_id, message_channel_t channel, const char *message, int player_number);
+// "[SERVER] message" to one player
+int send_server_message(int socket_id, const char *message);
 int send_whisper(int from_socket_id, int to_socket_id, int from_player_number, int to_player_number, const char *message);
-int forward_message(channel_subscription_t *subscription, const char *message);
+// Broadcasts message from player_number (0: the server, shown as "[SERVER]")
+// to every seat in the set; seat_sockets maps seat -> socket_id. Pass a
+// channel's members, or a set built with bitset_and()/bitset_and_not() for
+// targeted announcements. The text form of a server message does not show
+// the channel.
+int forward_message(message_channel_t channel, const bitset_t *seats, const int *seat_sockets,
+                    int player_number, const char *message);
+
+// A fixed message rendered once in both protocols, then sent as is
+#define PRERENDERED_SIZE 128
+typedef struct {
+    message_channel_t channel;
+    size_t text_len;            // 0 until rendered
+    size_t record_len;
+    char text[PRERENDERED_SIZE];
+    char record[PRERENDERED_SIZE];
+} prerendered_message_t;
+
+// Same sender rules as forward_message(); RET_ERROR if it does not fit
+int prerender_message(prerendered_message_t *out, message_channel_t channel, int player_number,
+                      const char *message);
+int send_prerendered(int socket_id, const prerendered_message_t *message);
+
+// Server notices sent often enough to keep rendered
+typedef enum {
+    NOTICE_NIGHT_SILENCE,
+    NOTICE_DEAD_CANNOT_TALK,
+    NOTICE_YOU_ARE_DEAD,
+    NOTICE_NO_VOTE,
+    NOTICE_NIGHT_VOTE,
+    NOTICE_DEAD_CANNOT_VOTE,
+    NOTICE_VOTE_USAGE,
+    NOTICE_WEREWOLVES_ONLY,
+    NOTICE_COUNT
+} server_notice_t;
+
+// Renders every notice; call once at startup, before any worker runs
+int prerender_server_notices(void);
+// Falls back to send_server_message() if the notices were never rendered
+int send_server_notice(int socket_id, server_notice_t notice);
 
 // Channel management
-int subscribe_to_channel(channel_subscription_t *subscription, int socket_id);
-int unsubscribe_from_channel(channel_subscription_t *subscription, int socket_id);
-bool is_subscribed(channel_subscription_t *subscription, int socket_id);
+int subscribe_to_channel(channel_subscription_t *subscription, int seat);
+int unsubscribe_from_channel(channel_subscription_t *subscription, int seat);
+bool is_subscribed(const channel_subscription_t *subscription, int seat);
 
 // Message formatting
 const char *channel_name(message_channel_t channel);
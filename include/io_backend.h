@@ -0,0 +1,99 @@
+#ifndef __io_backend_h__
+#define __io_backend_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "frame.h"
+#include "output_queue.h"
+#include "timer_wheel.h"
+
+/*
+ * Connection I/O for one server worker. The backend owns accept, receive and
+ * send; the server only sees the callbacks below and never touches the
+ * sockets directly, so the same connection and dispatch code runs on top of
+ * the readiness backend (epoll/select) or io_uring.
+ */
+typedef struct {
+    void (*on_accept)(void *ctx, int fd);
+    // One complete frame; payload is NUL terminated and only valid during the call
+    void (*on_frame)(void *ctx, int fd, const char *payload, size_t len);
+    // Peer hung up, the socket failed or the peer broke framing; the backend
+    // closes the fd afterwards
+    void (*on_close)(void *ctx, int fd);
+} io_handlers_t;
+
+// Cumulative counters, used to compare syscalls per delivered message
+typedef struct {
+    uint64_t syscalls;
+    uint64_t accepts;
+    uint64_t recvs;
+    uint64_t frames;        // Frames delivered to on_frame()
+    uint64_t sends;         // Messages handed to io_backend_send()
+    uint64_t bytes_sent;
+    uint64_t overflows;     // Clients dropped for not reading their output
+    uint64_t idle_closes;   // Clients dropped for not answering a heartbeat
+} io_stats_t;
+
+typedef struct io_backend_cdt *io_backend_t;
+
+// Uses io_uring when built with USE_IO_URING=1 and the kernel supports it,
+// otherwise the readiness backend.
+// A watched connection that sends no frame for idle_timeout_sec gets an empty
+// frame as heartbeat, and is closed (on_close) if it stays silent for another
+// idle_timeout_sec. Hangups themselves come from readiness events, not polling.
+// Heartbeats run on timers, which must outlive the backend; 0 disables them.
+io_backend_t io_backend_create(int listen_fd, const io_handlers_t *handlers, void *ctx,
+                               timer_wheel_t timers, int idle_timeout_sec);
+void io_backend_destroy(io_backend_t backend);
+
+// Starts delivering on_frame/on_close for an accepted fd. On failure the fd
+// is still open and the caller's to close with io_backend_close.
+int io_backend_watch(io_backend_t backend, int fd);
+// Stops watching (if watched) and closes the fd, without calling on_close
+void io_backend_close(io_backend_t backend, int fd);
+// Queues one frame; the backend adds the length header and writes it once
+// the current poll iteration is done. Fails if the client's output queue is
+// full, in which case the client gets disconnected.
+int io_backend_send(io_backend_t backend, int fd, const void *payload, size_t len);
+// Same frame to every fd: encoded once and shared by all the output queues.
+// Returns how many recipients accepted it.
+int io_backend_broadcast(io_backend_t backend, const int *fds, int count, const void *payload, size_t len);
+
+// Waits up to timeout_ms (-1 blocks) and dispatches everything that is ready
+int io_backend_poll(io_backend_t backend, int timeout_ms);
+
+const char *io_backend_name(io_backend_t backend);
+const io_stats_t *io_backend_get_stats(io_backend_t backend);
+
+/* Backend implementations */
+typedef struct {
+    const char *name;
+    void *(*create)(int listen_fd, const io_handlers_t *handlers, void *ctx, io_stats_t *stats);
+    void (*destroy)(void *impl);
+    int (*watch)(void *impl, int fd);
+    void (*close)(void *impl, int fd);
+    // Takes its own reference to frame if it queues it
+    int (*send)(void *impl, int fd, shared_frame_t *frame);
+    int (*poll)(void *impl, int timeout_ms);
+} io_backend_ops_t;
+
+// Connections taken off the listen queue per wakeup, so an accept storm
+// cannot starve the rooms already playing; the rest wait for the next one
+#define IO_ACCEPT_BATCH 64
+
+// After accepting a batch: samples what is left in the listen queue (the
+// accept queue depth gauge; *queue_depth is this listener's last sample)
+void io_backend_note_accepts(int listen_fd, int accepted, int *queue_depth);
+
+// Delivers every complete frame buffered in ring, stopping if *closed gets
+// set by a handler. Returns RET_ERROR if the peer sent an oversized frame.
+int io_backend_dispatch_frames(frame_ring_t ring, const io_handlers_t *handlers, void *ctx,
+                               int fd, io_stats_t *stats, const bool *closed);
+
+extern const io_backend_ops_t readiness_backend_ops;
+#ifdef WEREWOLF_USE_IO_URING
+extern const io_backend_ops_t io_uring_backend_ops;
+#endif
+
+#endif // __io_backend_h__
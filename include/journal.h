@@ -0,0 +1,82 @@
+#ifndef __journal_h__
+#define __journal_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Append-only binary journal of what happened to the rooms of one worker:
+ * everything that changes a game_manager_t (its seed, joins, leaves, votes
+ * and phase changes) plus the commands players sent. Replaying the events
+ * of a room through a fresh manager rebuilds its exact state.
+ *
+ * File: JOURNAL_MAGIC, a version byte and the wall clock at open (8 bytes,
+ * milliseconds, little-endian), then records back to back:
+ *   type (1) | room (varint) | the fields journal_event_t lists, in the
+ *   order socket, value, result, seed, text
+ * Varints are LEB128; socket, value and result are zigzag-encoded, and the
+ * text is a varint length followed by its bytes.
+ *
+ * Appending only encodes into the journal's ring; a background thread writes
+ * the rings out in batches. A writer that finds its ring full waits for room
+ * rather than losing an event, which would make the journal unreplayable.
+ */
+#define JOURNAL_MAGIC "WWJ"
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 12
+#define JOURNAL_TEXT_MAX 1024       // Longer command text is cut
+#define JOURNAL_RECORD_MAX (JOURNAL_TEXT_MAX + 48)
+
+typedef enum {
+    JOURNAL_OPEN = 1,       // value: max_players, seed
+    JOURNAL_SEED,           // seed: the manager was reseeded
+    JOURNAL_JOIN,           // socket
+    JOURNAL_LEAVE,          // socket
+    JOURNAL_START,          // Roles were dealt
+    JOURNAL_VOTE,           // socket, value: target number, result: game_vote_result_t
+    JOURNAL_ADVANCE,        // value: phase now, result: eliminated number (0 for nobody)
+    JOURNAL_END,            // Ended without a winner
+    JOURNAL_COMMAND,        // socket, value: target number, result: journal_command_t, text
+    JOURNAL_CLOSE,          // The room was destroyed
+    JOURNAL_EVENT_COUNT
+} journal_event_t;
+
+typedef enum {
+    JOURNAL_COMMAND_WHISPER,
+    JOURNAL_COMMAND_VOTE,
+    JOURNAL_COMMAND_WEREWOLF,
+} journal_command_t;
+
+typedef struct {
+    uint8_t type;           // journal_event_t
+    uint32_t room;
+    int64_t socket;
+    int64_t value;
+    int64_t result;
+    uint64_t seed;
+    const char *text;       // Points into the decoded data
+    size_t text_len;
+} journal_record_t;
+
+typedef struct journal_cdt *journal_t;
+
+// Creates path (truncating it) and writes the header. One producer thread
+// per journal.
+journal_t journal_open(const char *path);
+// Writes out what is still queued
+void journal_close(journal_t journal);
+void journal_append(journal_t journal, const journal_record_t *record);
+// Writes out every open journal and stops the writer thread; also run at
+// exit. Call once nothing appends any more.
+void journal_stop(void);
+
+// Returns the encoded size, or 0 if the record does not fit in size bytes
+size_t journal_encode(uint8_t *out, size_t size, const journal_record_t *record);
+// Returns the bytes the record took, 0 if len ends inside it, RET_ERROR if
+// it is malformed
+int journal_decode(const uint8_t *data, size_t len, journal_record_t *record);
+// Checks the file header; returns the wall clock it was opened at in ms, or
+// RET_ERROR
+int64_t journal_decode_header(const uint8_t *data, size_t len);
+
+#endif // __journal_h__
@@ -14,18 +14,16 @@ typedef enum {
     FATAL
 } LOG_LEVEL;
 
+// Call sites below this level compile to nothing (make RELEASE=1 sets WARN)
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL DEBUG
+#endif
+
 extern LOG_LEVEL current_level;
 
 #define log(level, fmt, ...) do { \
-    if (level >= current_level) { \
-        FILE *out = level >= ERROR ? stderr : stdout; \
-        time_t t = time(NULL); \
-        struct tm *tm = localtime(&t); \
-        fprintf(out, "%d-%02d-%02dT%02d:%02d:%02dZ\t[%s] ", \
-                tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday, \
-                tm->tm_hour, tm->tm_min, tm->tm_sec, \
-                level_desc(level)); \
-        fprintf(out, fmt "\n", ##__VA_ARGS__); \
+    if (level >= LOG_MIN_LEVEL && level >= current_level) { \
+        log_write(level, fmt, ##__VA_ARGS__); \
         if (level == FATAL) exit(1); \
     } \
 } while(0)
@@ -33,4 +31,18 @@ extern LOG_LEVEL current_level;
 void set_log_level(LOG_LEVEL new_level);
 char * level_desc(LOG_LEVEL level);
 
+void log_write(LOG_LEVEL level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/*
+ * Asynchronous mode. Until logger_start() is called every line is written
+ * synchronously. Afterwards each thread formats its message into its own
+ * single-producer ring and a background thread adds the timestamp and writes
+ * the lines in batches; a full ring drops the line and counts it. Threads
+ * beyond the ring table keep logging synchronously. FATAL always drains the
+ * rings and writes synchronously before exiting.
+ */
+int logger_start(void);
+void logger_stop(void);
+unsigned long logger_dropped(void);
+
 #endif // __logger_h__
@@ -0,0 +1,86 @@
+#ifndef __metrics_h__
+#define __metrics_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "game_manager.h"
+#include "game_messanger.h"
+
+/*
+ * Process-wide metrics. Every thread updates its own shard with plain
+ * relaxed stores (no locks, no shared cache lines); metrics_render() sums
+ * the shards, so readers such as the admin listener never stop a worker.
+ */
+
+typedef enum {
+    COUNTER_CONNECTIONS_ACCEPTED,
+    COUNTER_CONNECTIONS_REJECTED,
+    COUNTER_BYTES_SENT,
+    COUNTER_SEND_EAGAIN,
+    COUNTER_SEND_ERRORS,
+    COUNTER_MESSAGES,                                   // + message_channel_t
+    COUNTER_COUNT = COUNTER_MESSAGES + CHANNEL_COUNT
+} metric_counter_t;
+
+typedef enum {
+    GAUGE_CONNECTIONS,
+    GAUGE_ACCEPT_QUEUE,                                 // Left queued after the last accept batch
+    GAUGE_ROOMS,                                        // + game_state_t
+    GAUGE_COUNT = GAUGE_ROOMS + GAME_STATE_ENDED + 1
+} metric_gauge_t;
+
+typedef enum {
+    HISTOGRAM_FANOUT,
+    HISTOGRAM_ACCEPT_BATCH,                             // Connections accepted per wakeup
+    HISTOGRAM_PHASE_DURATION_MS,                        // + game_state_t
+    HISTOGRAM_LATENCY_US = HISTOGRAM_PHASE_DURATION_MS + GAME_STATE_ENDED + 1,  // + message_channel_t
+    HISTOGRAM_COUNT = HISTOGRAM_LATENCY_US + CHANNEL_COUNT
+} metric_histogram_t;
+
+// Log-linear (HDR style) buckets: exact below 16, then 16 per power of two,
+// so any quantile is within 1/16 of the true value. The last bucket is open
+// ended (about 19 hours in microseconds).
+#define METRICS_SUB_BUCKET_BITS 4
+#define METRICS_BUCKETS 512
+
+void metrics_add(metric_counter_t counter, uint64_t value);
+void metrics_gauge_add(metric_gauge_t gauge, int64_t delta);
+void metrics_observe(metric_histogram_t histogram, uint64_t value);
+
+#define metrics_inc(counter) metrics_add(counter, 1)
+
+/*
+ * End-to-end latency, per channel: from the monotonic stamp taken when a
+ * message was read (or a connection accepted) to the moment the last reply
+ * it caused is handed to the kernel. The backend stamps ingress around its
+ * handlers, the messenger notes which channels a message produced output
+ * on, and the backend completes the pending notes right after its flush.
+ */
+// Stamps the current read; each message handled under it calls
+// metrics_ingress_message() first, so every message is timed once
+void metrics_ingress_begin(void);
+void metrics_ingress_message(void);
+void metrics_ingress_end(void);
+void metrics_latency_note(message_channel_t channel);
+void metrics_latency_flush(void);
+
+typedef struct {
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} metrics_summary_t;
+
+// One histogram summed over all threads
+void metrics_summarize(metric_histogram_t histogram, metrics_summary_t *summary);
+
+// Writes count, p50/p99/p999 and max for every latency histogram to stderr,
+// whatever the log level
+void metrics_log_latency(void);
+
+// Prometheus text exposition format. Returns the full length like snprintf;
+// call again with a larger buffer if it did not fit.
+size_t metrics_render(char *buffer, size_t size);
+
+#endif // __metrics_h__
@@ -0,0 +1,52 @@
+#ifndef __output_queue_h__
+#define __output_queue_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+// Frames kept for a client until its socket takes them. A connection may
+// hold at most OUTPUT_QUEUE_LIMIT bytes; past that it is a slow reader and
+// the io backend drops it instead of buffering without bound.
+#define OUTPUT_QUEUE_LIMIT (64 * 1024)
+#define OUTPUT_QUEUE_IOV_MAX 64
+
+// One encoded frame (header + payload). A broadcast creates it once and every
+// recipient's queue holds a reference; it is freed when the last one drains.
+// References are only taken by the worker that owns the connections, so the
+// count is not atomic. Frames and chunks are recycled through per-thread
+// free lists, so a worker stops calling malloc once its lists are warm.
+typedef struct {
+    int refs;
+    int pool;           // Free list it returns to, -1 for none
+    size_t len;
+    char data[];
+} shared_frame_t;
+
+// Returns a frame holding one reference
+shared_frame_t *shared_frame_create(const void *payload, size_t len);
+void shared_frame_unref(shared_frame_t *frame);
+
+typedef struct out_chunk_t {
+    struct out_chunk_t *next;
+    shared_frame_t *frame;
+    size_t offset;      // Bytes of this frame already written
+} out_chunk_t;
+
+// Embedded per connection; all zeroes is an empty queue
+typedef struct {
+    out_chunk_t *head;
+    out_chunk_t *tail;
+    size_t bytes;       // Unwritten bytes queued
+} output_queue_t;
+
+// Appends a reference to frame; RET_ERROR if it would pass OUTPUT_QUEUE_LIMIT
+int output_queue_push(output_queue_t *queue, shared_frame_t *frame);
+// Fills up to max iovecs with the unwritten bytes, oldest first
+int output_queue_iov(const output_queue_t *queue, struct iovec *iov, int max);
+// Drops the first written bytes, freeing finished chunks
+void output_queue_consume(output_queue_t *queue, size_t written);
+void output_queue_clear(output_queue_t *queue);
+bool output_queue_empty(const output_queue_t *queue);
+
+#endif // __output_queue_h__
@@ -0,0 +1,47 @@
+#ifndef __rng_h__
+#define __rng_h__
+
+#include <stdint.h>
+
+/*
+ * Seedable pseudo-random generator (xoshiro256**). Each owner keeps its own
+ * state instead of sharing rand()'s, so threads never contend on it and a
+ * seed replays the same sequence. Not for anything security related.
+ */
+typedef struct {
+    uint64_t s[4];
+} rng_t;
+
+// Any seed, including 0, gives a usable state
+void rng_seed(rng_t *rng, uint64_t seed);
+
+static inline uint64_t
+rng_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t
+rng_next(rng_t *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return result;
+}
+
+// Uniform in [0, bound) for bound > 0, by multiply and shift instead of a
+// division; the bias is below bound / 2^32
+static inline uint32_t
+rng_below(rng_t *rng, uint32_t bound)
+{
+    return (uint32_t) (((rng_next(rng) >> 32) * bound) >> 32);
+}
+
+#endif // __rng_h__
@@ -0,0 +1,46 @@
+#ifndef __room_registry_h__
+#define __room_registry_h__
+
+#include "arena.h"
+#include "game_manager.h"
+#include "game_messanger.h"
+#include "timer_wheel.h"
+#include "journal.h"
+
+// A room is one independent game with its own manager and channel set. The
+// room itself, its manager, channel members and per-game scratch all live in
+// its arena, sized from max_players when the room opens and freed with it.
+typedef struct room_t {
+    int id;
+    arena_t arena;
+    game_manager_t game_manager;
+    channel_subscription_t channels[CHANNEL_COUNT];
+    timer_wheel_t timers;           // The owning worker's wheel
+    wheel_timer_t phase_timer;      // Deadline of the current phase
+    struct room_t *prev;
+    struct room_t *next;
+} room_t;
+
+typedef struct room_registry_cdt *room_registry_t;
+
+// Rooms arm their phase timers on timers, which must outlive the registry.
+// With a journal every room records its events there (see journal.h).
+room_registry_t room_registry_create(int max_players, int max_rooms, timer_wheel_t timers,
+                                     journal_t journal);
+void room_registry_destroy(room_registry_t registry);
+
+// Returns the room currently accepting players, opening a new one if needed
+room_t *room_registry_get_lobby(room_registry_t registry);
+// Called once the lobby room starts its game so the next join opens a new room
+void room_registry_close_lobby(room_registry_t registry, room_t *room);
+// Destroys a room that has no players left (the open lobby is kept)
+void room_registry_release_if_empty(room_registry_t registry, room_t *room);
+
+int room_registry_bind_socket(room_registry_t registry, int socket_id, room_t *room);
+void room_registry_unbind_socket(room_registry_t registry, int socket_id);
+room_t *room_registry_find_by_socket(room_registry_t registry, int socket_id);
+
+int room_registry_get_room_count(room_registry_t registry);
+room_t *room_registry_first(room_registry_t registry);
+
+#endif // __room_registry_h__
@@ -11,20 +11,14 @@
 #define SOL_IPV6 41
 
 
-/* Client list management */
-typedef struct client_fd_list_t {
-    int fd;
-    struct client_fd_list_t *next;
-} client_fd_list_t;
-
 /* Function declarations */
-int setup_tcp_server(const char *host, const char *service, int max_backlog);
-int accept_tcp_connection(int server_socket);
-int set_server_socket_options(int sockfd, int family);
+int setup_tcp_server(const char *host, const char *service, int max_backlog, bool reuse_port);
+// Accepts up to max queued connections, already non-blocking and
+// close-on-exec, into client_sockets; returns how many (fewer once the
+// queue is empty)
+int accept_tcp_connections(int server_socket, int *client_sockets, int max);
+// Connections waiting in the listener's accept queue, or RET_ERROR
+int accept_queue_depth(int server_socket);
+int set_server_socket_options(int sockfd, int family, bool reuse_port);
 int validate_server_input(const char *host, const char *service);
-
-/* Client list management functions */
-client_fd_list_t *add_client_fd(client_fd_list_t *client_fd_list, int client_socket);
-client_fd_list_t *remove_client_fd(client_fd_list_t *client_fd_list, int client_socket);
-bool is_socket_connected(int sockfd);
 #endif // __tcp_server_util_h__
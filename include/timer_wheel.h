@@ -0,0 +1,61 @@
+#ifndef __timer_wheel_h__
+#define __timer_wheel_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Hierarchical timing wheel: TIMER_WHEEL_LEVELS wheels of 64 slots, the
+ * first one TIMER_WHEEL_TICK_MS per slot and each next one 64 times coarser.
+ * A timer lives in the slot of the level its deadline falls into and is
+ * moved down a level when the finer wheel comes around to it, so arming
+ * and cancelling are O(1) and one advance fires every timer that is due
+ * regardless of how many are pending.
+ *
+ * Timers are embedded in their owner (no allocation) and fire on the
+ * thread that advances the wheel; a callback may arm or cancel any timer,
+ * including its own.
+ */
+#define TIMER_WHEEL_TICK_MS 10
+#define TIMER_WHEEL_LEVELS 4        // 64^4 ticks, about 46 hours at 10 ms
+
+typedef void (*timer_callback_t)(void *arg);
+
+typedef struct wheel_timer_t {
+    struct wheel_timer_t *next;     // NULL when not armed
+    struct wheel_timer_t *prev;
+    uint64_t expires;               // Tick
+    int slot;                       // level * 64 + index
+    timer_callback_t callback;
+    void *arg;
+} wheel_timer_t;
+
+typedef struct timer_wheel_cdt *timer_wheel_t;
+
+timer_wheel_t timer_wheel_create(uint64_t now_ms);
+void timer_wheel_destroy(timer_wheel_t wheel);
+
+void timer_init(wheel_timer_t *timer, timer_callback_t callback, void *arg);
+static inline bool
+timer_pending(const wheel_timer_t *timer)
+{
+    return timer->next != NULL;
+}
+
+// Fires delay_ms from now; re-arms a pending timer
+void timer_wheel_schedule(timer_wheel_t wheel, wheel_timer_t *timer, uint64_t delay_ms);
+void timer_wheel_cancel(timer_wheel_t wheel, wheel_timer_t *timer);
+
+// Fires everything due by now_ms; returns how many timers fired
+int timer_wheel_advance(timer_wheel_t wheel, uint64_t now_ms);
+// Time of the last advance: a clock reading that costs nothing, but as old as
+// the poll sleep that came before it when read from an I/O handler
+uint64_t timer_wheel_now_ms(timer_wheel_t wheel);
+// How long a poll may sleep before the wheel needs advancing, -1 when no
+// timer is armed. May be early (a coarse slot moving down), never late.
+int timer_wheel_timeout_ms(timer_wheel_t wheel, uint64_t now_ms);
+
+// CLOCK_MONOTONIC in milliseconds
+uint64_t timer_now_ms(void);
+
+#endif // __timer_wheel_h__
@@ -0,0 +1,61 @@
+#ifndef __wire_h__
+#define __wire_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary protocol, opted into per connection. It rides inside the usual
+ * length-prefixed frames (frame.h); every connection starts on the text
+ * protocol.
+ *
+ * Handshake: the client sends WIRE_OP_HELLO 'W' 'W' <max version> as a frame.
+ * A server that knows the binary protocol answers with the same four bytes
+ * carrying the version it picked, and every frame it sends after that reply
+ * is a record. The client keeps sending text until it sees the reply. Older
+ * servers drop the hello (it reads as an empty chat line), so the client
+ * stays on text.
+ *
+ * Record, both directions:
+ *   opcode (1) | channel (1) | player (varint) | target (varint) |
+ *   text length (varint) | text
+ * Varints are LEB128, so player numbers take one byte. Player 0 means the
+ * server, and a target of 0 means none. The text always runs to the end of
+ * the frame, so the NUL that frame_ring_next() adds terminates it.
+ *
+ * Client to server: MESSAGE on CHANNEL_CHAT is chat, on CHANNEL_WEREWOLF it is
+ * /ww. WHISPER and VOTE carry the target. The player field is ignored.
+ * Server to client: MESSAGE from player (0 for server announcements) and
+ * WHISPER from player to target.
+ */
+#define WIRE_VERSION 1
+#define WIRE_HELLO_SIZE 4
+#define WIRE_MAX_HEADER 17      // opcode, channel and three 5 byte varints
+
+typedef enum {
+    WIRE_OP_HELLO,
+    WIRE_OP_MESSAGE,
+    WIRE_OP_WHISPER,
+    WIRE_OP_VOTE,
+    WIRE_OP_COUNT
+} wire_opcode_t;
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t channel;        // message_channel_t
+    uint32_t player;
+    uint32_t target;
+    const char *text;       // Points into the decoded payload
+    size_t text_len;
+} wire_record_t;
+
+void wire_encode_hello(char out[WIRE_HELLO_SIZE], int version);
+// Version offered or picked by the peer, or RET_ERROR if payload is no hello
+int wire_decode_hello(const char *payload, size_t len);
+
+// Returns the encoded size, or 0 if the record does not fit in size bytes
+size_t wire_encode(char *out, size_t size, const wire_record_t *record);
+// RET_ERROR on a truncated or malformed record
+int wire_decode(const char *payload, size_t len, wire_record_t *record);
+
+#endif // __wire_h__
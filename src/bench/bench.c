@@ -0,0 +1,672 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "logger.h"
+#include "defs.h"
+#include "arena.h"
+#include "bitset.h"
+#include "game_manager.h"
+#include "game_messanger.h"
+#include "command_handler.h"
+#include "room_registry.h"
+#include "frame.h"
+#include "wire.h"
+
+#define DEFAULT_MIN_TIME_MS 200
+#define DEFAULT_THRESHOLD_PERCENT 10
+#define MAX_BENCH_ITERATIONS (1L << 30)
+#define SMALL_ROOM 16
+#define LARGE_ROOM 10000
+#define SOCKET_BASE 1000    // Fake socket ids for rooms that never send
+#define DRAIN_EVERY 64      // Ops between emptying the socketpairs
+#define MAX_RESULTS 32
+
+/*
+ * Microbenchmarks for the per-message hot paths. Each benchmark runs its op
+ * in a loop, doubling the iteration count until one run takes at least the
+ * minimum time, and reports ns/op and heap allocations/op. Setup done
+ * between bench_pause() and bench_resume() is neither timed nor counted.
+ *
+ * Allocations are counted by wrapping malloc/calloc/realloc at link time
+ * (-Wl,--wrap, see the bench target in the Makefile), so only calls made by
+ * our own objects are seen, not libc internals.
+ */
+
+typedef struct {
+    long iterations;
+    uint64_t elapsed_ns;
+    uint64_t started_ns;
+    bool running;
+} bench_t;
+
+typedef struct {
+    const char *name;
+    void (*run)(bench_t *bench);
+} bench_case_t;
+
+typedef struct {
+    char name[64];
+    long iterations;
+    double ns_per_op;
+    double allocs_per_op;
+} bench_result_t;
+
+static long alloc_count = 0;
+static bool counting_allocs = false;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *
+__wrap_malloc(size_t size)
+{
+    alloc_count += counting_allocs;
+    return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t count, size_t size)
+{
+    alloc_count += counting_allocs;
+    return __real_calloc(count, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+    alloc_count += counting_allocs;
+    return __real_realloc(ptr, size);
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void
+bench_resume(bench_t *bench)
+{
+    if (!bench->running) {
+        bench->running = true;
+        bench->started_ns = now_ns();
+        counting_allocs = true;
+    }
+}
+
+static void
+bench_pause(bench_t *bench)
+{
+    if (bench->running) {
+        counting_allocs = false;
+        bench->elapsed_ns += now_ns() - bench->started_ns;
+        bench->running = false;
+    }
+}
+
+/* ---- game_manager ---- */
+
+// One room exists at a time, so every create_room() reuses this arena
+static arena_t room_arena = NULL;
+
+static game_manager_t
+create_room(bench_t *bench, int players, int fill)
+{
+    if (!room_arena && !(room_arena = arena_create(game_manager_arena_size(LARGE_ROOM)))) {
+        log(FATAL, "Failed to create the room arena");
+    }
+    arena_rewind(room_arena, 0);
+    game_manager_t game_manager = game_manager_create(room_arena, players);
+    if (!game_manager) {
+        log(FATAL, "Failed to create a %d player room", players);
+    }
+    for (int i = 0; i < fill; i++) {
+        game_manager_add_player(game_manager, SOCKET_BASE + i);
+    }
+    return game_manager;
+}
+
+static void
+run_add_player(bench_t *bench, int players)
+{
+    game_manager_t game_manager = create_room(bench, players, 0);
+    int added = 0;
+
+    bench_resume(bench);
+    for (long i = 0; i < bench->iterations; i++) {
+        if (added == players) {
+            bench_pause(bench);
+            for (int p = 0; p < players; p++) {
+                game_manager_remove_player(game_manager, SOCKET_BASE + p);
+            }
+            added = 0;
+            bench_resume(bench);
+        }
+        game_manager_add_player(game_manager, SOCKET_BASE + added++);
+    }
+    bench_pause(bench);
+    game_manager_destroy(game_manager);
+}
+
+static void
+run_remove_player(bench_t *bench, int players)
+{
+    game_manager_t game_manager = create_room(bench, players, players);
+    int left = players;
+
+    bench_resume(bench);
+    for (long i = 0; i < bench->iterations; i++) {
+        if (left == 0) {
+            bench_pause(bench);
+            for (int p = 0; p < players; p++) {
+                game_manager_add_player(game_manager, SOCKET_BASE + p);
+            }
+            left = players;
+            bench_resume(bench);
+        }
+        game_manager_remove_player(game_manager, SOCKET_BASE + --left);
+    }
+    bench_pause(bench);
+    game_manager_destroy(game_manager);
+}
+
+static void
+run_get_player_number(bench_t *bench, int players)
+{
+    game_manager_t game_manager = create_room(bench, players, players);
+    int sum = 0;
+    int next = 0;
+
+    bench_resume(bench);
+    for (long i = 0; i < bench->iterations; i++) {
+        sum += game_manager_get_player_number(game_manager, SOCKET_BASE + next);
+        if (++next == players) {
+            next = 0;
+        }
+    }
+    bench_pause(bench);
+    if (sum == 0) {
+        log(ERROR, "Player lookups found nobody");
+    }
+    game_manager_destroy(game_manager);
+}
+
+static void bench_add_player_small(bench_t *bench) { run_add_player(bench, SMALL_ROOM); }
+static void bench_add_player_large(bench_t *bench) { run_add_player(bench, LARGE_ROOM); }
+static void bench_remove_player_small(bench_t *bench) { run_remove_player(bench, SMALL_ROOM); }
+static void bench_remove_player_large(bench_t *bench) { run_remove_player(bench, LARGE_ROOM); }
+static void bench_get_player_number_small(bench_t *bench) { run_get_player_number(bench, SMALL_ROOM); }
+static void bench_get_player_number_large(bench_t *bench) { run_get_player_number(bench, LARGE_ROOM); }
+
+// Role assignment for a full room; game configs only go up to 16 players
+static void
+bench_start_game(bench_t *bench)
+{
+    for (long i = 0; i < bench->iterations; i++) {
+        game_manager_t game_manager = create_room(bench, SMALL_ROOM, SMALL_ROOM);
+        bench_resume(bench);
+        game_manager_start_game(game_manager);
+        bench_pause(bench);
+        game_manager_destroy(game_manager);
+    }
+}
+
+// Lynch votes changing hands in an open day vote
+static void
+bench_cast_vote(bench_t *bench)
+{
+    game_manager_t game_manager = create_room(bench, SMALL_ROOM, SMALL_ROOM);
+    game_phase_result_t result;
+    game_manager_start_game(game_manager);
+    game_manager_advance_phase(game_manager, &result);    // Night -> day
+    game_manager_advance_phase(game_manager, &result);    // Day -> voting
+    int cast = 0;
+
+    bench_resume(bench);
+    for (long i = 0; i < bench->iterations; i++) {
+        int voter = (int) (i % SMALL_ROOM);
+        int target = (voter + 1 + (int) (i / SMALL_ROOM) % (SMALL_ROOM - 1)) % SMALL_ROOM;
+        cast += game_manager_cast_vote(game_manager, SOCKET_BASE + voter, target + 1) == VOTE_ACCEPTED;
+    }
+    bench_pause(bench);
+    if (cast == 0) {
+        log(ERROR, "No vote was accepted");
+    }
+    game_manager_destroy(game_manager);
+}
+
+// Lowest numbered living player other than socket_id (and not a werewolf,
+// if werewolves_spared), or 0
+static int
+first_target(game_manager_t game_manager, int socket_id, bool werewolves_spared)
+{
+    for (int number = 1; number <= SMALL_ROOM; number++) {
+        int target = game_manager_get_socket_by_player_number(game_manager, number);
+        if (target >= 0 && target != socket_id && game_manager_is_player_alive(game_manager, target) &&
+            !(werewolves_spared && game_manager_is_player_werewolf(game_manager, target))) {
+            return number;
+        }
+    }
+    return 0;
+}
+
+// A whole game, from role assignment to a win, on a room that already exists:
+// should allocate nothing
+static void
+bench_full_game(bench_t *bench)
+{
+    int phases = 0;
+    for (long i = 0; i < bench->iterations; i++) {
+        game_manager_t game_manager = create_room(bench, SMALL_ROOM, SMALL_ROOM);
+        game_phase_result_t result = {.winner = TEAM_NONE};
+
+        bench_resume(bench);
+        game_manager_start_game(game_manager);
+        while (result.winner == TEAM_NONE && phases++ < MAX_BENCH_ITERATIONS) {
+            game_state_t phase = game_manager_get_phase(game_manager);
+            for (int p = 0; p < SMALL_ROOM && phase != GAME_STATE_DAY; p++) {
+                int target = first_target(game_manager, SOCKET_BASE + p, phase == GAME_STATE_NIGHT);
+                game_manager_cast_vote(game_manager, SOCKET_BASE + p, target);
+            }
+            game_manager_advance_phase(game_manager, &result);
+        }
+        bench_pause(bench);
+        game_manager_destroy(game_manager);
+    }
+    if (phases == 0) {
+        log(ERROR, "No game was played");
+    }
+}
+
+/* ---- messaging ---- */
+
+static void
+bench_format_message(bench_t *bench)
+{
+    char line[BUFFER_SIZE];
+    size_t total = 0;
+
+    bench_resume(bench);
+    for (long i = 0; i < bench->iterations; i++) {
+        total += format_message(line, sizeof(line), CHANNEL_CHAT, (int) (i & 15) + 1,
+                                "anyone awake? I saw player 3 at the well");
+    }
+    bench_pause(bench);
+    if (total == 0) {
+        log(ERROR, "format_message produced nothing");
+    }
+}
+
+static void
+bench_parse_message_channel(bench_t *bench)
+{
+    static const char *messages[] = {
+        "[CHAT] Player 4: anyone awake?\n",
+        "[WHISPER] From Player 2 to Player 5: it is 3\n",
+        "[SERVER] The night falls\n",
+        "[WEREWOLF] Player 1: take 6\n",
+    };
+    int sum = 0;
+
+    bench_resume(bench);
+    for (long i = 0; i < bench->iterations; i++) {
+        sum += parse_message_channel(messages[i & 3]);
+    }
+    bench_pause(bench);
+    if (sum == 0) {
+        log(ERROR, "parse_message_channel matched nothing");
+    }
+}
+
+// Binary counterparts of the two above
+static void
+bench_wire_encode(bench_t *bench)
+{
+    static const char *text = "anyone awake? I saw player 3 at the well";
+    char out[FRAME_MAX_PAYLOAD];
+    wire_record_t record = {.opcode = WIRE_OP_MESSAGE, .channel = CHANNEL_CHAT, .text = text};
+    size_t total = 0;
+
+    bench_resume(bench);
+    for (long i = 0; i < bench->iterations; i++) {
+        record.player = (uint32_t) (i & 15) + 1;
+        record.text_len = strlen(text);
+        total += wire_encode(out, sizeof(out), &record);
+    }
+    bench_pause(bench);
+    if (total == 0) {
+        log(ERROR, "wire_encode produced nothing");
+    }
+}
+
+static void
+bench_wire_decode(bench_t *bench)
+{
+    static const char *texts[] = {"anyone awake?", "it is 3", "The night falls", "take 6"};
+    static const wire_opcode_t opcodes[] = {WIRE_OP_MESSAGE, WIRE_OP_WHISPER, WIRE_OP_MESSAGE, WIRE_OP_MESSAGE};
+    static const message_channel_t channels[] = {CHANNEL_CHAT, CHANNEL_WHISPER, CHANNEL_SERVER, CHANNEL_WEREWOLF};
+    static const uint32_t players[] = {4, 2, 0, 1};
+    char records[4][64];
+    size_t lens[4];
+    for (int i = 0; i < 4; i++) {
+        wire_record_t record = {.opcode = opcodes[i], .channel = channels[i], .player = players[i],
+                                .target = opcodes[i] == WIRE_OP_WHISPER ? 5 : 0,
+                                .text = texts[i], .text_len = strlen(texts[i])};
+        lens[i] = wire_encode(records[i], sizeof(records[i]), &record);
+    }
+    int sum = 0;
+
+    bench_resume(bench);
+    for (long i = 0; i < bench->iterations; i++) {
+        wire_record_t record;
+        if (wire_decode(records[i & 3], lens[i & 3], &record) == RET_SUCCESS) {
+            sum += record.channel;
+        }
+    }
+    bench_pause(bench);
+    if (sum == 0) {
+        log(ERROR, "wire_decode decoded nothing");
+    }
+}
+
+/*
+ * Real sockets for the send paths: the server end of each pair is written
+ * through the default frame_send() transport, the other end is drained
+ * every DRAIN_EVERY ops with the timer paused.
+ */
+typedef struct {
+    int server_fds[SMALL_ROOM];
+    int client_fds[SMALL_ROOM];
+} socket_room_t;
+
+static void
+open_socket_room(socket_room_t *room)
+{
+    for (int i = 0; i < SMALL_ROOM; i++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0) {
+            log(FATAL, "socketpair() failed");
+        }
+        room->server_fds[i] = pair[0];
+        room->client_fds[i] = pair[1];
+    }
+}
+
+static void
+drain_socket_room(socket_room_t *room)
+{
+    char buffer[16384];
+    for (int i = 0; i < SMALL_ROOM; i++) {
+        while (recv(room->client_fds[i], buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+        }
+    }
+}
+
+static void
+close_socket_room(socket_room_t *room)
+{
+    for (int i = 0; i < SMALL_ROOM; i++) {
+        close(room->server_fds[i]);
+        close(room->client_fds[i]);
+    }
+}
+
+static void
+forward_to_room(bench_t *bench, int wire_version)
+{
+    socket_room_t room;
+    open_socket_room(&room);
+
+    bitset_t seats = {0};
+    for (int seat = 0; seat < SMALL_ROOM; seat++) {
+        bitset_set(&seats, seat);
+        set_socket_wire_version(room.server_fds[seat], wire_version);
+    }
+
+    bench_resume(bench);
+    for (long i = 0; i < bench->iterations; i++) {
+        forward_message(CHANNEL_CHAT, &seats, room.server_fds, 4, "anyone awake? I saw player 3 at the well");
+        if ((i + 1) % DRAIN_EVERY == 0) {
+            bench_pause(bench);
+            drain_socket_room(&room);
+            bench_resume(bench);
+        }
+    }
+    bench_pause(bench);
+
+    for (int seat = 0; seat < SMALL_ROOM; seat++) {
+        set_socket_wire_version(room.server_fds[seat], 0);
+    }
+    bitset_free(&seats);
+    close_socket_room(&room);
+}
+
+static void
+bench_forward_message(bench_t *bench)
+{
+    forward_to_room(bench, 0);
+}
+
+static void
+bench_forward_message_binary(bench_t *bench)
+{
+    forward_to_room(bench, WIRE_VERSION);
+}
+
+/* ---- commands ---- */
+
+static void
+bench_whisper_command(bench_t *bench)
+{
+    socket_room_t room;
+    open_socket_room(&room);
+
+    room_t game_room = {.game_manager = create_room(bench, SMALL_ROOM, 0)};
+    for (int i = 0; i < SMALL_ROOM; i++) {
+        game_manager_add_player(game_room.game_manager, room.server_fds[i]);
+    }
+
+    bench_resume(bench);
+    for (long i = 0; i < bench->iterations; i++) {
+        handle_if_command("/whisper 5 I think it is player 3", room.server_fds[0], &game_room);
+        if ((i + 1) % DRAIN_EVERY == 0) {
+            bench_pause(bench);
+            drain_socket_room(&room);
+            bench_resume(bench);
+        }
+    }
+    bench_pause(bench);
+
+    game_manager_destroy(game_room.game_manager);
+    close_socket_room(&room);
+}
+
+static const bench_case_t bench_cases[] = {
+    {"game_manager_add_player/16", bench_add_player_small},
+    {"game_manager_add_player/10000", bench_add_player_large},
+    {"game_manager_remove_player/16", bench_remove_player_small},
+    {"game_manager_remove_player/10000", bench_remove_player_large},
+    {"game_manager_get_player_number/16", bench_get_player_number_small},
+    {"game_manager_get_player_number/10000", bench_get_player_number_large},
+    {"game_manager_start_game/16", bench_start_game},
+    {"game_manager_cast_vote/16", bench_cast_vote},
+    {"game_manager_full_game/16", bench_full_game},
+    {"format_message", bench_format_message},
+    {"parse_message_channel", bench_parse_message_channel},
+    {"wire_encode", bench_wire_encode},
+    {"wire_decode", bench_wire_decode},
+    {"forward_message/16", bench_forward_message},
+    {"forward_message_binary/16", bench_forward_message_binary},
+    {"handle_if_command/whisper", bench_whisper_command},
+};
+
+#define BENCH_CASE_COUNT ((int) (sizeof(bench_cases) / sizeof(bench_cases[0])))
+
+static void
+run_case(const bench_case_t *bench_case, uint64_t min_time_ns, bench_result_t *result)
+{
+    bench_t bench = {0};
+    for (long iterations = 1;; iterations *= 2) {
+        bench = (bench_t) {.iterations = iterations};
+        alloc_count = 0;
+        bench_case->run(&bench);
+        if (bench.elapsed_ns >= min_time_ns || iterations >= MAX_BENCH_ITERATIONS) {
+            break;
+        }
+    }
+
+    snprintf(result->name, sizeof(result->name), "%s", bench_case->name);
+    result->iterations = bench.iterations;
+    result->ns_per_op = (double) bench.elapsed_ns / bench.iterations;
+    result->allocs_per_op = (double) alloc_count / bench.iterations;
+}
+
+// One benchmark per line, so two result files diff line by line
+static int
+write_json(const char *path, const bench_result_t *results, int count)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        log(ERROR, "Cannot write %s", path);
+        return RET_ERROR;
+    }
+
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "    {\"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.2f, \"allocs_per_op\": %.2f}%s\n",
+                results[i].name, results[i].iterations, results[i].ns_per_op, results[i].allocs_per_op,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return RET_SUCCESS;
+}
+
+// Reads back what write_json() wrote; returns the count or RET_ERROR
+static int
+read_json(const char *path, bench_result_t *results, int max_results)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        log(ERROR, "Cannot read baseline %s", path);
+        return RET_ERROR;
+    }
+
+    char line[256];
+    int count = 0;
+    while (count < max_results && fgets(line, sizeof(line), file)) {
+        bench_result_t *result = &results[count];
+        if (sscanf(line, " {\"name\": \"%63[^\"]\", \"iterations\": %ld, \"ns_per_op\": %lf, \"allocs_per_op\": %lf",
+                   result->name, &result->iterations, &result->ns_per_op, &result->allocs_per_op) == 4) {
+            count++;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+// Prints the change against the baseline; returns the number of regressions
+static int
+compare_baseline(const bench_result_t *results, int count, const bench_result_t *baseline,
+                 int baseline_count, double threshold_percent)
+{
+    int regressions = 0;
+    printf("\n%-40s %12s %12s %8s\n", "vs baseline", "ns/op", "allocs/op", "");
+    for (int i = 0; i < count; i++) {
+        const bench_result_t *old = NULL;
+        for (int j = 0; j < baseline_count && !old; j++) {
+            if (strcmp(baseline[j].name, results[i].name) == 0) {
+                old = &baseline[j];
+            }
+        }
+        if (!old) {
+            printf("%-40s %12s %12s %8s\n", results[i].name, "new", "new", "");
+            continue;
+        }
+
+        double change = old->ns_per_op > 0 ? (results[i].ns_per_op / old->ns_per_op - 1) * 100 : 0;
+        double alloc_change = results[i].allocs_per_op - old->allocs_per_op;
+        bool regressed = change > threshold_percent || alloc_change > 0.005;
+        regressions += regressed;
+        printf("%-40s %+11.1f%% %+12.2f %8s\n", results[i].name, change, alloc_change,
+               regressed ? "SLOWER" : "");
+    }
+    return regressions;
+}
+
+static void
+print_usage(const char *program_name)
+{
+    fprintf(stderr, "Usage: %s [-t min_ms] [-o results.json] [-b baseline.json] [-T percent] [filter]\n", program_name);
+    fprintf(stderr, "  -t min_ms: Minimum run time per benchmark (default: %d)\n", DEFAULT_MIN_TIME_MS);
+    fprintf(stderr, "  -o results.json: Write results as JSON\n");
+    fprintf(stderr, "  -b baseline.json: Compare against an earlier -o file, exit 1 on regressions\n");
+    fprintf(stderr, "  -T percent: ns/op increase that counts as a regression (default: %d)\n", DEFAULT_THRESHOLD_PERCENT);
+    fprintf(stderr, "  filter: Only run benchmarks whose name contains this\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    int min_time_ms = DEFAULT_MIN_TIME_MS;
+    double threshold_percent = DEFAULT_THRESHOLD_PERCENT;
+    const char *output_path = NULL;
+    const char *baseline_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:o:b:T:h")) != -1) {
+        switch (opt) {
+            case 't': min_time_ms = atoi(optarg); break;
+            case 'o': output_path = optarg; break;
+            case 'b': baseline_path = optarg; break;
+            case 'T': threshold_percent = atof(optarg); break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    const char *filter = optind < argc ? argv[optind] : NULL;
+    if (min_time_ms < 1 || threshold_percent < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Keep the INFO lines of the code under test out of the timings
+    set_log_level(WARN);
+
+    bench_result_t results[MAX_RESULTS];
+    int count = 0;
+    printf("%-40s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+    for (int i = 0; i < BENCH_CASE_COUNT; i++) {
+        if (filter && !strstr(bench_cases[i].name, filter)) {
+            continue;
+        }
+        bench_result_t *result = &results[count++];
+        run_case(&bench_cases[i], (uint64_t) min_time_ms * 1000000, result);
+        printf("%-40s %12ld %12.1f %12.2f\n", result->name, result->iterations, result->ns_per_op,
+               result->allocs_per_op);
+    }
+
+    if (output_path && write_json(output_path, results, count) < 0) {
+        return 1;
+    }
+
+    if (baseline_path) {
+        bench_result_t baseline[MAX_RESULTS];
+        int baseline_count = read_json(baseline_path, baseline, MAX_RESULTS);
+        if (baseline_count < 0) {
+            return 1;
+        }
+        if (compare_baseline(results, count, baseline, baseline_count, threshold_percent) > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
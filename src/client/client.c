@@ -4,130 +4,334 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <sys/select.h>
+#include <poll.h>
+#include <stdbool.h>
 #include "logger.h"
 #include "defs.h"
 #include "tcp_client_util.h"
 #include "util.h"
+#include "frame.h"
 #include "game_messanger.h"
 #include "command_dispatcher.h"
+#include "wire.h"
+#include "timer_wheel.h"
 
 #define DEFAULT_PORT "8080"
 #define DEFAULT_HOST "127.0.0.1"
 #define BUFFER_SIZE 1024
+#define OUTPUT_BUFFER_SIZE (64 * BUFFER_SIZE)
+#define HEARTBEAT_SEC 25            // Below the server's default idle timeout
+#define RECONNECT_MIN_SEC 1
+#define RECONNECT_MAX_SEC 30
+
+static void
+print_welcome_message()
+{
+    printf("Welcome to the Werewolf game!\n");
+    printf("Type /help to see the list of available commands.\n");
+}
+
+/*
+ * The client sleeps in poll() on stdin and the socket until one of them has
+ * input or a timer is due. Incoming messages are rendered into one output
+ * buffer and written with a single write() per wakeup, however many arrived.
+ * If the server goes away the client keeps running and reconnects with
+ * exponential backoff; while connected it sends an empty frame after
+ * HEARTBEAT_SEC without sending anything, which the server counts as life.
+ */
+typedef struct {
+    const char *host;
+    const char *port;
+    int sockfd;                 // -1 while disconnected
+    message_decoder_t decoder;  // The connection's stream
+    int reconnect_sec;          // Delay before the next reconnect attempt
+    bool running;
+    timer_wheel_t timers;
+    wheel_timer_t heartbeat;
+    wheel_timer_t reconnect;
+    char line[BUFFER_SIZE];     // Partial stdin line
+    size_t line_len;
+    char out[OUTPUT_BUFFER_SIZE];
+    size_t out_len;
+} client_t;
+
+static void
+flush_output(client_t *client)
+{
+    // Anything printf()ed (help, usage) goes out first
+    fflush(stdout);
+    size_t written = 0;
+    while (written < client->out_len) {
+        ssize_t rv = write(STDOUT_FILENO, client->out + written, client->out_len - written);
+        if (rv < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rv <= 0) {
+            break;
+        }
+        written += rv;
+    }
+    client->out_len = 0;
+}
+
+static void
+schedule_heartbeat(client_t *client)
+{
+    timer_wheel_schedule(client->timers, &client->heartbeat, HEARTBEAT_SEC * 1000);
+}
 
 static int
-set_sockfdet_options(int sockfd)
+connect_client(client_t *client)
 {
-    // We add SO_RCVLOWAT (Receive Low Watermark) to the sockfdet options.
-    // This is to ensure that the sockfdet will not block when there is no data to read.
-    int opt = 1;
-    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVLOWAT, &opt, sizeof(opt)) < 0) {
-        return -1;
+    int sockfd = tcp_client_socket(client->host, client->port);
+    if (sockfd < 0) {
+        return RET_ERROR;
     }
-    return 0;
+
+    message_decoder_t decoder = message_decoder_create();
+    if (!decoder || set_nonblocking(sockfd) < 0) {
+        log(ERROR, "Failed to set up the connection: %s", strerror(errno));
+        message_decoder_destroy(decoder);
+        close(sockfd);
+        return RET_ERROR;
+    }
+
+    // Offer the binary protocol; servers without it ignore the hello
+    char hello[WIRE_HELLO_SIZE];
+    wire_encode_hello(hello, WIRE_VERSION);
+    if (frame_send(sockfd, hello, sizeof(hello), 0) < 0) {
+        log(ERROR, "Send failed: %s", strerror(errno));
+    }
+
+    client->sockfd = sockfd;
+    client->decoder = decoder;
+    set_wire_version(0);
+    client->reconnect_sec = RECONNECT_MIN_SEC;
+    schedule_heartbeat(client);
+    log(INFO, "Connected to server at %s:%s", client->host, client->port);
+    return RET_SUCCESS;
 }
 
 static void
-print_welcome_message()
+schedule_reconnect(client_t *client)
 {
-    printf("Welcome to the Werewolf game!\n");
-    printf("Type /help to see the list of available commands.\n");
+    printf("Reconnecting in %d s...\n", client->reconnect_sec);
+    timer_wheel_schedule(client->timers, &client->reconnect, client->reconnect_sec * 1000);
+    client->reconnect_sec *= 2;
+    if (client->reconnect_sec > RECONNECT_MAX_SEC) {
+        client->reconnect_sec = RECONNECT_MAX_SEC;
+    }
 }
 
 static void
-while_active(int sockfd) 
+connection_lost(client_t *client)
 {
-    char buffer[BUFFER_SIZE] = {0};
-    fd_set read_fds;
-    struct timeval tv;
+    // What the server said before it went goes out first
+    flush_output(client);
+    close(client->sockfd);
+    client->sockfd = -1;
+    message_decoder_destroy(client->decoder);
+    client->decoder = NULL;
+    timer_wheel_cancel(client->timers, &client->heartbeat);
+    printf("Lost the connection to the server.\n");
+    schedule_reconnect(client);
+}
 
+// reconnect timer callback
+static void
+reconnect(void *arg)
+{
+    client_t *client = arg;
+    if (connect_client(client) < 0) {
+        schedule_reconnect(client);
+        return;
+    }
+    printf("Reconnected; you are in a new room.\n");
+}
+
+// heartbeat timer callback
+static void
+heartbeat(void *arg)
+{
+    client_t *client = arg;
+    if (frame_send(client->sockfd, "", 0, 0) < 0) {
+        connection_lost(client);
+        return;
+    }
+    schedule_heartbeat(client);
+}
+
+// Renders every complete frame the decoder holds
+static int
+render_messages(client_t *client)
+{
+    int heartbeats = 0;
+    int rendered;
+    do {
+        if (OUTPUT_BUFFER_SIZE - client->out_len <= MESSAGE_RENDER_MAX) {
+            flush_output(client);
+        }
+        rendered = message_decoder_render(client->decoder, client->out + client->out_len,
+                                          OUTPUT_BUFFER_SIZE - client->out_len, &heartbeats);
+        if (rendered < 0) {
+            log(ERROR, "Bad stream from the server: %s", strerror(errno));
+            return RET_ERROR;
+        }
+        client->out_len += rendered;
+    } while (rendered > 0);
+
+    if (heartbeats > 0) {
+        // Any frame back tells the server we are here
+        frame_send(client->sockfd, "", 0, 0);
+        schedule_heartbeat(client);
+    }
+    return RET_SUCCESS;
+}
+
+static void
+read_server(client_t *client)
+{
+    // Rendering after every read keeps the decoder's ring from filling up
     while (1) {
-        FD_ZERO(&read_fds);
-        FD_SET(STDIN_FILENO, &read_fds);
-        FD_SET(sockfd, &read_fds);
-        
-        tv.tv_sec = 0;
-        tv.tv_usec = 0;
-
-        int max_fd = (sockfd > STDIN_FILENO) ? sockfd : STDIN_FILENO;
-        
-        int activity = select(max_fd + 1, &read_fds, NULL, NULL, &tv);
-        if (activity < 0) {
-            log(ERROR, "select() failed: %s", strerror(errno));
+        ssize_t valread = message_decoder_read(client->decoder, client->sockfd);
+        if (valread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
             break;
         }
+        if (valread < 0) {
+            log(ERROR, "Read failed: %s", strerror(errno));
+        }
+        if (valread <= 0 || render_messages(client) < 0) {
+            connection_lost(client);
+            return;
+        }
+    }
+    set_wire_version(message_decoder_wire_version(client->decoder));
+}
 
-        if (FD_ISSET(sockfd, &read_fds)) {
-            int valread = read_and_format_message(sockfd, buffer, BUFFER_SIZE);
-            if (valread <= 0) {
-                if (valread < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-                    log(ERROR, "Read failed: %s", strerror(errno));
-                    break;
-                }
-            } else {
-                printf("%s", buffer);
-                fflush(stdout);
-            }
+static void
+handle_line(client_t *client, char *line)
+{
+    if (client->sockfd < 0) {
+        printf("Not connected to the server, message dropped.\n");
+        return;
+    }
+
+    // Handle commands
+    if (line[0] == '/') {
+        char *cmd = strtok(line + 1, " ");
+        char *arg1 = strtok(NULL, " ");
+        char *arg2 = strtok(NULL, "");
+        dispatch_command(cmd, client->sockfd, arg1, arg2);
+    } else {
+        send_chat(client->sockfd, line);
+    }
+    schedule_heartbeat(client);
+}
+
+static void
+read_stdin(client_t *client)
+{
+    // Keep what the server said before this input in order with any replies
+    flush_output(client);
+
+    ssize_t rv = read(STDIN_FILENO, client->line + client->line_len, sizeof(client->line) - 1 - client->line_len);
+    if (rv < 0) {
+        if (errno != EINTR) {
+            log(ERROR, "Read from stdin failed: %s", strerror(errno));
+            client->running = false;
+        }
+        return;
+    }
+    if (rv == 0) {
+        // End of input: a last line without a newline still counts
+        if (client->line_len > 0) {
+            client->line[client->line_len] = '\0';
+            handle_line(client, client->line);
         }
+        client->running = false;
+        return;
+    }
+    client->line_len += rv;
 
-        if (FD_ISSET(STDIN_FILENO, &read_fds)) {
-            if (fgets(buffer, BUFFER_SIZE, stdin) == NULL) {
-                break;
-            }
+    char *start = client->line;
+    char *end = client->line + client->line_len;
+    char *newline;
+    while ((newline = memchr(start, '\n', end - start))) {
+        *newline = '\0';
+        handle_line(client, start);
+        start = newline + 1;
+    }
+    client->line_len = end - start;
+    if (client->line_len == sizeof(client->line) - 1) {
+        // No newline in a full buffer: send what fits as one line
+        client->line[client->line_len] = '\0';
+        handle_line(client, client->line);
+        client->line_len = 0;
+    } else {
+        memmove(client->line, start, client->line_len);
+    }
+}
 
-            buffer[strcspn(buffer, "\n")] = 0;
-            
-            // Handle commands
-            if (buffer[0] == '/') {
-                char *cmd = strtok(buffer + 1, " ");
-                char *arg1 = strtok(NULL, " ");
-                char *arg2 = strtok(NULL, "");
-                dispatch_command(cmd, sockfd, arg1, arg2);
-            } else {
-            if (send(sockfd, buffer, strlen(buffer), 0) < 0) {
-                log(ERROR, "Send failed: %s", strerror(errno));
-                break;
-            }
+static void
+while_active(client_t *client)
+{
+    while (client->running) {
+        struct pollfd fds[2] = {
+            {.fd = STDIN_FILENO, .events = POLLIN},
+            {.fd = client->sockfd, .events = POLLIN},   // Ignored while -1
+        };
+        int ready = poll(fds, 2, timer_wheel_timeout_ms(client->timers, timer_now_ms()));
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            log(ERROR, "poll() failed: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents) {
+            read_server(client);
+        }
+        if (fds[0].revents) {
+            read_stdin(client);
         }
+        timer_wheel_advance(client->timers, timer_now_ms());
+        flush_output(client);
     }
 }
 
 int main(int argc, const char *argv[])
 {
-    int sockfd = -1;
-    const char *host = DEFAULT_HOST;
-    const char *port = DEFAULT_PORT;
+    static client_t client;
+    client.host = DEFAULT_HOST;
+    client.port = DEFAULT_PORT;
+    client.sockfd = -1;
+    client.running = true;
 
     if (argc > 1) {
-        host = argv[1];
+        client.host = argv[1];
     }
     if (argc > 2) {
-        port = argv[2];
+        client.port = argv[2];
     }
 
-    sockfd = tcp_client_socket(host, port);
-    if (sockfd < 0) {
-        log(FATAL, "Failed to connect to server");
-    }
-
-    if (set_sockfdet_options(sockfd) < 0) {
-        log(ERROR, "Failed to set sockfdet options: %s", strerror(errno));
-        close(sockfd);
+    client.timers = timer_wheel_create(timer_now_ms());
+    if (!client.timers) {
         return 1;
     }
+    timer_init(&client.heartbeat, heartbeat, &client);
+    timer_init(&client.reconnect, reconnect, &client);
 
-    if (set_nonblocking(sockfd) < 0) {
-        log(ERROR, "Failed to set non-blocking mode: %s", strerror(errno));
-        close(sockfd);
-        return 1;
+    if (connect_client(&client) < 0) {
+        log(FATAL, "Failed to connect to server");
     }
-
-    log(INFO, "Connected to server at %s:%s", host, port);
     print_welcome_message();
 
-    while_active(sockfd);
-    close(sockfd);
+    while_active(&client);
+    flush_output(&client);
+    if (client.sockfd >= 0) {
+        close(client.sockfd);
+    }
+    timer_wheel_destroy(client.timers);
     return 0;
-} 
\ No newline at end of file
+}
@@ -6,10 +6,15 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include "logger.h"
+#include "frame.h"
+#include "wire.h"
+#include "game_messanger.h"
 
 // TODO: DRY!!
 #define BUFFER_SIZE 1024
 
+// 0 until the server accepts the binary handshake
+static int wire_version = 0;
 
 static command_t commands[] = {
     [0] = {
@@ -30,14 +35,68 @@ static command_t commands[] = {
     },
     [2] = {
         .aliases = {"ww", "werewolf"},
-        .usage = "/ww <player_id>",
-        .description = "Vote for a player to be a werewolf",
+        .usage = "/ww <message>",
+        .description = "Talk to the other werewolves",
         .function = ww_command,
         .arg1 = NULL,
         .arg2 = NULL
+    },
+    [3] = {
+        .aliases = {"vote", "v"},
+        .usage = "/vote <player_id>",
+        .description = "Vote for a player (night kill or day lynch)",
+        .function = vote_command,
+        .arg1 = NULL,
+        .arg2 = NULL
     }
 };
 
+void
+set_wire_version(int version)
+{
+    wire_version = version;
+}
+
+// A command as one binary record; only once the server speaks the protocol
+static void
+send_record(int sockfd, wire_opcode_t opcode, message_channel_t channel, int target, const char *text)
+{
+    char record[FRAME_MAX_PAYLOAD];
+    wire_record_t fields = {
+        .opcode = opcode,
+        .channel = channel,
+        .target = target,
+        .text = text,
+        .text_len = strlen(text),
+    };
+    size_t len = wire_encode(record, sizeof(record), &fields);
+    if (len == 0) {
+        printf("Message too long\n");
+        return;
+    }
+    if (frame_send(sockfd, record, len, 0) < 0) {
+        log(ERROR, "Failed to send command");
+    }
+}
+
+static void
+send_line(int sockfd, const char *line)
+{
+    if (frame_send(sockfd, line, strlen(line), 0) < 0) {
+        log(ERROR, "Failed to send command");
+    }
+}
+
+void
+send_chat(int sockfd, const char *message)
+{
+    if (wire_version > 0) {
+        send_record(sockfd, WIRE_OP_MESSAGE, CHANNEL_CHAT, 0, message);
+    } else {
+        send_line(sockfd, message);
+    }
+}
+
 void
 dispatch_command(const char *command, int sockfd, void *arg1, void *arg2) 
 {
@@ -50,7 +109,7 @@ dispatch_command(const char *command, int sockfd, void *arg1, void *arg2)
     for (int i = 0; i < command_count; i++) {
         int alias_count = sizeof(commands[i].aliases) / sizeof(commands[i].aliases[0]);
         for (int j = 0; j < alias_count; j++) {
-            if (strcmp(command, commands[i].aliases[j]) == 0) {
+            if (commands[i].aliases[j] && strcmp(command, commands[i].aliases[j]) == 0) {
                 commands[i].function(sockfd, arg1, arg2);
                 return;
             }
@@ -73,12 +132,13 @@ whisper_command(int sockfd, void *player_id_str, void *message)
         return;
     }
     
+    if (wire_version > 0) {
+        send_record(sockfd, WIRE_OP_WHISPER, CHANNEL_WHISPER, player_id, message);
+        return;
+    }
     char whisper_cmd[BUFFER_SIZE];
     snprintf(whisper_cmd, BUFFER_SIZE, "/whisper %d %s", player_id, (char *)message);
-    if (send(sockfd, whisper_cmd, strlen(whisper_cmd), 0) < 0) {
-        log(ERROR, "Failed to send whisper message");
-    }
-
+    send_line(sockfd, whisper_cmd);
 }
 
 void 
@@ -92,7 +152,39 @@ help_command(int sockfd, void *arg1, void *arg2)
 }
 
 void 
-ww_command(int sockfd, void *arg1, void *arg2) 
+ww_command(int sockfd, void *first_word, void *rest) 
+{
+    if (!first_word) {
+        printf("Usage: %s\n", commands[2].usage);
+        return;
+    }
+
+    // The dispatcher split the message at its first space
+    char message[BUFFER_SIZE];
+    snprintf(message, BUFFER_SIZE, "%s%s%s", (char *)first_word, rest ? " " : "", rest ? (char *)rest : "");
+    if (wire_version > 0) {
+        send_record(sockfd, WIRE_OP_MESSAGE, CHANNEL_WEREWOLF, 0, message);
+        return;
+    }
+    char ww_cmd[BUFFER_SIZE + 4];
+    snprintf(ww_cmd, sizeof(ww_cmd), "/ww %s", message);
+    send_line(sockfd, ww_cmd);
+}
+
+void
+vote_command(int sockfd, void *player_id_str, void *arg2)
 {
-    // TODO: Implement ww chat
+    int player_id = player_id_str ? atoi(player_id_str) : 0;
+    if (player_id <= 0) {
+        printf("Usage: %s\n", commands[3].usage);
+        return;
+    }
+
+    if (wire_version > 0) {
+        send_record(sockfd, WIRE_OP_VOTE, CHANNEL_CHAT, player_id, "");
+        return;
+    }
+    char vote_cmd[BUFFER_SIZE];
+    snprintf(vote_cmd, BUFFER_SIZE, "/vote %d", player_id);
+    send_line(sockfd, vote_cmd);
 }
@@ -0,0 +1,589 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "logger.h"
+#include "defs.h"
+#include "event_loop.h"
+#include "tcp_client_util.h"
+#include "frame.h"
+#include "game_messanger.h"
+#include "metrics.h"
+#include "wire.h"
+
+#define DEFAULT_HOST "127.0.0.1"
+#define DEFAULT_PORT "8080"
+#define DEFAULT_CONNECTIONS 96
+#define DEFAULT_THREADS 1
+#define DEFAULT_DURATION_SEC 5
+#define DEFAULT_MESSAGE "hello"
+#define DEFAULT_PLAYERS 16
+#define DEFAULT_WHISPER_PERCENT 10
+#define DEFAULT_VOTE_PERCENT 5
+#define MAX_OUTSTANDING 64      // Unanswered messages tracked per connection
+#define MAX_SCRIPT_LINES 1024
+
+/*
+ * Simulated players. Each connection waits for its room to start (the first
+ * frame it gets), then sends chat lines, /whisper and /vote commands, either
+ * from a script or at random. Closed loop by default (one message in flight
+ * per connection); -r switches to a fixed send rate.
+ *
+ * Every message ends in a " ~<connection>.<seq>" token. A reply that echoes
+ * the token (chat, werewolf chat, whisper confirmation) answers that message;
+ * a [SERVER] reply answers the oldest unanswered one. The time in between is
+ * the client-observed latency.
+ *
+ * With -B every connection offers the binary protocol (wire.h) and sends
+ * records once the server accepts it.
+ */
+
+typedef enum {
+    ACTION_CHAT,
+    ACTION_WHISPER,
+    ACTION_VOTE,
+    ACTION_COUNT
+} loadgen_action_t;
+
+static const char *action_names[ACTION_COUNT] = {"chat", "whisper", "vote"};
+
+// Latency histogram each action lands in; vote results are announcements
+static const message_channel_t action_channels[ACTION_COUNT] = {
+    CHANNEL_CHAT, CHANNEL_WHISPER, CHANNEL_ANNOUNCEMENT,
+};
+
+typedef struct {
+    double sent_at;
+    unsigned seq;
+    loadgen_action_t action;
+} outstanding_t;
+
+typedef struct {
+    int fd;
+    int id;
+    bool greeted;       // Room started, sending allowed
+    bool closed;
+    int wire_version;   // 0 while on the text protocol
+    unsigned next_seq;
+    int script_pos;
+    char token[24];     // " ~<id>." prefix of this connection's tokens
+    size_t token_len;
+    outstanding_t outstanding[MAX_OUTSTANDING];
+    int outstanding_count;
+    frame_ring_t ring;
+} loadgen_conn_t;
+
+typedef struct {
+    const char *host;
+    const char *port;
+    const char *message;
+    int players;
+    int whisper_percent;
+    int vote_percent;
+    double rate;        // Messages per second per connection, 0 for closed loop
+    bool binary;        // Offer the binary protocol
+    int duration_sec;
+    char **script;
+    int script_lines;
+} loadgen_config_t;
+
+typedef struct {
+    int id;
+    const loadgen_config_t *config;
+    int first_conn_id;
+    int connection_count;
+    loadgen_conn_t *conns;
+    unsigned seed;
+    long replies;       // Frames received
+    long sent;
+    long answered;
+    long unanswered;    // Pushed out of a full outstanding list
+    long disconnects;
+    double connect_time;
+    double elapsed;     // Measurement window, excludes connection setup
+    pthread_t thread;
+} loadgen_worker_t;
+
+static double
+now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static loadgen_action_t
+next_message(loadgen_worker_t *worker, loadgen_conn_t *conn, char *out, size_t size)
+{
+    const loadgen_config_t *config = worker->config;
+    if (config->script_lines > 0) {
+        const char *line = config->script[(conn->id + conn->script_pos++) % config->script_lines];
+        snprintf(out, size, "%s", line);
+        if (strncmp(line, "/whisper ", 9) == 0) {
+            return ACTION_WHISPER;
+        }
+        return strncmp(line, "/vote ", 6) == 0 ? ACTION_VOTE : ACTION_CHAT;
+    }
+
+    int roll = rand_r(&worker->seed) % 100;
+    int target = rand_r(&worker->seed) % config->players + 1;
+    if (roll < config->whisper_percent) {
+        snprintf(out, size, "/whisper %d %s", target, config->message);
+        return ACTION_WHISPER;
+    }
+    if (roll < config->whisper_percent + config->vote_percent) {
+        snprintf(out, size, "/vote %d", target);
+        return ACTION_VOTE;
+    }
+    snprintf(out, size, "%s", config->message);
+    return ACTION_CHAT;
+}
+
+// The record a binary client sends for a command line
+static size_t
+encode_command(const char *line, char *out, size_t size)
+{
+    wire_record_t record = {.opcode = WIRE_OP_MESSAGE, .channel = CHANNEL_CHAT, .text = line};
+    char *end;
+    if (strncmp(line, "/whisper ", 9) == 0) {
+        record.opcode = WIRE_OP_WHISPER;
+        record.channel = CHANNEL_WHISPER;
+        record.target = strtoul(line + 9, &end, 10);
+        record.text = *end == ' ' ? end + 1 : end;
+    } else if (strncmp(line, "/vote ", 6) == 0) {
+        record.opcode = WIRE_OP_VOTE;
+        record.target = strtoul(line + 6, &end, 10);
+        record.text = end;
+    } else if (strncmp(line, "/ww ", 4) == 0) {
+        record.channel = CHANNEL_WEREWOLF;
+        record.text = line + 4;
+    }
+    record.text_len = strlen(record.text);
+    return wire_encode(out, size, &record);
+}
+
+static void
+send_next(loadgen_worker_t *worker, loadgen_conn_t *conn)
+{
+    char message[BUFFER_SIZE];
+    loadgen_action_t action = next_message(worker, conn, message, sizeof(message));
+    unsigned seq = conn->next_seq++;
+    size_t len = strlen(message);
+    len += snprintf(message + len, sizeof(message) - len, "%s%u", conn->token, seq);
+    if (len > FRAME_MAX_PAYLOAD) {
+        len = FRAME_MAX_PAYLOAD;
+    }
+
+    const char *frame = message;
+    char record[FRAME_MAX_PAYLOAD];
+    if (conn->wire_version > 0) {
+        len = encode_command(message, record, sizeof(record));
+        frame = record;
+    }
+    if (frame_send(conn->fd, frame, len, MSG_NOSIGNAL) <= 0) {
+        return;
+    }
+    worker->sent++;
+
+    if (conn->outstanding_count == MAX_OUTSTANDING) {
+        memmove(conn->outstanding, conn->outstanding + 1, sizeof(outstanding_t) * (MAX_OUTSTANDING - 1));
+        conn->outstanding_count--;
+        worker->unanswered++;
+    }
+    outstanding_t *entry = &conn->outstanding[conn->outstanding_count++];
+    entry->sent_at = now_sec();
+    entry->seq = seq;
+    entry->action = action;
+}
+
+static void
+answer(loadgen_worker_t *worker, loadgen_conn_t *conn, int index, double now)
+{
+    outstanding_t *entry = &conn->outstanding[index];
+    metrics_observe(HISTOGRAM_LATENCY_US + action_channels[entry->action],
+                    (uint64_t) ((now - entry->sent_at) * 1e6));
+    memmove(entry, entry + 1, sizeof(outstanding_t) * (conn->outstanding_count - index - 1));
+    conn->outstanding_count--;
+    worker->answered++;
+}
+
+static void
+match_reply(loadgen_worker_t *worker, loadgen_conn_t *conn, const char *payload, double now)
+{
+    const char *token = strstr(payload, conn->token);
+    if (token) {
+        unsigned seq = strtoul(token + conn->token_len, NULL, 10);
+        for (int i = 0; i < conn->outstanding_count; i++) {
+            if (conn->outstanding[i].seq == seq) {
+                answer(worker, conn, i, now);
+                return;
+            }
+        }
+        return;
+    }
+    if (strncmp(payload, "[SERVER]", 8) == 0 && conn->outstanding_count > 0) {
+        answer(worker, conn, 0, now);
+    }
+}
+
+// Binary replies: the token is in the text, server messages come from player 0
+static void
+match_record(loadgen_worker_t *worker, loadgen_conn_t *conn, const char *payload, size_t len, double now)
+{
+    wire_record_t record;
+    if (wire_decode(payload, len, &record) < 0) {
+        return;
+    }
+    if (strstr(record.text, conn->token)) {
+        match_reply(worker, conn, record.text, now);
+    } else if (record.opcode == WIRE_OP_MESSAGE && record.player == 0 && conn->outstanding_count > 0) {
+        answer(worker, conn, 0, now);
+    }
+}
+
+static void
+close_conn(loadgen_worker_t *worker, event_loop_t loop, loadgen_conn_t *conn)
+{
+    event_loop_remove(loop, conn->fd);
+    close(conn->fd);
+    conn->closed = true;
+    worker->disconnects++;
+}
+
+static void
+handle_readable(loadgen_worker_t *worker, event_loop_t loop, loadgen_conn_t *conn)
+{
+    const char *payload;
+    size_t len;
+    int frames = 0;
+    double now = now_sec();
+
+    while (1) {
+        struct iovec iov[2];
+        int count = frame_ring_reserve(conn->ring, iov);
+        ssize_t n = readv(conn->fd, iov, count);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            close_conn(worker, loop, conn);
+            return;
+        }
+        if (n < 0) {
+            break;
+        }
+        frame_ring_commit(conn->ring, n);
+        while (frame_ring_next(conn->ring, &payload, &len) > 0) {
+            if (len == 0) {
+                // Heartbeat from an idle connection; not a reply to anything
+                frame_send(conn->fd, "", 0, MSG_NOSIGNAL);
+                continue;
+            }
+            int version = wire_decode_hello(payload, len);
+            if (version > 0) {
+                conn->wire_version = version;
+                continue;
+            }
+            if (conn->wire_version > 0) {
+                match_record(worker, conn, payload, len, now);
+            } else {
+                match_reply(worker, conn, payload, now);
+            }
+            frames++;
+        }
+    }
+
+    if (frames == 0) {
+        return;
+    }
+    worker->replies += frames;
+    conn->greeted = true;
+    if (worker->config->rate == 0 && conn->outstanding_count == 0) {
+        send_next(worker, conn);
+    }
+}
+
+static void *
+loadgen_run(void *arg)
+{
+    loadgen_worker_t *worker = arg;
+    const loadgen_config_t *config = worker->config;
+    event_loop_t loop = event_loop_create();
+    if (!loop) {
+        return NULL;
+    }
+
+    double connect_start = now_sec();
+    for (int i = 0; i < worker->connection_count; i++) {
+        loadgen_conn_t *conn = &worker->conns[i];
+        conn->id = worker->first_conn_id + i;
+        conn->fd = tcp_client_socket(config->host, config->port);
+        conn->ring = frame_ring_create();
+        conn->token_len = snprintf(conn->token, sizeof(conn->token), " ~%d.", conn->id);
+        if (conn->fd < 0 || !conn->ring || event_loop_add(loop, conn->fd, EVENT_READ) < 0) {
+            log(FATAL, "Worker %d failed to open connection %d", worker->id, i);
+        }
+        if (config->binary) {
+            char hello[WIRE_HELLO_SIZE];
+            wire_encode_hello(hello, WIRE_VERSION);
+            frame_send(conn->fd, hello, sizeof(hello), MSG_NOSIGNAL);
+        }
+    }
+    worker->connect_time = now_sec() - connect_start;
+
+    // fd -> connection lookup for this worker
+    int max_fd = 0;
+    for (int i = 0; i < worker->connection_count; i++) {
+        if (worker->conns[i].fd > max_fd) {
+            max_fd = worker->conns[i].fd;
+        }
+    }
+    loadgen_conn_t **by_fd = calloc(max_fd + 1, sizeof(loadgen_conn_t *));
+    if (!by_fd) {
+        log(FATAL, "Failed to allocate connection map");
+    }
+    for (int i = 0; i < worker->connection_count; i++) {
+        by_fd[worker->conns[i].fd] = &worker->conns[i];
+    }
+
+    // Open loop: one send every interval, round robin over the connections
+    double interval = config->rate > 0 ? 1.0 / (config->rate * worker->connection_count) : 0;
+    int next_conn = 0;
+
+    event_t events[EVENT_LOOP_MAX_EVENTS];
+    double start = now_sec();
+    double deadline = start + config->duration_sec;
+    double next_send = start;
+    double now;
+    while ((now = now_sec()) < deadline) {
+        if (interval > 0) {
+            for (int sends = 0; now >= next_send && sends < worker->connection_count; sends++) {
+                loadgen_conn_t *conn = &worker->conns[next_conn];
+                next_conn = (next_conn + 1) % worker->connection_count;
+                if (conn->greeted && !conn->closed) {
+                    send_next(worker, conn);
+                }
+                next_send += interval;
+            }
+            if (now >= next_send) {
+                next_send = now;    // Fell behind: do not burst to catch up
+            }
+        }
+
+        double wake = interval > 0 && next_send < deadline ? next_send : deadline;
+        int timeout_ms = wake > now ? (int) ((wake - now) * 1000) + 1 : 0;
+        int ready = event_loop_wait(loop, events, EVENT_LOOP_MAX_EVENTS, timeout_ms);
+        for (int i = 0; i < ready; i++) {
+            loadgen_conn_t *conn = by_fd[events[i].fd];
+            if (conn && !conn->closed) {
+                handle_readable(worker, loop, conn);
+            }
+        }
+    }
+    worker->elapsed = now - start;
+
+    for (int i = 0; i < worker->connection_count; i++) {
+        loadgen_conn_t *conn = &worker->conns[i];
+        if (!conn->closed) {
+            close(conn->fd);
+        }
+        worker->unanswered += conn->outstanding_count;
+        frame_ring_destroy(conn->ring);
+    }
+    free(by_fd);
+    event_loop_destroy(loop);
+    return NULL;
+}
+
+// One message per line; blank lines are skipped
+static int
+load_script(const char *path, loadgen_config_t *config)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        log(ERROR, "Cannot open script %s", path);
+        return RET_ERROR;
+    }
+
+    config->script = calloc(MAX_SCRIPT_LINES, sizeof(char *));
+    char line[BUFFER_SIZE];
+    while (config->script && config->script_lines < MAX_SCRIPT_LINES && fgets(line, sizeof(line), file)) {
+        size_t len = strcspn(line, "\r\n");
+        if (len == 0) {
+            continue;
+        }
+        char *copy = malloc(len + 1);
+        if (!copy) {
+            break;
+        }
+        memcpy(copy, line, len);
+        copy[len] = '\0';
+        config->script[config->script_lines++] = copy;
+    }
+    fclose(file);
+
+    if (config->script_lines == 0) {
+        log(ERROR, "Script %s has no messages", path);
+        return RET_ERROR;
+    }
+    return RET_SUCCESS;
+}
+
+// Thousands of connections need more than the usual 1024 descriptors
+static void
+raise_fd_limit(int connections)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t) connections + 64) {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur < (rlim_t) connections + 64) {
+            log(WARN, "Descriptor limit %lu is low for %d connections", (unsigned long) limit.rlim_cur, connections);
+        }
+    }
+}
+
+static void
+print_usage(const char *program_name)
+{
+    fprintf(stderr, "Usage: %s [-c connections] [-t threads] [-d seconds] [-m message] [-r rate]\n"
+                    "          [-p players] [-W whisper%%] [-V vote%%] [-f script] [-B] [host] [port]\n", program_name);
+    fprintf(stderr, "  -c connections: Total connections, spread over threads (default: %d)\n", DEFAULT_CONNECTIONS);
+    fprintf(stderr, "  -t threads: Client threads (default: %d)\n", DEFAULT_THREADS);
+    fprintf(stderr, "  -d seconds: Run time (default: %d)\n", DEFAULT_DURATION_SEC);
+    fprintf(stderr, "  -m message: Chat line each connection sends (default: \"%s\")\n", DEFAULT_MESSAGE);
+    fprintf(stderr, "  -r rate: Messages per second per connection, 0 keeps one in flight (default: 0)\n");
+    fprintf(stderr, "  -p players: Players per room on the server, for whisper/vote targets (default: %d)\n", DEFAULT_PLAYERS);
+    fprintf(stderr, "  -W whisper%%: Share of random messages sent as /whisper (default: %d)\n", DEFAULT_WHISPER_PERCENT);
+    fprintf(stderr, "  -V vote%%: Share of random messages sent as /vote (default: %d)\n", DEFAULT_VOTE_PERCENT);
+    fprintf(stderr, "  -f script: Send these lines in order instead of random messages\n");
+    fprintf(stderr, "  -B: Negotiate the binary protocol instead of sending text\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    int connections = DEFAULT_CONNECTIONS;
+    int threads = DEFAULT_THREADS;
+    loadgen_config_t config = {
+        .host = DEFAULT_HOST,
+        .port = DEFAULT_PORT,
+        .message = DEFAULT_MESSAGE,
+        .players = DEFAULT_PLAYERS,
+        .whisper_percent = DEFAULT_WHISPER_PERCENT,
+        .vote_percent = DEFAULT_VOTE_PERCENT,
+        .rate = 0,
+        .duration_sec = DEFAULT_DURATION_SEC,
+    };
+    const char *script = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:t:d:m:r:p:W:V:f:Bh")) != -1) {
+        switch (opt) {
+            case 'c': connections = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'd': config.duration_sec = atoi(optarg); break;
+            case 'm': config.message = optarg; break;
+            case 'r': config.rate = atof(optarg); break;
+            case 'p': config.players = atoi(optarg); break;
+            case 'W': config.whisper_percent = atoi(optarg); break;
+            case 'V': config.vote_percent = atoi(optarg); break;
+            case 'f': script = optarg; break;
+            case 'B': config.binary = true; break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind < argc) {
+        config.host = argv[optind++];
+    }
+    if (optind < argc) {
+        config.port = argv[optind++];
+    }
+
+    if (connections < 1 || threads < 1 || threads > connections || config.duration_sec < 1 ||
+        config.rate < 0 || config.players < 1 || config.whisper_percent < 0 || config.vote_percent < 0 ||
+        config.whisper_percent + config.vote_percent > 100) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    set_log_level(WARN);
+    if (script && load_script(script, &config) < 0) {
+        return 1;
+    }
+    raise_fd_limit(connections);
+
+    loadgen_worker_t *workers = calloc(threads, sizeof(loadgen_worker_t));
+    if (!workers) {
+        log(FATAL, "Failed to allocate workers");
+    }
+
+    int first_conn_id = 0;
+    for (int i = 0; i < threads; i++) {
+        loadgen_worker_t *worker = &workers[i];
+        worker->id = i;
+        worker->config = &config;
+        worker->seed = (unsigned) time(NULL) ^ (i * 2654435761u);
+        worker->first_conn_id = first_conn_id;
+        worker->connection_count = connections / threads + (i < connections % threads);
+        first_conn_id += worker->connection_count;
+        worker->conns = calloc(worker->connection_count, sizeof(loadgen_conn_t));
+        if (!worker->conns) {
+            log(FATAL, "Failed to allocate connections");
+        }
+    }
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, loadgen_run, &workers[i]) != 0) {
+            log(FATAL, "Failed to start thread %d", i);
+        }
+    }
+
+    long replies = 0;
+    long sent = 0;
+    long answered = 0;
+    long unanswered = 0;
+    long disconnects = 0;
+    double elapsed = 0;
+    double connect_time = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        replies += workers[i].replies;
+        sent += workers[i].sent;
+        answered += workers[i].answered;
+        unanswered += workers[i].unanswered;
+        disconnects += workers[i].disconnects;
+        if (workers[i].elapsed > elapsed) {
+            elapsed = workers[i].elapsed;
+        }
+        if (workers[i].connect_time > connect_time) {
+            connect_time = workers[i].connect_time;
+        }
+        free(workers[i].conns);
+    }
+
+    printf("connections=%d threads=%d seconds=%.2f sent=%ld replies=%ld msgs_per_sec=%.0f "
+           "connects_per_sec=%.0f answered=%ld unanswered=%ld disconnects=%ld\n",
+           connections, threads, elapsed, sent, replies, replies / elapsed,
+           connect_time > 0 ? connections / connect_time : 0, answered, unanswered, disconnects);
+
+    for (int a = 0; a < ACTION_COUNT; a++) {
+        metrics_summary_t summary;
+        metrics_summarize(HISTOGRAM_LATENCY_US + action_channels[a], &summary);
+        printf("latency action=%s count=%llu p50_us=%llu p99_us=%llu p999_us=%llu max_us=%llu\n",
+               action_names[a], (unsigned long long) summary.count, (unsigned long long) summary.p50,
+               (unsigned long long) summary.p99, (unsigned long long) summary.p999,
+               (unsigned long long) summary.max);
+    }
+
+    free(workers);
+    return 0;
+}
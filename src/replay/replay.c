@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "logger.h"
+#include "defs.h"
+#include "arena.h"
+#include "journal.h"
+#include "game_manager.h"
+#include "game_util.h"
+
+#define DEFAULT_LOOPS 1
+#define INITIAL_ROOM_CAPACITY 1024
+
+/*
+ * Rebuilds rooms from a server journal (journal.h). Each room gets a fresh
+ * game_manager in its own arena, seeded as the original was, and its events
+ * go through the same calls the server made, so after any prefix of the
+ * journal every manager is in the state the original was in at that point.
+ * Votes and phase changes are checked against the outcome recorded with
+ * them; the first one that differs (a rule changed since, or a journal from
+ * another build) is reported as a divergence.
+ *
+ * With -n the whole journal is replayed that many times, which makes a
+ * recorded production session a repeatable game-logic workload.
+ */
+
+typedef struct {
+    arena_t arena;              // NULL when the room is not open
+    game_manager_t game_manager;
+    long events;
+} replay_room_t;
+
+typedef struct {
+    replay_room_t *rooms;       // By room id
+    int room_capacity;
+    long room_filter;           // Only this room, -1 for all
+    bool verbose;
+    long events;                // Applied
+    long skipped;               // For rooms not open in this journal, or filtered out
+    long divergences;
+} replay_t;
+
+static double
+now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char *event_names[JOURNAL_EVENT_COUNT] = {
+    [JOURNAL_OPEN] = "open",
+    [JOURNAL_SEED] = "seed",
+    [JOURNAL_JOIN] = "join",
+    [JOURNAL_LEAVE] = "leave",
+    [JOURNAL_START] = "start",
+    [JOURNAL_VOTE] = "vote",
+    [JOURNAL_ADVANCE] = "advance",
+    [JOURNAL_END] = "end",
+    [JOURNAL_COMMAND] = "command",
+    [JOURNAL_CLOSE] = "close",
+};
+
+static const char *phase_names[] = {"lobby", "night", "day", "voting", "ended"};
+static const char *team_names[] = {"none", "village", "werewolves"};
+static const char *command_names[] = {"whisper", "vote", "ww"};
+
+static void
+print_record(long index, const journal_record_t *record)
+{
+    printf("event=%ld room=%u type=%s", index, record->room, event_names[record->type]);
+    switch (record->type) {
+        case JOURNAL_OPEN:
+            printf(" max_players=%lld seed=%llu", (long long) record->value, (unsigned long long) record->seed);
+            break;
+        case JOURNAL_SEED:
+            printf(" seed=%llu", (unsigned long long) record->seed);
+            break;
+        case JOURNAL_JOIN:
+        case JOURNAL_LEAVE:
+            printf(" socket=%lld", (long long) record->socket);
+            break;
+        case JOURNAL_VOTE:
+            printf(" socket=%lld target=%lld result=%lld", (long long) record->socket,
+                   (long long) record->value, (long long) record->result);
+            break;
+        case JOURNAL_ADVANCE:
+            printf(" phase=%s eliminated=%lld",
+                   record->value >= 0 && record->value <= GAME_STATE_ENDED ? phase_names[record->value] : "?",
+                   (long long) record->result);
+            break;
+        case JOURNAL_COMMAND:
+            printf(" socket=%lld command=%s target=%lld text=\"%.*s\"", (long long) record->socket,
+                   record->result >= 0 && record->result <= JOURNAL_COMMAND_WEREWOLF ? command_names[record->result] : "?",
+                   (long long) record->value, (int) record->text_len, record->text);
+            break;
+        default:
+            break;
+    }
+    putchar('\n');
+}
+
+static void
+close_room(replay_room_t *room)
+{
+    if (room->arena) {
+        game_manager_destroy(room->game_manager);
+        arena_destroy(room->arena);
+    }
+    memset(room, 0, sizeof(*room));
+}
+
+static replay_room_t *
+open_room(replay_t *replay, const journal_record_t *record)
+{
+    if (record->room >= (uint32_t) replay->room_capacity) {
+        int capacity = replay->room_capacity ? replay->room_capacity : INITIAL_ROOM_CAPACITY;
+        while ((uint32_t) capacity <= record->room) {
+            capacity *= 2;
+        }
+        replay_room_t *rooms = realloc(replay->rooms, sizeof(replay_room_t) * capacity);
+        if (!rooms) {
+            log(FATAL, "Failed to allocate %d rooms", capacity);
+        }
+        memset(rooms + replay->room_capacity, 0, sizeof(replay_room_t) * (capacity - replay->room_capacity));
+        replay->rooms = rooms;
+        replay->room_capacity = capacity;
+    }
+
+    replay_room_t *room = &replay->rooms[record->room];
+    close_room(room);
+    int max_players = (int) record->value;
+    room->arena = arena_create(game_manager_arena_size(max_players));
+    if (!room->arena || !(room->game_manager = game_manager_create(room->arena, max_players))) {
+        log(FATAL, "Failed to create room %u", record->room);
+    }
+    game_manager_seed(room->game_manager, record->seed);
+    return room;
+}
+
+static void
+diverged(replay_t *replay, long index, const journal_record_t *record, const char *what,
+         long long expected, long long got)
+{
+    if (replay->divergences++ == 0) {
+        fprintf(stderr, "Diverged at event %ld (room %u, %s): %s was %lld, replay gives %lld\n",
+                index, record->room, event_names[record->type], what, expected, got);
+    }
+}
+
+static void
+apply(replay_t *replay, long index, const journal_record_t *record)
+{
+    if (replay->room_filter >= 0 && record->room != replay->room_filter) {
+        replay->skipped++;
+        return;
+    }
+    if (replay->verbose) {
+        print_record(index, record);
+    }
+
+    if (record->type == JOURNAL_OPEN) {
+        open_room(replay, record);
+        replay->rooms[record->room].events++;
+        replay->events++;
+        return;
+    }
+    if (record->room >= (uint32_t) replay->room_capacity || !replay->rooms[record->room].arena) {
+        replay->skipped++;
+        return;
+    }
+
+    replay_room_t *room = &replay->rooms[record->room];
+    game_manager_t game_manager = room->game_manager;
+    room->events++;
+    replay->events++;
+    switch (record->type) {
+        case JOURNAL_SEED:
+            game_manager_seed(game_manager, record->seed);
+            break;
+        case JOURNAL_JOIN:
+            game_manager_add_player(game_manager, (int) record->socket);
+            break;
+        case JOURNAL_LEAVE:
+            game_manager_remove_player(game_manager, (int) record->socket);
+            break;
+        case JOURNAL_START:
+            game_manager_start_game(game_manager);
+            break;
+        case JOURNAL_VOTE: {
+            game_vote_result_t result = game_manager_cast_vote(game_manager, (int) record->socket,
+                                                               (int) record->value);
+            if (result != record->result) {
+                diverged(replay, index, record, "vote result", record->result, result);
+            }
+            break;
+        }
+        case JOURNAL_ADVANCE: {
+            game_phase_result_t result;
+            game_manager_advance_phase(game_manager, &result);
+            if (result.phase != record->value) {
+                diverged(replay, index, record, "next phase", record->value, result.phase);
+            } else if (result.eliminated_number != record->result) {
+                diverged(replay, index, record, "eliminated player", record->result, result.eliminated_number);
+            }
+            break;
+        }
+        case JOURNAL_END:
+            game_manager_end_game(game_manager);
+            break;
+        case JOURNAL_CLOSE:
+            close_room(room);
+            break;
+        default:
+            // Commands change nothing by themselves; what they did follows
+            break;
+    }
+}
+
+// Replays data; returns the events read, or RET_ERROR on a corrupt record.
+// Stops after limit events when limit >= 0.
+static long
+replay_journal(replay_t *replay, const uint8_t *data, size_t len, long limit, size_t *leftover)
+{
+    size_t offset = JOURNAL_HEADER_SIZE;
+    long index = 0;
+    while (offset < len && (limit < 0 || index < limit)) {
+        journal_record_t record;
+        int used = journal_decode(data + offset, len - offset, &record);
+        if (used < 0) {
+            log(ERROR, "Corrupt record at byte %zu", offset);
+            return RET_ERROR;
+        }
+        if (used == 0) {
+            break;      // Cut short, e.g. the server died mid-write
+        }
+        apply(replay, index++, &record);
+        offset += used;
+    }
+    *leftover = limit < 0 ? len - offset : 0;
+    return index;
+}
+
+static void
+print_room(int id, const replay_room_t *room)
+{
+    game_manager_t game_manager = room->game_manager;
+    game_state_t phase = game_manager_get_phase(game_manager);
+    game_team_t winner = game_manager_get_winner(game_manager);
+    printf("room=%d events=%ld phase=%s players=%d alive=%d winner=%s\n", id, room->events,
+           phase_names[phase], game_manager_get_player_count(game_manager),
+           game_manager_get_alive_count(game_manager), team_names[winner]);
+
+    const int *seats = game_manager_get_seat_sockets(game_manager);
+    for (int seat = 0; seat < game_manager_get_max_players(game_manager); seat++) {
+        int socket_id = seats[seat];
+        if (socket_id < 0) {
+            continue;
+        }
+        int number = seat + 1;
+        game_role_t role = game_manager_get_player_role(game_manager, socket_id);
+        printf("  player=%d socket=%d role=%s alive=%d votes=%d\n", number, socket_id,
+               role == ROLE_UNASSIGNED ? "Unassigned" : role_by_name(role),
+               game_manager_is_player_alive(game_manager, socket_id),
+               game_manager_get_votes_for(game_manager, number));
+    }
+}
+
+static void
+close_all(replay_t *replay)
+{
+    for (int i = 0; i < replay->room_capacity; i++) {
+        close_room(&replay->rooms[i]);
+    }
+}
+
+static uint8_t *
+read_file(const char *path, size_t *len)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        log(ERROR, "Cannot open %s: %s", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    uint8_t *data = malloc(st.st_size > 0 ? st.st_size : 1);
+    size_t done = 0;
+    while (data && done < (size_t) st.st_size) {
+        ssize_t n = read(fd, data + done, st.st_size - done);
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    close(fd);
+    if (!data) {
+        log(ERROR, "Failed to allocate %lld bytes for %s", (long long) st.st_size, path);
+        return NULL;
+    }
+    *len = done;
+    return data;
+}
+
+static void
+print_usage(const char *program_name)
+{
+    fprintf(stderr, "Usage: %s [-r room] [-u events] [-n loops] [-v] journal\n", program_name);
+    fprintf(stderr, "  -r room: Only replay this room\n");
+    fprintf(stderr, "  -u events: Stop after this many journal events and show the rooms as they were then\n");
+    fprintf(stderr, "  -n loops: Replay the whole journal this many times and report events/sec (default: %d)\n",
+            DEFAULT_LOOPS);
+    fprintf(stderr, "  -v: Print every event as it is applied\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    long limit = -1;
+    int loops = DEFAULT_LOOPS;
+    replay_t replay = { .room_filter = -1 };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:u:n:vh")) != -1) {
+        switch (opt) {
+            case 'r': replay.room_filter = atol(optarg); break;
+            case 'u': limit = atol(optarg); break;
+            case 'n': loops = atoi(optarg); break;
+            case 'v': replay.verbose = true; break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1 || loops < 1 || (limit >= 0 && loops != 1)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    set_log_level(WARN);
+    size_t len;
+    uint8_t *data = read_file(argv[optind], &len);
+    if (!data) {
+        return 1;
+    }
+    int64_t opened_ms = journal_decode_header(data, len);
+    if (opened_ms < 0) {
+        log(ERROR, "%s is not a version %d journal", argv[optind], JOURNAL_VERSION);
+        free(data);
+        return 1;
+    }
+
+    long read = 0;
+    size_t leftover = 0;
+    double start = now_sec();
+    for (int i = 0; i < loops; i++) {
+        if (i > 0) {
+            close_all(&replay);
+        }
+        read = replay_journal(&replay, data, len, limit, &leftover);
+        if (read < 0) {
+            break;
+        }
+    }
+    double elapsed = now_sec() - start;
+
+    if (read >= 0) {
+        long applied = replay.events;
+        printf("journal=%s opened_ms=%lld events=%ld applied=%ld skipped=%ld truncated_bytes=%zu "
+               "divergences=%ld loops=%d seconds=%.3f events_per_sec=%.0f\n",
+               argv[optind], (long long) opened_ms, read, applied / loops, replay.skipped / loops, leftover,
+               replay.divergences, loops, elapsed, elapsed > 0 ? applied / elapsed : 0);
+        for (int i = 0; i < replay.room_capacity; i++) {
+            if (replay.rooms[i].arena) {
+                print_room(i, &replay.rooms[i]);
+            }
+        }
+    }
+
+    close_all(&replay);
+    free(replay.rooms);
+    free(data);
+    return read < 0 || replay.divergences > 0 ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "logger.h"
+#include "defs.h"
+#include "metrics.h"
+#include "tcp_server_util.h"
+#include "util.h"
+#include "admin_server.h"
+
+#define ADMIN_HOST "127.0.0.1"
+#define ADMIN_BACKLOG 16
+#define ADMIN_TIMEOUT_SEC 2
+#define ADMIN_INITIAL_BUFFER (16 * 1024)
+
+static const char response_header[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: text/plain; version=0.0.4\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+static void
+write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t written = send(fd, data, len, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        len -= written;
+    }
+}
+
+static void
+serve_scrape(int client, char **body, size_t *capacity)
+{
+    // The request itself does not matter: every path returns the metrics
+    char request[BUFFER_SIZE];
+    if (recv(client, request, sizeof(request), 0) <= 0) {
+        return;
+    }
+
+    size_t len = metrics_render(*body, *capacity);
+    if (len >= *capacity) {
+        char *grown = realloc(*body, len + 1);
+        if (!grown) {
+            log(ERROR, "Failed to allocate %zu bytes for metrics", len + 1);
+            return;
+        }
+        *body = grown;
+        *capacity = len + 1;
+        len = metrics_render(*body, *capacity);
+    }
+
+    write_all(client, response_header, sizeof(response_header) - 1);
+    write_all(client, *body, len);
+}
+
+static void *
+admin_run(void *arg)
+{
+    int listener = (int) (intptr_t) arg;
+    size_t capacity = ADMIN_INITIAL_BUFFER;
+    char *body = malloc(capacity);
+    if (!body) {
+        log(ERROR, "Failed to allocate memory for metrics");
+        close(listener);
+        return NULL;
+    }
+
+    while (1) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                log(ERROR, "Admin accept() failed: %s", strerror(errno));
+            }
+            continue;
+        }
+        set_socket_timeout(client, ADMIN_TIMEOUT_SEC);
+        serve_scrape(client, &body, &capacity);
+        close(client);
+    }
+    return NULL;
+}
+
+int
+admin_server_start(const char *port)
+{
+    int listener = setup_tcp_server(ADMIN_HOST, port, ADMIN_BACKLOG, false);
+    if (listener < 0) {
+        log(ERROR, "Failed to open admin listener on %s:%s", ADMIN_HOST, port);
+        return RET_ERROR;
+    }
+
+    // The admin thread blocks in accept(); game listeners stay non-blocking
+    int flags = fcntl(listener, F_GETFL, 0);
+    fcntl(listener, F_SETFL, flags & ~O_NONBLOCK);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, admin_run, (void *) (intptr_t) listener) != 0) {
+        log(ERROR, "Failed to start admin thread");
+        close(listener);
+        return RET_ERROR;
+    }
+    pthread_detach(thread);
+
+    log(INFO, "Metrics available at http://%s:%s/metrics", ADMIN_HOST, port);
+    return RET_SUCCESS;
+}
+
+static void *
+dump_run(void *arg)
+{
+    sigset_t *set = arg;
+    while (1) {
+        int signo;
+        if (sigwait(set, &signo) == 0) {
+            metrics_log_latency();
+        }
+    }
+    return NULL;
+}
+
+int
+admin_dump_on_sigusr1(void)
+{
+    static sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
+        log(ERROR, "Failed to block SIGUSR1");
+        return RET_ERROR;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, dump_run, &set) != 0) {
+        log(ERROR, "Failed to start the SIGUSR1 dump thread");
+        return RET_ERROR;
+    }
+    pthread_detach(thread);
+    return RET_SUCCESS;
+}
@@ -1,85 +1,160 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include "command_handler.h"
 #include "defs.h"
+#include "game_flow.h"
 #include "game_manager.h"
 #include "game_messanger.h"
 #include "logger.h"
 
 
 // Function declarations
-static void handle_whisper_command(const char *buffer, int client_socket, 
+static void handle_whisper_command(const char *args, int client_socket, 
                                  game_manager_t game_manager);
-static void handle_werewolf_command(const char *buffer, int client_socket, 
-                                  game_manager_t game_manager);
+static void handle_vote_command(const char *args, int client_socket, room_t *room);
+static void whisper_player(int target_player_number, const char *message, int client_socket,
+                           game_manager_t game_manager);
+static void vote_player(long target_player_number, int client_socket, room_t *room);
+static void handle_werewolf_command(const char *message, int client_socket, room_t *room);
 
-int handle_if_command(const char *buffer, int client_socket, game_manager_t game_manager) 
+int handle_if_command(const char *buffer, int client_socket, room_t *room) 
 {
-    if (!buffer || !game_manager) {
+    if (!buffer || !room) {
         log(ERROR, "Invalid parameters in handle_if_command");
         return RET_ERROR;
     }
 
     static const char *WHISPER_CMD = "/whisper ";
+    static const char *VOTE_CMD = "/vote ";
     static const char *WEREWOLF_CMD = "/ww ";
 
     if (strncmp(buffer, WHISPER_CMD, strlen(WHISPER_CMD)) == 0) {
-        handle_whisper_command(buffer, client_socket, game_manager);
-        return RET_SUCCESS;
+        handle_whisper_command(buffer + strlen(WHISPER_CMD), client_socket, room->game_manager);
+        return 1;
+    }
+
+    if (strncmp(buffer, VOTE_CMD, strlen(VOTE_CMD)) == 0) {
+        handle_vote_command(buffer + strlen(VOTE_CMD), client_socket, room);
+        return 1;
     }
     
     if (strncmp(buffer, WEREWOLF_CMD, strlen(WEREWOLF_CMD)) == 0) {
-        handle_werewolf_command(buffer, client_socket, game_manager);
-        return RET_SUCCESS;
+        handle_werewolf_command(buffer + strlen(WEREWOLF_CMD), client_socket, room);
+        return 1;
+    }
+
+    return 0;
+}
+
+int handle_wire_command(const wire_record_t *record, int client_socket, room_t *room)
+{
+    if (!record || !room) {
+        log(ERROR, "Invalid parameters in handle_wire_command");
+        return RET_ERROR;
     }
 
-    return RET_ERROR;
+    switch (record->opcode) {
+        case WIRE_OP_MESSAGE:
+            if (record->channel == CHANNEL_WEREWOLF) {
+                handle_werewolf_command(record->text, client_socket, room);
+                return 1;
+            }
+            return 0;
+        case WIRE_OP_WHISPER:
+            whisper_player((int) record->target, record->text, client_socket, room->game_manager);
+            return 1;
+        case WIRE_OP_VOTE:
+            vote_player(record->target, client_socket, room);
+            return 1;
+        default:
+            log(WARN, "Client %d sent unknown opcode %d", client_socket, record->opcode);
+            return 1;
+    }
 }
 
-static void handle_whisper_command(const char *buffer, int client_socket, 
+// args: "<player number> <message>"
+static void handle_whisper_command(const char *args, int client_socket, 
                                  game_manager_t game_manager) 
 {
-    if (!buffer || !game_manager) {
-        log(ERROR, "Invalid parameters in handle_whisper_command");
+    char *end;
+    long target = strtol(args, &end, 10);
+    if (end == args || *end != ' ' || target <= 0 || target > INT_MAX) {
+        log(ERROR, "Invalid whisper command format");
+        return;
+    }
+    while (*end == ' ') {
+        end++;
+    }
+    if (*end == '\0') {
+        log(ERROR, "Invalid whisper command format");
         return;
     }
+    whisper_player((int) target, end, client_socket, game_manager);
+}
 
-    char *command_copy = (char *)malloc(strlen(buffer) + 1);
-    if (!command_copy) {
-        log(ERROR, "Memory allocation failed in handle_whisper_command");
+static void whisper_player(int target_player_number, const char *message, int client_socket,
+                           game_manager_t game_manager)
+{
+    game_manager_journal_command(game_manager, client_socket, JOURNAL_COMMAND_WHISPER,
+                                 target_player_number, message);
+    // Whispers are talk: the same rules as chat
+    game_state_t phase = game_manager_get_phase(game_manager);
+    if (phase != GAME_STATE_LOBBY && phase != GAME_STATE_ENDED &&
+        !game_manager_is_player_alive(game_manager, client_socket)) {
+        send_server_notice(client_socket, NOTICE_DEAD_CANNOT_TALK);
+        return;
+    }
+    if (phase == GAME_STATE_NIGHT) {
+        send_server_notice(client_socket, NOTICE_NIGHT_SILENCE);
         return;
     }
 
-    strcpy(command_copy, buffer);
-
-    char *rest = command_copy + strlen("/whisper");
-    char *player_id_str = strtok(rest, " ");
-    char *message = strtok(NULL, "");
-
-    if (player_id_str && message) {
-        int target_player_number = atoi(player_id_str);
-        int to_socketfd = game_manager_get_socket_by_player_number(game_manager, 
-                                                                 target_player_number);
-        int from_player_number = game_manager_get_player_number(game_manager, client_socket);
-        
-        if (to_socketfd > 0 && client_socket > 0) {
-            send_whisper(client_socket, to_socketfd, from_player_number, 
-                        target_player_number, message);
-        } else {
-            log(ERROR, "Invalid socket or player numbers in whisper command");
-        }
+    int to_socketfd = game_manager_get_socket_by_player_number(game_manager, 
+                                                             target_player_number);
+    int from_player_number = game_manager_get_player_number(game_manager, client_socket);
+
+    if (to_socketfd > 0 && client_socket > 0) {
+        send_whisper(client_socket, to_socketfd, from_player_number, 
+                    target_player_number, message);
     } else {
-        log(ERROR, "Invalid whisper command format");
+        log(ERROR, "Invalid socket or player numbers in whisper command");
     }
+}
 
-    free(command_copy);
+// args: "<player number>"
+static void handle_vote_command(const char *args, int client_socket, room_t *room)
+{
+    char *end;
+    long target = strtol(args, &end, 10);
+    vote_player(end == args ? 0 : target, client_socket, room);
 }
 
-static void handle_werewolf_command(const char *buffer, int client_socket, 
-                                  game_manager_t game_manager) 
+static void vote_player(long target_player_number, int client_socket, room_t *room)
 {
-    // TODO: Implement werewolf command handling
-    log(INFO, "Werewolf command not yet implemented");
-}
\ No newline at end of file
+    game_manager_journal_command(room->game_manager, client_socket, JOURNAL_COMMAND_VOTE,
+                                 target_player_number <= INT_MAX ? (int) target_player_number : 0, NULL);
+    if (target_player_number <= 0 || target_player_number > INT_MAX) {
+        send_server_notice(client_socket, NOTICE_VOTE_USAGE);
+        return;
+    }
+    game_flow_vote(room, client_socket, (int) target_player_number);
+}
+
+// Werewolf team chat, open to living werewolves in any phase
+static void handle_werewolf_command(const char *message, int client_socket, room_t *room)
+{
+    game_manager_t game_manager = room->game_manager;
+    game_manager_journal_command(game_manager, client_socket, JOURNAL_COMMAND_WEREWOLF, 0, message);
+    if (!game_manager_is_player_werewolf(game_manager, client_socket) ||
+        !game_manager_is_player_alive(game_manager, client_socket)) {
+        send_server_notice(client_socket, NOTICE_WEREWOLVES_ONLY);
+        return;
+    }
+
+    int sender_number = game_manager_get_player_number(game_manager, client_socket);
+    forward_message(CHANNEL_WEREWOLF, &room->channels[CHANNEL_WEREWOLF].members,
+                    game_manager_get_seat_sockets(game_manager), sender_number, message);
+}
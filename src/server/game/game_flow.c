@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "defs.h"
+#include "game_flow.h"
+#include "game_manager.h"
+#include "game_messanger.h"
+#include "game_util.h"
+
+const game_timing_t GAME_TIMING_STANDARD = {.night_sec = 60, .day_sec = 180, .voting_sec = 60};
+const game_timing_t GAME_TIMING_SPEED = {.night_sec = 30, .day_sec = 60, .voting_sec = 30};
+
+static const game_timing_t *timing = &GAME_TIMING_STANDARD;
+// [role * (max_players + 1) + player number] -> role reveal, read-only once built
+static prerendered_message_t *role_reveals = NULL;
+static int role_reveal_players = 0;
+
+void
+game_flow_set_timing(const game_timing_t *new_timing)
+{
+    timing = new_timing;
+}
+
+size_t
+game_flow_arena_size(int max_players)
+{
+    return arena_footprint(sizeof(int) * max_players) + arena_footprint(sizeof(game_role_t) * max_players);
+}
+
+int
+game_flow_prerender(int max_players)
+{
+    prerendered_message_t *reveals = calloc((size_t) GAME_ROLE_COUNT * (max_players + 1), sizeof(*reveals));
+    if (!reveals) {
+        log(ERROR, "Failed to allocate role reveals");
+        return RET_ERROR;
+    }
+
+    char message[PRERENDERED_SIZE];
+    for (int role = ROLE_VILLAGER; role < GAME_ROLE_COUNT; role++) {
+        snprintf(message, sizeof(message), "You are a %s!", role_by_name(role));
+        for (int number = 1; number <= max_players; number++) {
+            if (prerender_message(&reveals[role * (max_players + 1) + number], CHANNEL_ANNOUNCEMENT,
+                                  number, message) < 0) {
+                free(reveals);
+                return RET_ERROR;
+            }
+        }
+    }
+    free(role_reveals);
+    role_reveals = reveals;
+    role_reveal_players = max_players;
+    return RET_SUCCESS;
+}
+
+static void
+reveal_role(int socket_id, game_role_t role, int player_number)
+{
+    if (role_reveals && role > ROLE_UNASSIGNED && role < GAME_ROLE_COUNT &&
+        player_number > 0 && player_number <= role_reveal_players) {
+        send_prerendered(socket_id, &role_reveals[role * (role_reveal_players + 1) + player_number]);
+        return;
+    }
+
+    char message[PRERENDERED_SIZE];
+    snprintf(message, sizeof(message), "You are a %s!", role_by_name(role));
+    send_message(socket_id, CHANNEL_ANNOUNCEMENT, message, player_number);
+}
+
+static int
+phase_seconds(game_state_t phase)
+{
+    switch (phase) {
+        case GAME_STATE_NIGHT: return timing->night_sec;
+        case GAME_STATE_DAY: return timing->day_sec;
+        case GAME_STATE_VOTING: return timing->voting_sec;
+        default: return 0;
+    }
+}
+
+static void
+announce(room_t *room, const char *message)
+{
+    forward_message(CHANNEL_ANNOUNCEMENT, &room->channels[CHANNEL_ANNOUNCEMENT].members,
+                    game_manager_get_seat_sockets(room->game_manager), 0, message);
+}
+
+static void
+tell_werewolves(room_t *room, const char *message)
+{
+    forward_message(CHANNEL_WEREWOLF, &room->channels[CHANNEL_WEREWOLF].members,
+                    game_manager_get_seat_sockets(room->game_manager), 0, message);
+}
+
+// Announces actors' message to the seats in actors and others' message to
+// the rest of the room. actors is combined with the announcement members, so
+// it may hold seats that are not in the room.
+static void
+announce_split(room_t *room, const bitset_t *actors, const char *actors_message, const char *others_message)
+{
+    const bitset_t *everyone = &room->channels[CHANNEL_ANNOUNCEMENT].members;
+    int max_players = game_manager_get_max_players(room->game_manager);
+    const int *seat_sockets = game_manager_get_seat_sockets(room->game_manager);
+
+    // Room scratch: fixed sets of max_players bits cannot grow, so never allocate
+    size_t mark = arena_mark(room->arena);
+    uint64_t *words = arena_alloc(room->arena, sizeof(uint64_t) * BITSET_WORDS(max_players) * 2);
+    if (!words) {
+        log(ERROR, "Room %d: no scratch for a targeted announcement", room->id);
+        announce(room, actors_message);
+        return;
+    }
+    bitset_t targeted, rest;
+    bitset_init_fixed(&targeted, words, max_players);
+    bitset_init_fixed(&rest, words + BITSET_WORDS(max_players), max_players);
+
+    if (bitset_and(&targeted, everyone, actors) >= 0 && bitset_and_not(&rest, everyone, actors) >= 0) {
+        // An empty side (no dead yet) is not a message
+        if (bitset_next(&targeted, 0) >= 0) {
+            forward_message(CHANNEL_ANNOUNCEMENT, &targeted, seat_sockets, 0, actors_message);
+        }
+        if (bitset_next(&rest, 0) >= 0) {
+            forward_message(CHANNEL_ANNOUNCEMENT, &rest, seat_sockets, 0, others_message);
+        }
+    } else {
+        announce(room, actors_message);
+    }
+    arena_rewind(room->arena, mark);
+}
+
+static void phase_deadline(void *arg);
+
+// Tells the room what the new phase expects and arms its deadline. Only the
+// players who can act get the /vote prompt: the pack at night, the living by
+// day. Everyone else is told what is going on.
+static void
+open_phase(room_t *room, game_state_t phase)
+{
+    char prompt[BUFFER_SIZE];
+    char watch[BUFFER_SIZE];
+    const bitset_t *actors = game_manager_get_alive_seats(room->game_manager);
+    int seconds = phase_seconds(phase);
+    switch (phase) {
+        case GAME_STATE_NIGHT:
+            actors = &room->channels[CHANNEL_WEREWOLF].members;
+            snprintf(prompt, sizeof(prompt),
+                     "Night falls. Werewolves, choose your victim with /vote <player> (%d seconds).", seconds);
+            snprintf(watch, sizeof(watch),
+                     "Night falls. The werewolves are choosing their victim (%d seconds).", seconds);
+            break;
+        case GAME_STATE_DAY:
+            snprintf(prompt, sizeof(prompt),
+                     "Discuss for %d seconds, or /vote <player> to open the vote now.", seconds);
+            snprintf(watch, sizeof(watch), "The village discusses for %d seconds.", seconds);
+            break;
+        case GAME_STATE_VOTING:
+            snprintf(prompt, sizeof(prompt),
+                     "Voting is open for %d seconds: /vote <player>. The player with the most votes is "
+                     "eliminated, a tie spares everyone.", seconds);
+            snprintf(watch, sizeof(watch), "The village votes for %d seconds.", seconds);
+            break;
+        default:
+            timer_wheel_cancel(room->timers, &room->phase_timer);
+            return;
+    }
+    announce_split(room, actors, prompt, watch);
+    timer_wheel_schedule(room->timers, &room->phase_timer, (uint64_t) seconds * 1000);
+}
+
+// Winner and every player's role, in one announcement
+static void
+announce_winner(room_t *room, game_team_t winner)
+{
+    game_manager_t game_manager = room->game_manager;
+    char message[BUFFER_SIZE];
+    int len = snprintf(message, sizeof(message), "%s Roles:",
+                       winner == TEAM_VILLAGE ? "The village wins!" : "The werewolves win!");
+
+    size_t mark = arena_mark(room->arena);
+    int *player_sockets = arena_alloc(room->arena, sizeof(int) * game_manager_get_player_count(game_manager));
+    int player_count = player_sockets ? game_manager_get_players_sockets(game_manager, player_sockets) : 0;
+    for (int i = 0; i < player_count && len < (int) sizeof(message); i++) {
+        len += snprintf(message + len, sizeof(message) - len, " Player %d %s,",
+                        game_manager_get_player_number(game_manager, player_sockets[i]),
+                        role_by_name(game_manager_get_player_role(game_manager, player_sockets[i])));
+    }
+    arena_rewind(room->arena, mark);
+    if (len > 0 && len < (int) sizeof(message) && message[len - 1] == ',') {
+        message[len - 1] = '\0';
+    }
+
+    announce(room, message);
+    log(INFO, "Room %d: %s", room->id, winner == TEAM_VILLAGE ? "village wins" : "werewolves win");
+}
+
+static void
+end_game(room_t *room, game_team_t winner)
+{
+    timer_wheel_cancel(room->timers, &room->phase_timer);
+    announce_winner(room, winner);
+}
+
+void
+game_flow_start(room_t *room)
+{
+    game_manager_t game_manager = room->game_manager;
+    int player_count = game_manager_get_player_count(game_manager);
+
+    log(INFO, "Room %d has enough players (%d players), starting game...", room->id, player_count);
+    game_manager_start_game(game_manager);
+
+    // Player sockets and roles for notification, as room scratch
+    size_t mark = arena_mark(room->arena);
+    int *player_sockets = arena_alloc(room->arena, sizeof(int) * player_count);
+    game_role_t *player_roles = arena_alloc(room->arena, sizeof(game_role_t) * player_count);
+    if (!player_sockets || !player_roles) {
+        log(ERROR, "Failed to allocate memory for role announcements");
+        arena_rewind(room->arena, mark);
+        return;
+    }
+    game_manager_get_players_sockets(game_manager, player_sockets);
+
+    for (int i = 0; i < player_count; i++) {
+        player_roles[i] = game_manager_get_player_role(game_manager, player_sockets[i]);
+        if (player_roles[i] == ROLE_WEREWOLF) {
+            subscribe_to_channel(&room->channels[CHANNEL_WEREWOLF],
+                                 game_manager_get_player_seat(game_manager, player_sockets[i]));
+        }
+    }
+
+    int werewolf_count = game_manager_get_werewolf_count(game_manager);
+    for (int i = 0; i < player_count; i++) {
+        int player_number = game_manager_get_player_number(game_manager, player_sockets[i]);
+        reveal_role(player_sockets[i], player_roles[i], player_number);
+
+        if (player_roles[i] == ROLE_WEREWOLF && werewolf_count-1 > 0) {
+            char team_message[BUFFER_SIZE] = "Your werewolf teammates are: ";
+            size_t len = strlen(team_message);
+            const char *separator = "";
+            for (int j = 0; j < player_count; j++) {
+                if (i != j && player_roles[j] == ROLE_WEREWOLF && len < sizeof(team_message)) {
+                    len += snprintf(team_message + len, sizeof(team_message) - len, "%sPlayer %d", separator,
+                                    game_manager_get_player_number(game_manager, player_sockets[j]));
+                    separator = ", ";
+                }
+            }
+            send_message(player_sockets[i], CHANNEL_ANNOUNCEMENT, team_message, player_number);
+        }
+    }
+
+    arena_rewind(room->arena, mark);
+
+    timer_init(&room->phase_timer, phase_deadline, room);
+    open_phase(room, game_manager_get_phase(game_manager));
+}
+
+void
+game_flow_advance(room_t *room)
+{
+    game_phase_result_t result;
+    if (game_manager_advance_phase(room->game_manager, &result) < 0) {
+        return;
+    }
+
+    char message[BUFFER_SIZE];
+    if (result.closed_phase == GAME_STATE_NIGHT) {
+        if (result.eliminated_number > 0) {
+            snprintf(message, sizeof(message), "Day breaks. Player %d was killed in the night.",
+                     result.eliminated_number);
+        } else {
+            snprintf(message, sizeof(message), "Day breaks. Nobody died tonight.");
+        }
+        announce(room, message);
+    } else if (result.closed_phase == GAME_STATE_VOTING) {
+        if (result.eliminated_number > 0) {
+            snprintf(message, sizeof(message), "The village eliminated Player %d. They were a %s.",
+                     result.eliminated_number, role_by_name(result.eliminated_role));
+        } else {
+            snprintf(message, sizeof(message), "The vote is tied, nobody is eliminated.");
+        }
+        announce(room, message);
+    }
+
+    if (result.eliminated_role == ROLE_WEREWOLF) {
+        // The werewolf channel is the living pack
+        unsubscribe_from_channel(&room->channels[CHANNEL_WEREWOLF], result.eliminated_number - 1);
+    }
+    if (result.eliminated_socket >= 0) {
+        send_server_notice(result.eliminated_socket, NOTICE_YOU_ARE_DEAD);
+    }
+
+    if (result.winner != TEAM_NONE) {
+        end_game(room, result.winner);
+        return;
+    }
+    open_phase(room, result.phase);
+}
+
+// phase_timer callback
+static void
+phase_deadline(void *arg)
+{
+    room_t *room = arg;
+    if (game_manager_get_phase(room->game_manager) != GAME_STATE_DAY) {
+        announce(room, "Time is up.");
+    }
+    game_flow_advance(room);
+}
+
+void
+game_flow_check(room_t *room)
+{
+    game_manager_t game_manager = room->game_manager;
+    game_state_t phase = game_manager_get_phase(game_manager);
+    if (phase != GAME_STATE_NIGHT && phase != GAME_STATE_DAY && phase != GAME_STATE_VOTING) {
+        return;
+    }
+
+    game_team_t winner = game_manager_get_winner(game_manager);
+    if (winner != TEAM_NONE) {
+        game_manager_end_game(game_manager);
+        end_game(room, winner);
+        return;
+    }
+
+    if (game_manager_votes_complete(game_manager)) {
+        game_flow_advance(room);
+    }
+}
+
+void
+game_flow_vote(room_t *room, int socket_id, int target_player_number)
+{
+    game_manager_t game_manager = room->game_manager;
+    game_state_t phase = game_manager_get_phase(game_manager);
+    // Checked first: by day the advance below is skipped for the dead, and
+    // the vote would then be refused as "no vote right now"
+    if ((phase == GAME_STATE_NIGHT || phase == GAME_STATE_DAY || phase == GAME_STATE_VOTING) &&
+        !game_manager_is_player_alive(game_manager, socket_id)) {
+        send_server_notice(socket_id, NOTICE_DEAD_CANNOT_VOTE);
+        return;
+    }
+    if (phase == GAME_STATE_DAY) {
+        game_flow_advance(room);
+    }
+
+    phase = game_manager_get_phase(game_manager);
+    int voter_number = game_manager_get_player_number(game_manager, socket_id);
+    char message[BUFFER_SIZE];
+    switch (game_manager_cast_vote(game_manager, socket_id, target_player_number)) {
+        case VOTE_ACCEPTED:
+            break;
+        case VOTE_NOT_NOW:
+            send_server_notice(socket_id, NOTICE_NO_VOTE);
+            return;
+        case VOTE_NOT_ALLOWED:
+            send_server_notice(socket_id, phase == GAME_STATE_NIGHT && game_manager_is_player_alive(game_manager, socket_id)
+                                          ? NOTICE_NIGHT_VOTE : NOTICE_DEAD_CANNOT_VOTE);
+            return;
+        case VOTE_BAD_TARGET:
+            snprintf(message, sizeof(message), "You cannot vote for Player %d.", target_player_number);
+            send_server_message(socket_id, message);
+            return;
+    }
+
+    int votes = game_manager_get_votes_for(game_manager, target_player_number);
+    if (phase == GAME_STATE_NIGHT) {
+        snprintf(message, sizeof(message), "Player %d wants to kill Player %d (%d %s).",
+                 voter_number, target_player_number, votes, votes == 1 ? "vote" : "votes");
+        tell_werewolves(room, message);
+    } else {
+        snprintf(message, sizeof(message), "Player %d votes for Player %d (%d %s).",
+                 voter_number, target_player_number, votes, votes == 1 ? "vote" : "votes");
+        announce(room, message);
+    }
+
+    game_flow_check(room);
+}
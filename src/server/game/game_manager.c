@@ -1,19 +1,22 @@
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 #include "logger.h"
+#include "arena.h"
+#include "bitset.h"
+#include "rng.h"
 #include "game_manager.h"
 #include "game_config.h"
-
-typedef struct player_t {
-    int socket_id;
-    int player_number;
-    game_role_t role;
-    bool is_alive;
-    bool is_protected;  
-    bool has_used_ability;
-    struct player_t *next;  // For player list
-} player_t;
+#include "metrics.h"
+
+/*
+ * Players live in a dense table of max_players slots. A slot is also the
+ * player's seat (channel bitsets are indexed by it) and fixes the player
+ * number at slot + 1, so numbers stay stable and unique while a player is
+ * in the room. Per-player data is kept as parallel arrays, with the flags
+ * the game loop tests most as bitsets over slots. All of it is carved out of
+ * the owner's arena when the manager is created, so nothing is allocated
+ * while a game runs.
+ */
 
 typedef struct role_state_t {
     int total_count;
@@ -21,23 +24,69 @@ typedef struct role_state_t {
     int protected_count;  
 } role_state_t;
 
+/*
+ * Votes of the current round (a night kill or a day lynch). Targets are kept
+ * in one doubly linked bucket per vote count, so moving a target up or down
+ * one vote, and knowing the highest count and who holds it, are all O(1)
+ * whatever the room size. Entries stamped with an older round read as empty,
+ * which is how a new round starts without clearing anything. Each target
+ * also keeps the list of its voters, so a target leaving can send them all
+ * back to vote again.
+ */
+typedef struct vote_tally_t {
+    int *cast;              // voter slot -> target slot
+    unsigned *cast_round;
+    int *voter_next;        // voter slot -> next/previous voter for the same target
+    int *voter_prev;
+    int *voter_head;        // target slot -> first voter, valid while it has votes
+    int *received;          // target slot -> votes
+    unsigned *received_round;
+    int *next;              // target slot -> next/previous slot in its bucket
+    int *prev;
+    int *bucket_head;       // vote count -> first target slot, -1 when empty
+    int *bucket_size;
+    unsigned *bucket_round;
+    int max_votes;          // Highest count any target holds
+    int voters;             // Votes cast this round
+    unsigned round;
+} vote_tally_t;
+
 typedef struct game_state_data_t {
     bool is_night;
     bool is_game_started;
     game_state_t current_phase;  
     int day_count;
     int night_count;
+    struct timespec phase_started;
 } game_state_data_t;
 
 typedef struct game_manager_cdt {
-    player_t *players;  // Linked list of players
+    arena_t arena;          // Owner's; also holds start-of-game scratch
+    // Slot table
+    int *sockets;           // slot -> socket_id, -1 when free
+    game_role_t *roles_by_slot;
+    bitset_t used;
+    bitset_t alive;
+    bitset_t protected;
+    bitset_t used_ability;
+    int *free_slots;        // Stack of free slots
+    int free_count;
+
+    // socket_id -> slot, open addressing with linear probing
+    int *socket_keys;       // -1 when empty
+    int *socket_slots;
+    int socket_mask;
+
     int max_players;
     int player_count;
     int alive_count;
     role_state_t roles[GAME_ROLE_COUNT];
     game_state_data_t state;
-    int *votes;  // Array of socket_ids for votes
-    int vote_count;
+    vote_tally_t votes;
+    rng_t rng;              // Role shuffles
+    uint64_t seed;          // Last seed rng was given
+    journal_t journal;      // NULL when not recording
+    int journal_room;
 } game_manager_cdt;
 
 // Add these validation macros near the top with the other macros:
@@ -92,53 +141,382 @@ typedef struct game_manager_cdt {
         } \
     } while(0)
 
-// Find player by socket_id
-static player_t *find_player_by_socket(game_manager_t game_manager, int socket_id) {
-    VALIDATE_GAME_MANAGER_PTR(game_manager);
-    VALIDATE_SOCKET_ID_WITH_NULL(socket_id);
+static inline int
+hash_socket(game_manager_t game_manager, int socket_id)
+{
+    return (int) ((unsigned) socket_id * 2654435761u) & game_manager->socket_mask;
+}
+
+// Slot of socket_id, or -1
+static int
+find_slot_by_socket(game_manager_t game_manager, int socket_id)
+{
+    if (!game_manager || socket_id < 0) {
+        return -1;
+    }
+
+    for (int i = hash_socket(game_manager, socket_id);; i = (i + 1) & game_manager->socket_mask) {
+        if (game_manager->socket_keys[i] == socket_id) {
+            return game_manager->socket_slots[i];
+        }
+        if (game_manager->socket_keys[i] < 0) {
+            return -1;
+        }
+    }
+}
+
+static void
+socket_map_insert(game_manager_t game_manager, int socket_id, int slot)
+{
+    int i = hash_socket(game_manager, socket_id);
+    while (game_manager->socket_keys[i] >= 0) {
+        i = (i + 1) & game_manager->socket_mask;
+    }
+    game_manager->socket_keys[i] = socket_id;
+    game_manager->socket_slots[i] = slot;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+static void
+socket_map_remove(game_manager_t game_manager, int socket_id)
+{
+    int mask = game_manager->socket_mask;
+    int i = hash_socket(game_manager, socket_id);
+    while (game_manager->socket_keys[i] != socket_id) {
+        if (game_manager->socket_keys[i] < 0) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
 
-    player_t *player = game_manager->players;
-    while (player) {
-        if (player->socket_id == socket_id) {
-            return player;
+    int hole = i;
+    for (int j = (hole + 1) & mask; game_manager->socket_keys[j] >= 0; j = (j + 1) & mask) {
+        int home = hash_socket(game_manager, game_manager->socket_keys[j]);
+        // Move j back if its home is not cyclically within (hole, j]
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            game_manager->socket_keys[hole] = game_manager->socket_keys[j];
+            game_manager->socket_slots[hole] = game_manager->socket_slots[j];
+            hole = j;
         }
-        player = player->next;
     }
-    return NULL;
+    game_manager->socket_keys[hole] = -1;
+}
+
+static void
+journal_event(game_manager_t game_manager, journal_event_t type, int64_t socket, int64_t value, int64_t result)
+{
+    if (!game_manager->journal) {
+        return;
+    }
+    journal_record_t record = {
+        .type = type,
+        .room = game_manager->journal_room,
+        .socket = socket,
+        .value = value,
+        .result = result,
+        .seed = game_manager->seed,
+    };
+    journal_append(game_manager->journal, &record);
 }
 
+// Moves the room to phase, accounting the time spent in the previous one
 static void
-shuffle_array(int *array, int size)
+set_phase(game_manager_t game_manager, game_state_t phase)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    game_state_t previous = game_manager->state.current_phase;
+    long elapsed_ms = (now.tv_sec - game_manager->state.phase_started.tv_sec) * 1000 +
+                      (now.tv_nsec - game_manager->state.phase_started.tv_nsec) / 1000000;
+    metrics_observe(HISTOGRAM_PHASE_DURATION_MS + previous, elapsed_ms);
+    metrics_gauge_add(GAUGE_ROOMS + previous, -1);
+    metrics_gauge_add(GAUGE_ROOMS + phase, 1);
+
+    game_manager->state.current_phase = phase;
+    game_manager->state.phase_started = now;
+}
+
+static size_t
+vote_tally_arena_size(int max_players)
+{
+    return 9 * arena_footprint(sizeof(int) * max_players) +
+           3 * arena_footprint(sizeof(int) * (max_players + 1));
+}
+
+static int
+vote_tally_init(vote_tally_t *tally, arena_t arena, int max_players)
+{
+    // Zeroed rounds read as stale; round 0 is never current
+    tally->cast = arena_alloc(arena, sizeof(int) * max_players);
+    tally->cast_round = arena_alloc(arena, sizeof(unsigned) * max_players);
+    tally->voter_next = arena_alloc(arena, sizeof(int) * max_players);
+    tally->voter_prev = arena_alloc(arena, sizeof(int) * max_players);
+    tally->voter_head = arena_alloc(arena, sizeof(int) * max_players);
+    tally->received = arena_alloc(arena, sizeof(int) * max_players);
+    tally->received_round = arena_alloc(arena, sizeof(unsigned) * max_players);
+    tally->next = arena_alloc(arena, sizeof(int) * max_players);
+    tally->prev = arena_alloc(arena, sizeof(int) * max_players);
+    tally->bucket_head = arena_alloc(arena, sizeof(int) * (max_players + 1));
+    tally->bucket_size = arena_alloc(arena, sizeof(int) * (max_players + 1));
+    tally->bucket_round = arena_alloc(arena, sizeof(unsigned) * (max_players + 1));
+    tally->max_votes = 0;
+    tally->voters = 0;
+    tally->round = 1;
+    if (!tally->cast || !tally->cast_round || !tally->voter_next || !tally->voter_prev ||
+        !tally->voter_head || !tally->received || !tally->received_round ||
+        !tally->next || !tally->prev || !tally->bucket_head || !tally->bucket_size || !tally->bucket_round) {
+        return RET_ERROR;
+    }
+    return RET_SUCCESS;
+}
+
+// Forgets every vote in O(1)
+static void
+vote_tally_new_round(vote_tally_t *tally)
+{
+    tally->round++;
+    tally->max_votes = 0;
+    tally->voters = 0;
+}
+
+static int
+votes_received(const vote_tally_t *tally, int target)
+{
+    return tally->received_round[target] == tally->round ? tally->received[target] : 0;
+}
+
+static void
+bucket_touch(vote_tally_t *tally, int count)
+{
+    if (tally->bucket_round[count] != tally->round) {
+        tally->bucket_round[count] = tally->round;
+        tally->bucket_head[count] = -1;
+        tally->bucket_size[count] = 0;
+    }
+}
+
+static int
+bucket_size(vote_tally_t *tally, int count)
+{
+    bucket_touch(tally, count);
+    return tally->bucket_size[count];
+}
+
+// Moves target from its current bucket to the one for count votes
+static void
+set_votes_received(vote_tally_t *tally, int target, int count)
+{
+    int old = votes_received(tally, target);
+    if (old > 0) {
+        bucket_touch(tally, old);
+        if (tally->prev[target] >= 0) {
+            tally->next[tally->prev[target]] = tally->next[target];
+        } else {
+            tally->bucket_head[old] = tally->next[target];
+        }
+        if (tally->next[target] >= 0) {
+            tally->prev[tally->next[target]] = tally->prev[target];
+        }
+        tally->bucket_size[old]--;
+    }
+
+    tally->received[target] = count;
+    tally->received_round[target] = tally->round;
+    if (count > 0) {
+        bucket_touch(tally, count);
+        tally->prev[target] = -1;
+        tally->next[target] = tally->bucket_head[count];
+        if (tally->bucket_head[count] >= 0) {
+            tally->prev[tally->bucket_head[count]] = target;
+        }
+        tally->bucket_head[count] = target;
+        tally->bucket_size[count]++;
+    }
+
+    if (count > tally->max_votes) {
+        tally->max_votes = count;
+    }
+    // A vote moving away lands one bucket down; only a departing target
+    // (dropped to 0) can leave a longer walk
+    while (tally->max_votes > 0 && bucket_size(tally, tally->max_votes) == 0) {
+        tally->max_votes--;
+    }
+}
+
+// Slot with the most votes, or -1 when there are none or the top is tied
+static int
+vote_tally_leader(vote_tally_t *tally)
+{
+    if (tally->max_votes == 0 || bucket_size(tally, tally->max_votes) != 1) {
+        return -1;
+    }
+    return tally->bucket_head[tally->max_votes];
+}
+
+static bool
+can_vote(game_manager_t game_manager, int slot)
+{
+    if (!bitset_test(&game_manager->alive, slot)) {
+        return false;
+    }
+    switch (game_manager->state.current_phase) {
+        case GAME_STATE_NIGHT:
+            return game_manager->roles_by_slot[slot] == ROLE_WEREWOLF;
+        case GAME_STATE_VOTING:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Takes back the vote cast by voter this round, if any
+static void
+withdraw_vote(game_manager_t game_manager, int voter)
+{
+    vote_tally_t *tally = &game_manager->votes;
+    if (tally->cast_round[voter] != tally->round) {
+        return;
+    }
+    tally->cast_round[voter] = 0;
+    tally->voters--;
+
+    int target = tally->cast[voter];
+    int prev = tally->voter_prev[voter];
+    int next = tally->voter_next[voter];
+    if (prev >= 0) {
+        tally->voter_next[prev] = next;
+    } else {
+        tally->voter_head[target] = next;
+    }
+    if (next >= 0) {
+        tally->voter_prev[next] = prev;
+    }
+    set_votes_received(tally, target, votes_received(tally, target) - 1);
+}
+
+// Takes back every vote cast for target this round; its voters have to vote
+// again before the round is complete
+static void
+withdraw_votes_for(game_manager_t game_manager, int target)
+{
+    vote_tally_t *tally = &game_manager->votes;
+    if (votes_received(tally, target) == 0) {
+        return;
+    }
+    for (int voter = tally->voter_head[target]; voter >= 0; voter = tally->voter_next[voter]) {
+        tally->cast_round[voter] = 0;
+        tally->voters--;
+    }
+    set_votes_received(tally, target, 0);
+}
+
+static void
+kill_player(game_manager_t game_manager, int slot)
+{
+    game_role_t role = game_manager->roles_by_slot[slot];
+    bitset_clear(&game_manager->alive, slot);
+    game_manager->alive_count--;
+    game_manager->roles[role].alive_count--;
+    if (bitset_test(&game_manager->protected, slot)) {
+        bitset_clear(&game_manager->protected, slot);
+        game_manager->roles[role].protected_count--;
+    }
+}
+
+static void
+shuffle_array(rng_t *rng, int *array, int size)
 {
     for (int i = size - 1; i > 0; i--) {
-        int j = rand() % (i + 1);
+        int j = rng_below(rng, i + 1);
         int temp = array[i];
         array[i] = array[j];
         array[j] = temp;
     }
 }
 
+// At most half full, so probe chains stay short
+static int
+socket_map_size(int max_players)
+{
+    int map_size = 4;
+    while (map_size < max_players * 2) {
+        map_size <<= 1;
+    }
+    return map_size;
+}
+
+size_t
+game_manager_arena_size(int max_players)
+{
+    return arena_footprint(sizeof(game_manager_cdt)) +
+           2 * arena_footprint(sizeof(int) * max_players) +               // sockets, free_slots
+           arena_footprint(sizeof(game_role_t) * max_players) +
+           2 * arena_footprint(sizeof(int) * socket_map_size(max_players)) +
+           4 * arena_footprint(sizeof(uint64_t) * BITSET_WORDS(max_players)) +
+           vote_tally_arena_size(max_players) +
+           arena_footprint(sizeof(int) * max_players);                    // Role assignment scratch
+}
+
 game_manager_t
-game_manager_create(int max_players)
+game_manager_create(arena_t arena, int max_players)
 {
-    game_manager_cdt *game_manager = malloc(sizeof(game_manager_cdt));
+    game_manager_cdt *game_manager = arena_alloc(arena, sizeof(game_manager_cdt));
     if (!game_manager) {
         log(ERROR, "Failed to allocate memory for game manager");
         return NULL;
     }
+    game_manager->arena = arena;
+
+    // Counted from here so the error path below can go through destroy
+    game_manager->state.current_phase = GAME_STATE_LOBBY;
+    clock_gettime(CLOCK_MONOTONIC, &game_manager->state.phase_started);
+    // Rooms opened in the same nanosecond still shuffle differently
+    game_manager->seed = ((uint64_t) game_manager->state.phase_started.tv_sec * 1000000000ull +
+                          game_manager->state.phase_started.tv_nsec) ^ (uintptr_t) game_manager;
+    rng_seed(&game_manager->rng, game_manager->seed);
+    game_manager->journal = NULL;
+    metrics_gauge_add(GAUGE_ROOMS + GAME_STATE_LOBBY, 1);
 
-    game_manager->players = NULL;
     game_manager->max_players = max_players;
     game_manager->player_count = 0;
     game_manager->alive_count = 0;
-    game_manager->vote_count = 0;
 
-    game_manager->votes = malloc(sizeof(int) * max_players);
-    if (!game_manager->votes) {
-        log(ERROR, "Failed to allocate memory for votes");
-        free(game_manager);
+    int map_size = socket_map_size(max_players);
+    game_manager->socket_mask = map_size - 1;
+
+    size_t words = sizeof(uint64_t) * BITSET_WORDS(max_players);
+    game_manager->sockets = arena_alloc(arena, sizeof(int) * max_players);
+    game_manager->roles_by_slot = arena_alloc(arena, sizeof(game_role_t) * max_players);
+    game_manager->free_slots = arena_alloc(arena, sizeof(int) * max_players);
+    game_manager->socket_keys = arena_alloc(arena, sizeof(int) * map_size);
+    game_manager->socket_slots = arena_alloc(arena, sizeof(int) * map_size);
+    uint64_t *used = arena_alloc(arena, words);
+    uint64_t *alive = arena_alloc(arena, words);
+    uint64_t *protected = arena_alloc(arena, words);
+    uint64_t *used_ability = arena_alloc(arena, words);
+    if (vote_tally_init(&game_manager->votes, arena, max_players) < 0 ||
+        !game_manager->sockets || !game_manager->roles_by_slot ||
+        !game_manager->free_slots || !game_manager->socket_keys || !game_manager->socket_slots ||
+        !used || !alive || !protected || !used_ability) {
+        log(ERROR, "Failed to allocate memory for player table");
+        game_manager_destroy(game_manager);
         return NULL;
     }
+    bitset_init_fixed(&game_manager->used, used, max_players);
+    bitset_init_fixed(&game_manager->alive, alive, max_players);
+    bitset_init_fixed(&game_manager->protected, protected, max_players);
+    bitset_init_fixed(&game_manager->used_ability, used_ability, max_players);
+
+    for (int slot = 0; slot < max_players; slot++) {
+        game_manager->sockets[slot] = -1;
+        game_manager->roles_by_slot[slot] = ROLE_UNASSIGNED;
+        game_manager->free_slots[slot] = max_players - 1 - slot;
+    }
+    game_manager->free_count = max_players;
+    for (int i = 0; i < map_size; i++) {
+        game_manager->socket_keys[i] = -1;
+    }
 
     memset(game_manager->roles, 0, sizeof(game_manager->roles));
 
@@ -148,27 +526,61 @@ game_manager_create(int max_players)
     game_manager->state.day_count = 0;
     game_manager->state.night_count = 0;
 
-    srand(time(NULL));
-
     return game_manager;
 }
 
 void
-game_manager_destroy(game_manager_t game_manager)
+game_manager_seed(game_manager_t game_manager, uint64_t seed)
+{
+    if (game_manager) {
+        game_manager->seed = seed;
+        rng_seed(&game_manager->rng, seed);
+        journal_event(game_manager, JOURNAL_SEED, 0, 0, 0);
+    }
+}
+
+void
+game_manager_set_journal(game_manager_t game_manager, journal_t journal, int room)
 {
     if (!game_manager) {
         return;
     }
+    game_manager->journal = journal;
+    game_manager->journal_room = room;
+    // A replay starts from a fresh manager, so this must come before any
+    // player joins
+    journal_event(game_manager, JOURNAL_OPEN, 0, game_manager->max_players, 0);
+}
 
-    // Free all players
-    player_t *current = game_manager->players;
-    while (current) {
-        player_t *next = current->next;
-        free(current);
-        current = next;
+void
+game_manager_journal_command(game_manager_t game_manager, int socket_id, journal_command_t command,
+                             int target_player_number, const char *text)
+{
+    if (!game_manager || !game_manager->journal) {
+        return;
     }
-    
-    free(game_manager->votes);
+    journal_record_t record = {
+        .type = JOURNAL_COMMAND,
+        .room = game_manager->journal_room,
+        .socket = socket_id,
+        .value = target_player_number,
+        .result = command,
+        .text = text ? text : "",
+        .text_len = text ? strlen(text) : 0,
+    };
+    journal_append(game_manager->journal, &record);
+}
+
+void
+game_manager_destroy(game_manager_t game_manager)
+{
+    if (!game_manager) {
+        return;
+    }
+
+    journal_event(game_manager, JOURNAL_CLOSE, 0, 0, 0);
+    // The memory goes with the owner's arena
+    metrics_gauge_add(GAUGE_ROOMS + game_manager->state.current_phase, -1);
 }
 
 int
@@ -176,35 +588,30 @@ game_manager_add_player(game_manager_t game_manager, int socket_id)
 {
     VALIDATE_GAME_MANAGER_INT(game_manager);
     VALIDATE_SOCKET_ID(socket_id);
-    if (find_player_by_socket(game_manager, socket_id)) {
+    if (find_slot_by_socket(game_manager, socket_id) >= 0) {
         log(WARN, "Player %d already exists", socket_id);
         return -1;
     }
 
-    if (game_manager->player_count >= game_manager->max_players) {
+    if (game_manager->free_count == 0) {
         log(WARN, "Maximum players reached");
         return -1;
     }
 
-    player_t *player = malloc(sizeof(player_t));
-    if (!player) {
-        log(ERROR, "Failed to allocate memory for player");
-        return -1;
-    }
-
-    player->socket_id = socket_id;
-    player->is_alive = true;
-    player->is_protected = false;
-    player->has_used_ability = false;
-    player->role = ROLE_UNASSIGNED;
-    player->player_number = game_manager->player_count + 1;
-    player->next = game_manager->players;  // Add to front of list
-    game_manager->players = player;
+    int slot = game_manager->free_slots[--game_manager->free_count];
+    game_manager->sockets[slot] = socket_id;
+    game_manager->roles_by_slot[slot] = ROLE_UNASSIGNED;
+    bitset_set(&game_manager->used, slot);
+    bitset_set(&game_manager->alive, slot);
+    bitset_clear(&game_manager->protected, slot);
+    bitset_clear(&game_manager->used_ability, slot);
+    socket_map_insert(game_manager, socket_id, slot);
 
     game_manager->player_count++;
     game_manager->alive_count++;
 
-    return 0;
+    journal_event(game_manager, JOURNAL_JOIN, socket_id, 0, 0);
+    return slot;
 }
 
 int
@@ -212,30 +619,32 @@ game_manager_remove_player(game_manager_t game_manager, int socket_id)
 {
     VALIDATE_GAME_MANAGER_INT(game_manager);
     VALIDATE_SOCKET_ID(socket_id);
-    player_t **pp = &game_manager->players;
-    while (*pp) {
-        if ((*pp)->socket_id == socket_id) {
-            player_t *player = *pp;
-            
-            if (player->is_alive) {
-                game_manager->alive_count--;
-                game_manager->roles[player->role].alive_count--;
-                
-                if (player->is_protected) {
-                    game_manager->roles[player->role].protected_count--;
-                }
-            }
+    int slot = find_slot_by_socket(game_manager, socket_id);
+    if (slot < 0) {
+        log(WARN, "Player %d not found", socket_id);
+        return -1;
+    }
 
-            *pp = player->next;  // Remove from list
-            free(player);
-            game_manager->player_count--;
-            return 0;
-        }
-        pp = &(*pp)->next;
+    // Leaving mid-round takes back the player's vote and any votes against them
+    withdraw_vote(game_manager, slot);
+    withdraw_votes_for(game_manager, slot);
+
+    if (bitset_test(&game_manager->alive, slot)) {
+        kill_player(game_manager, slot);
     }
 
-    log(WARN, "Player %d not found", socket_id);
-    return -1;
+    bitset_clear(&game_manager->used, slot);
+    bitset_clear(&game_manager->alive, slot);
+    bitset_clear(&game_manager->protected, slot);
+    bitset_clear(&game_manager->used_ability, slot);
+    game_manager->sockets[slot] = -1;
+    socket_map_remove(game_manager, socket_id);
+
+    game_manager->free_slots[game_manager->free_count++] = slot;
+
+    game_manager->player_count--;
+    journal_event(game_manager, JOURNAL_LEAVE, socket_id, 0, 0);
+    return 0;
 }
 
 int
@@ -244,6 +653,13 @@ game_manager_get_player_count(game_manager_t game_manager)
     return game_manager->player_count;
 }
 
+int
+game_manager_get_max_players(game_manager_t game_manager)
+{
+    VALIDATE_GAME_MANAGER_INT(game_manager);
+    return game_manager->max_players;
+}
+
 int
 game_manager_get_alive_count(game_manager_t game_manager)
 {
@@ -262,29 +678,30 @@ game_role_t
 game_manager_get_player_role(game_manager_t game_manager, int socket_id)
 {
     VALIDATE_GAME_MANAGER_ROLE(game_manager);
-    VALIDATE_SOCKET_ID(socket_id);
-    player_t *player = find_player_by_socket(game_manager, socket_id);
-    return player ? player->role : ROLE_UNASSIGNED;
+    int slot = find_slot_by_socket(game_manager, socket_id);
+    return slot >= 0 ? game_manager->roles_by_slot[slot] : ROLE_UNASSIGNED;
 }
 
 bool
 game_manager_is_player_alive(game_manager_t game_manager, int socket_id)
 {
-    VALIDATE_GAME_MANAGER_PTR(game_manager);
-    VALIDATE_SOCKET_ID(socket_id);
-    player_t *player = find_player_by_socket(game_manager, socket_id);
-    return player ? player->is_alive : false;
+    int slot = find_slot_by_socket(game_manager, socket_id);
+    return slot >= 0 && bitset_test(&game_manager->alive, slot);
 }
 
 bool
 game_manager_is_player_werewolf(game_manager_t game_manager, int socket_id)
 {
-    VALIDATE_GAME_MANAGER_PTR(game_manager);
-    VALIDATE_SOCKET_ID(socket_id);
-    player_t *player = find_player_by_socket(game_manager, socket_id);
-    return player ? player->role == ROLE_WEREWOLF : false;
+    return game_manager_get_player_role(game_manager, socket_id) == ROLE_WEREWOLF;
 }
 
+static void
+assign_role(game_manager_t game_manager, int slot, game_role_t role)
+{
+    game_manager->roles_by_slot[slot] = role;
+    game_manager->roles[role].total_count++;
+    game_manager->roles[role].alive_count++;
+}
 
 int
 game_manager_start_game(game_manager_t game_manager)
@@ -300,85 +717,67 @@ game_manager_start_game(game_manager_t game_manager)
         return -1;
     }
 
-    // Create array of player indices for role assignment
-    int *player_indices = malloc(sizeof(int) * game_manager->player_count);
-    if (!player_indices) {
+    // Occupied slots for role assignment, as arena scratch
+    size_t mark = arena_mark(game_manager->arena);
+    int *player_slots = arena_alloc(game_manager->arena, sizeof(int) * game_manager->player_count);
+    if (!player_slots) {
         log(ERROR, "Failed to allocate memory for role assignment");
         return -1;
     }
 
-    // Fill array with indices
-    int index = 0;
-    for (player_t *player = game_manager->players; player; player = player->next) {
-        player_indices[index++] = player->socket_id;
+    int count = 0;
+    for (int slot = bitset_next(&game_manager->used, 0); slot >= 0;
+         slot = bitset_next(&game_manager->used, slot + 1)) {
+        player_slots[count++] = slot;
     }
 
-    shuffle_array(player_indices, game_manager->player_count);
+    shuffle_array(&game_manager->rng, player_slots, count);
 
     // Assign roles
-    index = 0;
-    for (int i = 0; i < config->num_werewolves; i++) {
-        player_t *player = find_player_by_socket(game_manager, player_indices[index++]);
-        player->role = ROLE_WEREWOLF;
-        game_manager->roles[ROLE_WEREWOLF].total_count++;
-        game_manager->roles[ROLE_WEREWOLF].alive_count++;
-    }
-
-    for (int i = 0; i < config->num_villagers; i++) {
-        player_t *player = find_player_by_socket(game_manager, player_indices[index++]);
-        player->role = ROLE_VILLAGER;
-        game_manager->roles[ROLE_VILLAGER].total_count++;
-        game_manager->roles[ROLE_VILLAGER].alive_count++;
-    }
-
-    for (int i = 0; i < config->num_special_roles; i++) {
-        if (index < game_manager->player_count) {
-            player_t *player = find_player_by_socket(game_manager, player_indices[index++]);
-            game_role_t role = config->special_roles[i];
-            player->role = role;
-            game_manager->roles[role].total_count++;
-            game_manager->roles[role].alive_count++;
-        }
+    int index = 0;
+    for (int i = 0; i < config->num_werewolves && index < count; i++) {
+        assign_role(game_manager, player_slots[index++], ROLE_WEREWOLF);
+    }
+
+    for (int i = 0; i < config->num_villagers && index < count; i++) {
+        assign_role(game_manager, player_slots[index++], ROLE_VILLAGER);
+    }
+
+    for (int i = 0; i < config->num_special_roles && index < count; i++) {
+        assign_role(game_manager, player_slots[index++], config->special_roles[i]);
     }
 
     // Any remaining players become villagers
-    while (index < game_manager->player_count) {
-        player_t *player = find_player_by_socket(game_manager, player_indices[index++]);
-        player->role = ROLE_VILLAGER;
-        game_manager->roles[ROLE_VILLAGER].total_count++;
-        game_manager->roles[ROLE_VILLAGER].alive_count++;
+    while (index < count) {
+        assign_role(game_manager, player_slots[index++], ROLE_VILLAGER);
     }
 
-    free(player_indices);
+    arena_rewind(game_manager->arena, mark);
 
     game_manager->state.is_game_started = true;
-    game_manager->state.current_phase = GAME_STATE_NIGHT;
+    vote_tally_new_round(&game_manager->votes);
+    set_phase(game_manager, GAME_STATE_NIGHT);
     game_manager->state.is_night = true;
     game_manager->state.night_count++;
     game_manager->state.day_count = 0;
 
+    journal_event(game_manager, JOURNAL_START, 0, 0, 0);
     log(INFO, "Game started with %d players", game_manager->player_count);
     return 0;
 }
 
-int *
-game_manager_get_players_sockets(game_manager_t game_manager)
+int
+game_manager_get_players_sockets(game_manager_t game_manager, int *player_sockets)
 {
-    VALIDATE_GAME_MANAGER_PTR(game_manager);
+    VALIDATE_GAME_MANAGER_INT(game_manager);
 
-    int *player_sockets = malloc(sizeof(int) * game_manager->player_count);
-    if (!player_sockets) {
-        log(ERROR, "Failed to allocate memory for player sockets");
-        return NULL;
-    }
-    
     int index = 0;
-    
-    for (player_t *player = game_manager->players; player; player = player->next) {
-        player_sockets[index++] = player->socket_id;
+    for (int slot = bitset_next(&game_manager->used, 0); slot >= 0;
+         slot = bitset_next(&game_manager->used, slot + 1)) {
+        player_sockets[index++] = game_manager->sockets[slot];
     }
     
-    return player_sockets;
+    return index;
 }
 
 game_state_t
@@ -391,10 +790,8 @@ game_manager_get_phase(game_manager_t game_manager)
 bool
 game_manager_is_player_protected(game_manager_t game_manager, int socket_id)
 {
-    VALIDATE_GAME_MANAGER_PTR(game_manager);
-    VALIDATE_SOCKET_ID(socket_id);
-    player_t *player = find_player_by_socket(game_manager, socket_id);
-    return player ? player->is_protected : false;
+    int slot = find_slot_by_socket(game_manager, socket_id);
+    return slot >= 0 && bitset_test(&game_manager->protected, slot);
 }
 
 int
@@ -402,22 +799,42 @@ game_manager_get_player_number(game_manager_t game_manager, int socket_id)
 {
     VALIDATE_GAME_MANAGER_INT(game_manager);
     VALIDATE_SOCKET_ID(socket_id);
-    player_t *player = find_player_by_socket(game_manager, socket_id);
-    return player ? player->player_number : -1;
+    int slot = find_slot_by_socket(game_manager, socket_id);
+    return slot >= 0 ? slot + 1 : -1;
+}
+
+int
+game_manager_get_player_seat(game_manager_t game_manager, int socket_id)
+{
+    VALIDATE_GAME_MANAGER_INT(game_manager);
+    VALIDATE_SOCKET_ID(socket_id);
+    return find_slot_by_socket(game_manager, socket_id);
+}
+
+const int *
+game_manager_get_seat_sockets(game_manager_t game_manager)
+{
+    VALIDATE_GAME_MANAGER_PTR(game_manager);
+    return game_manager->sockets;
+}
+
+const bitset_t *
+game_manager_get_alive_seats(game_manager_t game_manager)
+{
+    VALIDATE_GAME_MANAGER_PTR(game_manager);
+    return &game_manager->alive;
 }
 
 int
 game_manager_get_socket_by_player_number(game_manager_t game_manager, int player_number)
 {
     VALIDATE_GAME_MANAGER_INT(game_manager);
-    player_t *player = game_manager->players;
-    while (player) {
-        if (player->player_number == player_number) {
-            return player->socket_id;
-        }
-        player = player->next;
+    // Player numbers are slot + 1
+    int slot = player_number - 1;
+    if (slot < 0 || slot >= game_manager->max_players) {
+        return -1;
     }
-    return -1;
+    return game_manager->sockets[slot];
 }
 
 int
@@ -426,3 +843,173 @@ game_manager_cmp_phase(game_manager_t game_manager, game_state_t phase)
     VALIDATE_GAME_MANAGER_INT(game_manager);
     return game_manager->state.current_phase == phase;
 }
+
+static game_vote_result_t
+cast_vote(game_manager_t game_manager, int socket_id, int target_player_number)
+{
+    if (!game_manager) {
+        log(ERROR, "Invalid game manager");
+        return VOTE_NOT_NOW;
+    }
+
+    game_state_t phase = game_manager->state.current_phase;
+    if (phase != GAME_STATE_NIGHT && phase != GAME_STATE_VOTING) {
+        return VOTE_NOT_NOW;
+    }
+
+    int voter = find_slot_by_socket(game_manager, socket_id);
+    if (voter < 0 || !can_vote(game_manager, voter)) {
+        return VOTE_NOT_ALLOWED;
+    }
+
+    // Werewolves cannot pick one of their own at night
+    int target = target_player_number - 1;
+    if (target < 0 || target >= game_manager->max_players || target == voter ||
+        !bitset_test(&game_manager->alive, target) ||
+        (phase == GAME_STATE_NIGHT && game_manager->roles_by_slot[target] == ROLE_WEREWOLF)) {
+        return VOTE_BAD_TARGET;
+    }
+
+    vote_tally_t *tally = &game_manager->votes;
+    withdraw_vote(game_manager, voter);
+    tally->cast[voter] = target;
+    tally->cast_round[voter] = tally->round;
+    tally->voters++;
+    int first = votes_received(tally, target) > 0 ? tally->voter_head[target] : -1;
+    tally->voter_prev[voter] = -1;
+    tally->voter_next[voter] = first;
+    if (first >= 0) {
+        tally->voter_prev[first] = voter;
+    }
+    tally->voter_head[target] = voter;
+    set_votes_received(tally, target, votes_received(tally, target) + 1);
+    return VOTE_ACCEPTED;
+}
+
+game_vote_result_t
+game_manager_cast_vote(game_manager_t game_manager, int socket_id, int target_player_number)
+{
+    game_vote_result_t result = cast_vote(game_manager, socket_id, target_player_number);
+    if (game_manager) {
+        journal_event(game_manager, JOURNAL_VOTE, socket_id, target_player_number, result);
+    }
+    return result;
+}
+
+int
+game_manager_get_votes_for(game_manager_t game_manager, int player_number)
+{
+    VALIDATE_GAME_MANAGER_INT(game_manager);
+    int slot = player_number - 1;
+    if (slot < 0 || slot >= game_manager->max_players) {
+        return -1;
+    }
+    return votes_received(&game_manager->votes, slot);
+}
+
+bool
+game_manager_votes_complete(game_manager_t game_manager)
+{
+    if (!game_manager) {
+        return false;
+    }
+
+    int voters = 0;
+    switch (game_manager->state.current_phase) {
+        case GAME_STATE_NIGHT:
+            voters = game_manager->roles[ROLE_WEREWOLF].alive_count;
+            break;
+        case GAME_STATE_VOTING:
+            voters = game_manager->alive_count;
+            break;
+        default:
+            return false;
+    }
+    return game_manager->votes.voters >= voters;
+}
+
+game_team_t
+game_manager_get_winner(game_manager_t game_manager)
+{
+    if (!game_manager || !game_manager->state.is_game_started) {
+        return TEAM_NONE;
+    }
+
+    int werewolves = game_manager->roles[ROLE_WEREWOLF].alive_count;
+    if (werewolves == 0) {
+        return TEAM_VILLAGE;
+    }
+    if (werewolves >= game_manager->alive_count - werewolves) {
+        return TEAM_WEREWOLVES;
+    }
+    return TEAM_NONE;
+}
+
+int
+game_manager_advance_phase(game_manager_t game_manager, game_phase_result_t *result)
+{
+    VALIDATE_GAME_MANAGER_INT(game_manager);
+
+    game_state_t phase = game_manager->state.current_phase;
+    result->closed_phase = phase;
+    result->eliminated_socket = -1;
+    result->eliminated_number = 0;
+    result->eliminated_role = ROLE_UNASSIGNED;
+
+    int victim = -1;
+    game_state_t next;
+    switch (phase) {
+        case GAME_STATE_NIGHT:
+            victim = vote_tally_leader(&game_manager->votes);
+            if (victim >= 0 && bitset_test(&game_manager->protected, victim)) {
+                victim = -1;
+            }
+            next = GAME_STATE_DAY;
+            break;
+        case GAME_STATE_DAY:
+            next = GAME_STATE_VOTING;
+            break;
+        case GAME_STATE_VOTING:
+            victim = vote_tally_leader(&game_manager->votes);
+            next = GAME_STATE_NIGHT;
+            break;
+        default:
+            log(WARN, "No phase to advance from %d", phase);
+            return RET_ERROR;
+    }
+
+    if (victim >= 0) {
+        result->eliminated_socket = game_manager->sockets[victim];
+        result->eliminated_number = victim + 1;
+        result->eliminated_role = game_manager->roles_by_slot[victim];
+        kill_player(game_manager, victim);
+    }
+
+    result->winner = game_manager_get_winner(game_manager);
+    if (result->winner != TEAM_NONE) {
+        next = GAME_STATE_ENDED;
+    }
+
+    vote_tally_new_round(&game_manager->votes);
+    set_phase(game_manager, next);
+    game_manager->state.is_night = next == GAME_STATE_NIGHT;
+    if (next == GAME_STATE_NIGHT) {
+        game_manager->state.night_count++;
+    } else if (next == GAME_STATE_DAY) {
+        game_manager->state.day_count++;
+    }
+    result->phase = next;
+    journal_event(game_manager, JOURNAL_ADVANCE, 0, next, result->eliminated_number);
+    return RET_SUCCESS;
+}
+
+int
+game_manager_end_game(game_manager_t game_manager)
+{
+    VALIDATE_GAME_MANAGER_INT(game_manager);
+    vote_tally_new_round(&game_manager->votes);
+    set_phase(game_manager, GAME_STATE_ENDED);
+    game_manager->state.is_night = false;
+    journal_event(game_manager, JOURNAL_END, 0, 0, 0);
+    return RET_SUCCESS;
+}
@@ -0,0 +1,702 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "logger.h"
+#include "defs.h"
+#include "event_loop.h"
+#include "tcp_server_util.h"
+#include "output_queue.h"
+#include "io_backend.h"
+#include "metrics.h"
+
+#define INITIAL_CONN_CAPACITY 1024
+
+// Idle tracking of one watched connection. Frames only store the time; the
+// timer is re-armed lazily when it fires, so traffic never touches the wheel.
+// The time is read from the clock: the wheel's is from before the poll slept.
+typedef struct idle_conn_t {
+    struct io_backend_cdt *backend;
+    int fd;
+    bool watched;
+    bool probed;            // Heartbeat sent, waiting for any frame back
+    uint64_t last_frame_ms;
+    wheel_timer_t timer;
+} idle_conn_t;
+
+typedef struct io_backend_cdt {
+    const io_backend_ops_t *ops;
+    void *impl;
+    io_stats_t stats;
+    io_handlers_t handlers;     // The server's; the impl calls the ones below
+    void *ctx;
+    timer_wheel_t timers;
+    uint64_t idle_timeout_ms;   // 0: no heartbeats
+    idle_conn_t **idle;         // fd -> idle state, kept for reuse once allocated
+    int idle_capacity;
+} io_backend_cdt;
+
+static void
+idle_expired(void *arg)
+{
+    idle_conn_t *conn = arg;
+    io_backend_cdt *backend = conn->backend;
+    uint64_t quiet = timer_wheel_now_ms(backend->timers) - conn->last_frame_ms;
+
+    if (quiet < backend->idle_timeout_ms) {
+        // Heard from since the timer was armed
+        timer_wheel_schedule(backend->timers, &conn->timer, backend->idle_timeout_ms - quiet);
+        return;
+    }
+    if (!conn->probed) {
+        // An empty frame: clients answer with one, and a peer that is gone
+        // turns the write into an error the backend sees as a hangup
+        conn->probed = true;
+        io_backend_send(backend, conn->fd, "", 0);
+        timer_wheel_schedule(backend->timers, &conn->timer, backend->idle_timeout_ms);
+        return;
+    }
+
+    log(WARN, "Client %d silent for %lu s, disconnecting", conn->fd,
+        (unsigned long) (quiet / 1000));
+    backend->stats.idle_closes++;
+    backend->handlers.on_close(backend->ctx, conn->fd);
+    io_backend_close(backend, conn->fd);
+}
+
+static idle_conn_t *
+find_idle(io_backend_cdt *backend, int fd)
+{
+    return fd >= 0 && fd < backend->idle_capacity ? backend->idle[fd] : NULL;
+}
+
+static void
+idle_forget(io_backend_cdt *backend, int fd)
+{
+    idle_conn_t *conn = find_idle(backend, fd);
+    if (conn && conn->watched) {
+        conn->watched = false;
+        timer_wheel_cancel(backend->timers, &conn->timer);
+    }
+}
+
+static int
+idle_watch(io_backend_cdt *backend, int fd)
+{
+    if (fd >= backend->idle_capacity) {
+        int capacity = backend->idle_capacity ? backend->idle_capacity : INITIAL_CONN_CAPACITY;
+        while (capacity <= fd) {
+            capacity *= 2;
+        }
+        idle_conn_t **idle = realloc(backend->idle, sizeof(idle_conn_t *) * capacity);
+        if (!idle) {
+            log(ERROR, "Failed to grow idle connection table");
+            return RET_ERROR;
+        }
+        memset(idle + backend->idle_capacity, 0,
+               sizeof(idle_conn_t *) * (capacity - backend->idle_capacity));
+        backend->idle = idle;
+        backend->idle_capacity = capacity;
+    }
+
+    idle_conn_t *conn = backend->idle[fd];
+    if (!conn) {
+        conn = malloc(sizeof(idle_conn_t));
+        if (!conn) {
+            log(ERROR, "Failed to allocate memory for idle connection");
+            return RET_ERROR;
+        }
+        conn->backend = backend;
+        conn->fd = fd;
+        timer_init(&conn->timer, idle_expired, conn);
+        backend->idle[fd] = conn;
+    }
+    conn->watched = true;
+    conn->probed = false;
+    conn->last_frame_ms = timer_now_ms();
+    timer_wheel_schedule(backend->timers, &conn->timer, backend->idle_timeout_ms);
+    return RET_SUCCESS;
+}
+
+static void
+idle_on_accept(void *ctx, int fd)
+{
+    io_backend_cdt *backend = ctx;
+    backend->handlers.on_accept(backend->ctx, fd);
+}
+
+static void
+idle_on_frame(void *ctx, int fd, const char *payload, size_t len)
+{
+    io_backend_cdt *backend = ctx;
+    idle_conn_t *conn = find_idle(backend, fd);
+    if (conn) {
+        conn->last_frame_ms = timer_now_ms();
+        conn->probed = false;
+    }
+    backend->handlers.on_frame(backend->ctx, fd, payload, len);
+}
+
+static void
+idle_on_close(void *ctx, int fd)
+{
+    io_backend_cdt *backend = ctx;
+    idle_forget(backend, fd);
+    backend->handlers.on_close(backend->ctx, fd);
+}
+
+// Sits between the impl and the server when heartbeats are on
+static const io_handlers_t idle_handlers = {
+    .on_accept = idle_on_accept,
+    .on_frame = idle_on_frame,
+    .on_close = idle_on_close,
+};
+
+io_backend_t
+io_backend_create(int listen_fd, const io_handlers_t *handlers, void *ctx,
+                  timer_wheel_t timers, int idle_timeout_sec)
+{
+    io_backend_cdt *backend = calloc(1, sizeof(io_backend_cdt));
+    if (!backend) {
+        log(ERROR, "Failed to allocate memory for io backend");
+        return NULL;
+    }
+
+    backend->handlers = *handlers;
+    backend->ctx = ctx;
+    backend->timers = timers;
+    backend->idle_timeout_ms = idle_timeout_sec > 0 ? (uint64_t) idle_timeout_sec * 1000 : 0;
+    if (backend->idle_timeout_ms) {
+        handlers = &idle_handlers;
+        ctx = backend;
+    }
+
+#ifdef WEREWOLF_USE_IO_URING
+    backend->ops = &io_uring_backend_ops;
+    backend->impl = backend->ops->create(listen_fd, handlers, ctx, &backend->stats);
+    if (backend->impl) {
+        return backend;
+    }
+    log(WARN, "io_uring unavailable, falling back to %s", event_loop_backend());
+#endif
+
+    backend->ops = &readiness_backend_ops;
+    backend->impl = backend->ops->create(listen_fd, handlers, ctx, &backend->stats);
+    if (!backend->impl) {
+        free(backend);
+        return NULL;
+    }
+    return backend;
+}
+
+void
+io_backend_destroy(io_backend_t backend)
+{
+    if (!backend) {
+        return;
+    }
+    backend->ops->destroy(backend->impl);
+    for (int fd = 0; fd < backend->idle_capacity; fd++) {
+        if (backend->idle[fd]) {
+            timer_wheel_cancel(backend->timers, &backend->idle[fd]->timer);
+            free(backend->idle[fd]);
+        }
+    }
+    free(backend->idle);
+    free(backend);
+}
+
+int
+io_backend_watch(io_backend_t backend, int fd)
+{
+    if (backend->ops->watch(backend->impl, fd) < 0) {
+        return RET_ERROR;
+    }
+    // The caller closes the fd on failure, which also drops the watch
+    if (backend->idle_timeout_ms && idle_watch(backend, fd) < 0) {
+        return RET_ERROR;
+    }
+    return RET_SUCCESS;
+}
+
+void
+io_backend_close(io_backend_t backend, int fd)
+{
+    idle_forget(backend, fd);
+    backend->ops->close(backend->impl, fd);
+}
+
+int
+io_backend_send(io_backend_t backend, int fd, const void *payload, size_t len)
+{
+    return io_backend_broadcast(backend, &fd, 1, payload, len) == 1 ? (int) len : RET_ERROR;
+}
+
+int
+io_backend_broadcast(io_backend_t backend, const int *fds, int count, const void *payload, size_t len)
+{
+    if (len > FRAME_MAX_PAYLOAD) {
+        log(ERROR, "Frame of %zu bytes exceeds the %d byte limit", len, FRAME_MAX_PAYLOAD);
+        return RET_ERROR;
+    }
+
+    shared_frame_t *frame = shared_frame_create(payload, len);
+    if (!frame) {
+        return RET_ERROR;
+    }
+
+    int delivered = 0;
+    for (int i = 0; i < count; i++) {
+        backend->stats.sends++;
+        if (backend->ops->send(backend->impl, fds[i], frame) >= 0) {
+            delivered++;
+        }
+    }
+    shared_frame_unref(frame);
+    return delivered;
+}
+
+int
+io_backend_poll(io_backend_t backend, int timeout_ms)
+{
+    return backend->ops->poll(backend->impl, timeout_ms);
+}
+
+const char *
+io_backend_name(io_backend_t backend)
+{
+    return backend->ops == &readiness_backend_ops ? event_loop_backend() : backend->ops->name;
+}
+
+const io_stats_t *
+io_backend_get_stats(io_backend_t backend)
+{
+    return &backend->stats;
+}
+
+void
+io_backend_note_accepts(int listen_fd, int accepted, int *queue_depth)
+{
+    metrics_observe(HISTOGRAM_ACCEPT_BATCH, accepted);
+    int depth = accept_queue_depth(listen_fd);
+    if (depth >= 0) {
+        metrics_gauge_add(GAUGE_ACCEPT_QUEUE, depth - *queue_depth);
+        *queue_depth = depth;
+    }
+}
+
+int
+io_backend_dispatch_frames(frame_ring_t ring, const io_handlers_t *handlers, void *ctx,
+                           int fd, io_stats_t *stats, const bool *closed)
+{
+    const char *payload;
+    size_t len;
+    int rv = 0;
+
+    // Everything in the ring was just read; replies are timed from here
+    metrics_ingress_begin();
+    while (!*closed && (rv = frame_ring_next(ring, &payload, &len)) > 0) {
+        stats->frames++;
+        metrics_ingress_message();
+        handlers->on_frame(ctx, fd, payload, len);
+    }
+    metrics_ingress_end();
+    if (rv < 0 && !*closed) {
+        log(WARN, "Client %d sent a frame over %d bytes, disconnecting", fd, FRAME_MAX_PAYLOAD);
+        return RET_ERROR;
+    }
+    return RET_SUCCESS;
+}
+
+/* Readiness backend: epoll (or select) plus non-blocking readv/sendmsg */
+
+typedef struct readiness_conn_t {
+    int fd;
+    frame_ring_t ring;
+    output_queue_t out;
+    bool closed;
+    bool dirty;             // On the flush list
+    bool want_write;        // EVENT_WRITE registered, waiting for room in the socket
+    bool overflow;          // Output queue hit its limit; dropped at the next flush
+    struct readiness_conn_t *next_dirty;
+} readiness_conn_t;
+
+typedef struct {
+    int listen_fd;
+    io_handlers_t handlers;
+    void *ctx;
+    io_stats_t *stats;
+    event_loop_t loop;
+    readiness_conn_t **conns;   // fd -> watched connection
+    int conn_capacity;
+    readiness_conn_t *dirty;    // Connections with output queued since the last flush
+    readiness_conn_t *current;  // Connection whose frames are being dispatched
+    bool accept_pending;        // The last batch was full; more may be queued
+    int accept_queue;           // Last sampled listen queue depth
+} readiness_backend_t;
+
+static void readiness_close(void *impl, int fd);
+
+static readiness_conn_t *
+find_conn(readiness_backend_t *backend, int fd)
+{
+    return fd >= 0 && fd < backend->conn_capacity ? backend->conns[fd] : NULL;
+}
+
+static void
+free_conn(readiness_conn_t *conn)
+{
+    frame_ring_destroy(conn->ring);
+    output_queue_clear(&conn->out);
+    free(conn);
+}
+
+static void *
+readiness_create(int listen_fd, const io_handlers_t *handlers, void *ctx, io_stats_t *stats)
+{
+    readiness_backend_t *backend = calloc(1, sizeof(readiness_backend_t));
+    if (!backend) {
+        log(ERROR, "Failed to allocate memory for readiness backend");
+        return NULL;
+    }
+
+    backend->loop = event_loop_create();
+    backend->conns = calloc(INITIAL_CONN_CAPACITY, sizeof(readiness_conn_t *));
+    if (!backend->loop || !backend->conns || event_loop_add(backend->loop, listen_fd, EVENT_READ) < 0) {
+        event_loop_destroy(backend->loop);
+        free(backend->conns);
+        free(backend);
+        return NULL;
+    }
+    backend->conn_capacity = INITIAL_CONN_CAPACITY;
+    backend->listen_fd = listen_fd;
+    backend->handlers = *handlers;
+    backend->ctx = ctx;
+    backend->stats = stats;
+    return backend;
+}
+
+static void
+readiness_destroy(void *impl)
+{
+    readiness_backend_t *backend = impl;
+    for (int fd = 0; fd < backend->conn_capacity; fd++) {
+        if (backend->conns[fd]) {
+            close(fd);
+            free_conn(backend->conns[fd]);
+        }
+    }
+    // Closed connections still waiting for the flush list
+    while (backend->dirty) {
+        readiness_conn_t *next = backend->dirty->next_dirty;
+        if (backend->dirty->closed) {
+            free_conn(backend->dirty);
+        }
+        backend->dirty = next;
+    }
+    free(backend->conns);
+    event_loop_destroy(backend->loop);
+    free(backend);
+}
+
+static int
+readiness_watch(void *impl, int fd)
+{
+    readiness_backend_t *backend = impl;
+    if (fd < 0) {
+        return RET_ERROR;
+    }
+
+    if (fd >= backend->conn_capacity) {
+        int capacity = backend->conn_capacity;
+        while (capacity <= fd) {
+            capacity *= 2;
+        }
+        readiness_conn_t **conns = realloc(backend->conns, sizeof(readiness_conn_t *) * capacity);
+        if (!conns) {
+            log(ERROR, "Failed to grow connection table");
+            return RET_ERROR;
+        }
+        memset(conns + backend->conn_capacity, 0,
+               sizeof(readiness_conn_t *) * (capacity - backend->conn_capacity));
+        backend->conns = conns;
+        backend->conn_capacity = capacity;
+    }
+
+    readiness_conn_t *conn = calloc(1, sizeof(readiness_conn_t));
+    if (!conn) {
+        log(ERROR, "Failed to allocate memory for connection");
+        return RET_ERROR;
+    }
+    conn->ring = frame_ring_create();
+    if (!conn->ring) {
+        free(conn);
+        return RET_ERROR;
+    }
+    conn->fd = fd;
+
+    backend->stats->syscalls++;
+    if (event_loop_add(backend->loop, fd, EVENT_READ) < 0) {
+        free_conn(conn);
+        return RET_ERROR;
+    }
+    backend->conns[fd] = conn;
+    return RET_SUCCESS;
+}
+
+static void
+readiness_close(void *impl, int fd)
+{
+    readiness_backend_t *backend = impl;
+    readiness_conn_t *conn = find_conn(backend, fd);
+    if (conn) {
+        backend->conns[fd] = NULL;
+        conn->closed = true;
+        // Still referenced by the read loop or the flush list, which free it
+        if (conn != backend->current && !conn->dirty) {
+            free_conn(conn);
+        }
+    }
+    event_loop_remove(backend->loop, fd);
+    backend->stats->syscalls += 2;
+    close(fd);
+}
+
+static void
+mark_dirty(readiness_backend_t *backend, readiness_conn_t *conn)
+{
+    if (!conn->dirty) {
+        conn->dirty = true;
+        conn->next_dirty = backend->dirty;
+        backend->dirty = conn;
+    }
+}
+
+// Writes as much queued output as the socket takes. EVENT_WRITE is
+// registered only while output is left over, so idle sockets cost nothing.
+static void
+flush_conn(readiness_backend_t *backend, readiness_conn_t *conn)
+{
+    struct iovec iov[OUTPUT_QUEUE_IOV_MAX];
+
+    while (!output_queue_empty(&conn->out)) {
+        struct msghdr msg = {0};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = output_queue_iov(&conn->out, iov, OUTPUT_QUEUE_IOV_MAX);
+
+        backend->stats->syscalls++;
+        ssize_t rv = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (rv > 0) {
+            backend->stats->bytes_sent += rv;
+            metrics_add(COUNTER_BYTES_SENT, rv);
+            output_queue_consume(&conn->out, rv);
+            continue;
+        }
+        if (rv < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            metrics_inc(COUNTER_SEND_EAGAIN);
+            if (!conn->want_write) {
+                conn->want_write = true;
+                backend->stats->syscalls++;
+                event_loop_modify(backend->loop, conn->fd, EVENT_READ | EVENT_WRITE);
+            }
+            return;
+        }
+        // The read side reports the hangup; nothing queued can be delivered
+        log(ERROR, "Failed to send to socket %d: %s", conn->fd, strerror(errno));
+        metrics_inc(COUNTER_SEND_ERRORS);
+        output_queue_clear(&conn->out);
+    }
+
+    if (conn->want_write) {
+        conn->want_write = false;
+        backend->stats->syscalls++;
+        event_loop_modify(backend->loop, conn->fd, EVENT_READ);
+    }
+}
+
+static int
+readiness_send(void *impl, int fd, shared_frame_t *frame)
+{
+    readiness_backend_t *backend = impl;
+    readiness_conn_t *conn = find_conn(backend, fd);
+    if (!conn) {
+        // Not watched (e.g. a connection being rejected): best-effort send
+        backend->stats->syscalls++;
+        ssize_t rv = send(fd, frame->data, frame->len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (rv > 0) {
+            backend->stats->bytes_sent += rv;
+            metrics_add(COUNTER_BYTES_SENT, rv);
+        } else {
+            metrics_inc(COUNTER_SEND_ERRORS);
+        }
+        return rv < 0 ? RET_ERROR : RET_SUCCESS;
+    }
+    if (conn->overflow) {
+        return RET_ERROR;
+    }
+
+    if (output_queue_push(&conn->out, frame) < 0) {
+        // A burst of replies within one iteration: hand what we have to the
+        // kernel before deciding the client is not reading
+        if (!conn->want_write) {
+            flush_conn(backend, conn);
+        }
+        if (output_queue_push(&conn->out, frame) < 0) {
+            conn->overflow = true;
+            mark_dirty(backend, conn);
+            return RET_ERROR;
+        }
+    }
+    mark_dirty(backend, conn);
+    return RET_SUCCESS;
+}
+
+static void
+flush_dirty(readiness_backend_t *backend)
+{
+    // Handlers run from here (on_close) may queue more output, so pop one
+    // connection at a time until the list stays empty
+    while (backend->dirty) {
+        readiness_conn_t *conn = backend->dirty;
+        backend->dirty = conn->next_dirty;
+        conn->dirty = false;
+
+        if (conn->closed) {
+            free_conn(conn);
+        } else if (conn->overflow) {
+            log(WARN, "Client %d is not reading (%d bytes queued), disconnecting",
+                conn->fd, OUTPUT_QUEUE_LIMIT);
+            backend->stats->overflows++;
+            backend->handlers.on_close(backend->ctx, conn->fd);
+            readiness_close(backend, conn->fd);
+        } else if (!conn->want_write) {
+            flush_conn(backend, conn);
+        }
+    }
+}
+
+// At most IO_ACCEPT_BATCH per call. Edge-triggered epoll will not report the
+// listener again for connections already queued, so a full batch leaves
+// accept_pending set and the next poll comes straight back for the rest.
+static void
+readiness_accept(readiness_backend_t *backend)
+{
+    int client_sockets[IO_ACCEPT_BATCH];
+    int accepted = accept_tcp_connections(backend->listen_fd, client_sockets, IO_ACCEPT_BATCH);
+    backend->accept_pending = accepted == IO_ACCEPT_BATCH;
+    // One accept4() each, plus the one that found the queue empty
+    backend->stats->syscalls += accepted + !backend->accept_pending;
+
+    for (int i = 0; i < accepted; i++) {
+        backend->stats->accepts++;
+        metrics_ingress_begin();
+        metrics_ingress_message();
+        backend->handlers.on_accept(backend->ctx, client_sockets[i]);
+        metrics_ingress_end();
+    }
+    if (accepted > 0) {
+        backend->stats->syscalls++;
+        io_backend_note_accepts(backend->listen_fd, accepted, &backend->accept_queue);
+    }
+}
+
+// Edge-triggered: keep reading until the socket reports EAGAIN. Bytes are
+// read straight into the connection's ring and framed in place.
+static void
+readiness_read(readiness_backend_t *backend, readiness_conn_t *conn)
+{
+    int fd = conn->fd;
+
+    backend->current = conn;
+    // A client that stopped reading its output gets no more input handled
+    while (!conn->closed && !conn->overflow) {
+        // Never full here: whatever is left after dispatching is a partial
+        // frame, and a whole frame is smaller than the ring
+        struct iovec iov[2];
+        int count = frame_ring_reserve(conn->ring, iov);
+
+        backend->stats->syscalls++;
+        ssize_t valread = readv(fd, iov, count);
+        if (valread > 0) {
+            backend->stats->recvs++;
+            frame_ring_commit(conn->ring, valread);
+            if (io_backend_dispatch_frames(conn->ring, &backend->handlers, backend->ctx, fd,
+                                           backend->stats, &conn->closed) == RET_SUCCESS) {
+                continue;
+            }
+        } else if (valread < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            log(ERROR, "Read failed from client %d: %s", fd, strerror(errno));
+        }
+        backend->handlers.on_close(backend->ctx, fd);
+        readiness_close(backend, fd);
+    }
+
+    backend->current = NULL;
+    if (conn->closed && !conn->dirty) {
+        free_conn(conn);
+    }
+}
+
+static int
+readiness_poll(void *impl, int timeout_ms)
+{
+    readiness_backend_t *backend = impl;
+    event_t events[EVENT_LOOP_MAX_EVENTS];
+
+    // Phase-deadline timers and heartbeats queue output between polls; send it
+    // before waiting
+    flush_dirty(backend);
+
+    backend->stats->syscalls++;
+    int ready = event_loop_wait(backend->loop, events, EVENT_LOOP_MAX_EVENTS,
+                                backend->accept_pending ? 0 : timeout_ms);
+    bool accept_ready = backend->accept_pending;
+    for (int i = 0; i < ready; i++) {
+        if (events[i].fd == backend->listen_fd) {
+            accept_ready = true;
+            continue;
+        }
+
+        readiness_conn_t *conn = find_conn(backend, events[i].fd);
+        if (!conn) {
+            continue;
+        }
+        if (events[i].events & EVENT_WRITE) {
+            flush_conn(backend, conn);
+        }
+        if (events[i].events & (EVENT_READ | EVENT_HUP | EVENT_ERROR)) {
+            readiness_read(backend, conn);
+        }
+    }
+    // New players only after the rooms already playing were served
+    if (accept_ready) {
+        readiness_accept(backend);
+    }
+
+    // Everything the handlers queued goes out in one sendmsg per connection
+    flush_dirty(backend);
+    metrics_latency_flush();
+    return ready;
+}
+
+const io_backend_ops_t readiness_backend_ops = {
+    .name = "readiness",
+    .create = readiness_create,
+    .destroy = readiness_destroy,
+    .watch = readiness_watch,
+    .close = readiness_close,
+    .send = readiness_send,
+    .poll = readiness_poll,
+};
@@ -0,0 +1,749 @@
+#ifdef WEREWOLF_USE_IO_URING
+
+#define _GNU_SOURCE  // MAP_POPULATE
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "logger.h"
+#include "defs.h"
+#include "output_queue.h"
+#include "io_backend.h"
+#include "metrics.h"
+
+/*
+ * io_uring backend built on raw syscalls (no liburing).
+ *  - one multishot accept on the listener
+ *  - one multishot recv per connection, filling buffers from a provided
+ *    buffer ring; each completion is appended to the connection's frame
+ *    ring and the buffer is recycled right away
+ *  - sends are queued per connection and submitted as one SENDMSG per
+ *    connection per loop iteration, with at most one in flight so frames
+ *    stay ordered
+ * Everything queued during an iteration is submitted by the single
+ * io_uring_enter() that also waits for the next completions.
+ *
+ * The multishot accept takes connections off the listen queue as they
+ * arrive, so the IO_ACCEPT_BATCH cap applies to handing them to the server
+ * instead: accepted sockets wait in pending_fds and at most a batch of them
+ * is announced per iteration, after the completions of the iteration.
+ */
+
+#define URING_ENTRIES 1024
+#define URING_RECV_BUFFERS 1024             // Power of two
+#define URING_RECV_BUFFER_SIZE BUFFER_SIZE
+#define URING_BUFFER_GROUP 0
+#define INITIAL_CONN_CAPACITY 1024
+
+// Operation tag kept in the low bits of user_data; the rest is a uring_conn_t *
+#define OP_ACCEPT 1
+#define OP_RECV 2
+#define OP_SEND 3
+#define OP_IGNORE 4
+#define OP_MASK 7ULL
+
+typedef struct uring_conn_t {
+    int fd;
+    bool closed;
+    bool recv_armed;
+    bool send_inflight;
+    bool dirty;
+    bool overflow;          // Output queue hit its limit; dropped at the next flush
+    frame_ring_t ring;
+    output_queue_t out;
+    struct iovec iov[OUTPUT_QUEUE_IOV_MAX];     // Owned by the in-flight SENDMSG
+    struct msghdr msg;
+    struct uring_conn_t *next_dirty;
+} uring_conn_t;
+
+typedef struct {
+    int ring_fd;
+    int listen_fd;
+    io_handlers_t handlers;
+    void *ctx;
+    io_stats_t *stats;
+
+    void *ring_ptr;
+    size_t ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    char *buf_base;
+    unsigned short buf_tail;
+
+    uring_conn_t **conns;   // fd -> live connection
+    int conn_capacity;
+    uring_conn_t *dirty;    // Connections with queued, unsubmitted sends
+    int *pending_fds;       // Accepted, not yet handed to on_accept; FIFO
+    int pending_head;
+    int pending_count;
+    int pending_capacity;
+    int accept_queue;       // Last sampled listen queue depth
+} uring_backend_t;
+
+static inline uint64_t
+pack_user_data(void *ptr, uint64_t op)
+{
+    return (uint64_t) (uintptr_t) ptr | op;
+}
+
+static int
+uring_enter(uring_backend_t *backend, unsigned min_complete, int timeout_ms)
+{
+    unsigned to_submit = backend->sq_local_tail - __atomic_load_n(backend->sq_head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(backend->sq_tail, backend->sq_local_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = 0;
+    struct io_uring_getevents_arg arg = {0};
+    struct __kernel_timespec ts;
+    void *argp = NULL;
+    size_t argsz = 0;
+
+    if (min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout_ms >= 0) {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+            arg.ts = (uint64_t) (uintptr_t) &ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+    }
+
+    backend->stats->syscalls++;
+    int ret = syscall(__NR_io_uring_enter, backend->ring_fd, to_submit, min_complete, flags, argp, argsz);
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+        log(ERROR, "io_uring_enter() failed: %s", strerror(errno));
+    }
+    return ret;
+}
+
+static struct io_uring_sqe *
+get_sqe(uring_backend_t *backend)
+{
+    unsigned head = __atomic_load_n(backend->sq_head, __ATOMIC_ACQUIRE);
+    if (backend->sq_local_tail - head >= backend->sq_entries) {
+        // Ring full: submit what we have without waiting
+        uring_enter(backend, 0, 0);
+        head = __atomic_load_n(backend->sq_head, __ATOMIC_ACQUIRE);
+        if (backend->sq_local_tail - head >= backend->sq_entries) {
+            return NULL;
+        }
+    }
+
+    unsigned index = backend->sq_local_tail & backend->sq_mask;
+    struct io_uring_sqe *sqe = &backend->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    backend->sq_array[index] = index;
+    backend->sq_local_tail++;
+    return sqe;
+}
+
+static void
+recycle_buffer(uring_backend_t *backend, unsigned short bid)
+{
+    struct io_uring_buf *buf = &backend->buf_ring->bufs[backend->buf_tail & (URING_RECV_BUFFERS - 1)];
+    buf->addr = (uint64_t) (uintptr_t) (backend->buf_base + (size_t) bid * URING_RECV_BUFFER_SIZE);
+    buf->len = URING_RECV_BUFFER_SIZE;
+    buf->bid = bid;
+    backend->buf_tail++;
+    __atomic_store_n(&backend->buf_ring->tail, backend->buf_tail, __ATOMIC_RELEASE);
+}
+
+static void
+arm_accept(uring_backend_t *backend)
+{
+    struct io_uring_sqe *sqe = get_sqe(backend);
+    if (!sqe) {
+        log(ERROR, "Submission queue full, cannot arm accept");
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = backend->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = pack_user_data(NULL, OP_ACCEPT);
+}
+
+static void
+arm_recv(uring_backend_t *backend, uring_conn_t *conn)
+{
+    struct io_uring_sqe *sqe = get_sqe(backend);
+    if (!sqe) {
+        log(ERROR, "Submission queue full, cannot arm recv for %d", conn->fd);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = pack_user_data(conn, OP_RECV);
+    conn->recv_armed = true;
+}
+
+static void
+mark_dirty(uring_backend_t *backend, uring_conn_t *conn)
+{
+    if (!conn->dirty) {
+        conn->dirty = true;
+        conn->next_dirty = backend->dirty;
+        backend->dirty = conn;
+    }
+}
+
+// A closed connection is released once the kernel holds no request on it
+static void
+maybe_free_conn(uring_conn_t *conn)
+{
+    if (conn->closed && !conn->recv_armed && !conn->send_inflight && !conn->dirty) {
+        output_queue_clear(&conn->out);
+        frame_ring_destroy(conn->ring);
+        free(conn);
+    }
+}
+
+static void close_conn(uring_backend_t *backend, uring_conn_t *conn);
+
+// Handlers run from here (on_close) may queue more output, so pop one
+// connection at a time until the list stays empty
+static void
+flush_sends(uring_backend_t *backend)
+{
+    while (backend->dirty) {
+        uring_conn_t *conn = backend->dirty;
+        struct io_uring_sqe *sqe = NULL;
+
+        bool needs_send = !conn->closed && !conn->overflow && !conn->send_inflight &&
+                          !output_queue_empty(&conn->out);
+        if (needs_send && !(sqe = get_sqe(backend))) {
+            // Submission queue full: retry on the next iteration
+            return;
+        }
+        backend->dirty = conn->next_dirty;
+        conn->dirty = false;
+
+        if (!conn->closed && conn->overflow) {
+            log(WARN, "Client %d is not reading (%d bytes queued), disconnecting",
+                conn->fd, OUTPUT_QUEUE_LIMIT);
+            backend->stats->overflows++;
+            backend->handlers.on_close(backend->ctx, conn->fd);
+            close_conn(backend, conn);
+        } else if (sqe) {
+            memset(&conn->msg, 0, sizeof(conn->msg));
+            conn->msg.msg_iov = conn->iov;
+            conn->msg.msg_iovlen = output_queue_iov(&conn->out, conn->iov, OUTPUT_QUEUE_IOV_MAX);
+
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = conn->fd;
+            sqe->addr = (uint64_t) (uintptr_t) &conn->msg;
+            sqe->len = 1;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = pack_user_data(conn, OP_SEND);
+            conn->send_inflight = true;
+        }
+
+        maybe_free_conn(conn);
+    }
+}
+
+static void
+close_conn(uring_backend_t *backend, uring_conn_t *conn)
+{
+    conn->closed = true;
+    if (conn->fd < backend->conn_capacity && backend->conns[conn->fd] == conn) {
+        backend->conns[conn->fd] = NULL;
+    }
+
+    // Cancel the armed recv and any in-flight send, then close the fd.
+    // The hard link runs the close even when there was nothing to cancel.
+    struct io_uring_sqe *sqe = get_sqe(backend);
+    if (!sqe) {
+        log(ERROR, "Submission queue full, closing %d synchronously", conn->fd);
+        backend->stats->syscalls++;
+        close(conn->fd);
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = conn->fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->flags = IOSQE_IO_HARDLINK;
+    sqe->user_data = pack_user_data(NULL, OP_IGNORE);
+
+    sqe = get_sqe(backend);
+    if (!sqe) {
+        log(ERROR, "Submission queue full, closing %d synchronously", conn->fd);
+        backend->stats->syscalls++;
+        close(conn->fd);
+        return;
+    }
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = conn->fd;
+    sqe->user_data = pack_user_data(NULL, OP_IGNORE);
+}
+
+static int
+push_pending(uring_backend_t *backend, int fd)
+{
+    if (backend->pending_head + backend->pending_count == backend->pending_capacity) {
+        if (backend->pending_head > 0) {
+            memmove(backend->pending_fds, backend->pending_fds + backend->pending_head,
+                    sizeof(int) * backend->pending_count);
+            backend->pending_head = 0;
+        } else {
+            int capacity = backend->pending_capacity ? backend->pending_capacity * 2 : IO_ACCEPT_BATCH;
+            int *fds = realloc(backend->pending_fds, sizeof(int) * capacity);
+            if (!fds) {
+                return RET_ERROR;
+            }
+            backend->pending_fds = fds;
+            backend->pending_capacity = capacity;
+        }
+    }
+    backend->pending_fds[backend->pending_head + backend->pending_count++] = fd;
+    return RET_SUCCESS;
+}
+
+static void
+handle_accept(uring_backend_t *backend, struct io_uring_cqe *cqe)
+{
+    if (cqe->res >= 0) {
+        if (push_pending(backend, cqe->res) < 0) {
+            log(ERROR, "Failed to queue accepted socket %d, closing it", cqe->res);
+            backend->stats->syscalls++;
+            close(cqe->res);
+        }
+    } else if (cqe->res != -EAGAIN && cqe->res != -EINTR) {
+        log(WARN, "accept failed: %s", strerror(-cqe->res));
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        arm_accept(backend);
+    }
+}
+
+static void
+handle_recv(uring_backend_t *backend, uring_conn_t *conn, struct io_uring_cqe *cqe)
+{
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        conn->recv_armed = false;
+    }
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned short bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        const char *data = backend->buf_base + (size_t) bid * URING_RECV_BUFFER_SIZE;
+        size_t len = cqe->res > 0 ? cqe->res : 0;
+        if (len > 0 && !conn->closed) {
+            backend->stats->recvs++;
+        }
+        while (len > 0 && !conn->closed && !conn->overflow) {
+            size_t pushed = frame_ring_push(conn->ring, data, len);
+            data += pushed;
+            len -= pushed;
+            if (io_backend_dispatch_frames(conn->ring, &backend->handlers, backend->ctx, conn->fd,
+                                           backend->stats, &conn->closed) < 0) {
+                backend->handlers.on_close(backend->ctx, conn->fd);
+                close_conn(backend, conn);
+            }
+        }
+        recycle_buffer(backend, bid);
+    }
+
+    if (!conn->closed) {
+        if (cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS)) {
+            if (cqe->res < 0) {
+                log(ERROR, "Read failed from client %d: %s", conn->fd, strerror(-cqe->res));
+            }
+            backend->handlers.on_close(backend->ctx, conn->fd);
+            close_conn(backend, conn);
+        } else if (!conn->recv_armed) {
+            arm_recv(backend, conn);
+        }
+    }
+    maybe_free_conn(conn);
+}
+
+static void
+handle_send(uring_backend_t *backend, uring_conn_t *conn, struct io_uring_cqe *cqe)
+{
+    conn->send_inflight = false;
+
+    if (cqe->res > 0) {
+        backend->stats->bytes_sent += cqe->res;
+        metrics_add(COUNTER_BYTES_SENT, cqe->res);
+        output_queue_consume(&conn->out, cqe->res);
+    } else if (cqe->res == -EAGAIN) {
+        metrics_inc(COUNTER_SEND_EAGAIN);
+    } else if (cqe->res != -EINTR) {
+        // The recv side reports the hangup; nothing queued can be delivered
+        metrics_inc(COUNTER_SEND_ERRORS);
+        if (!conn->closed) {
+            log(ERROR, "Failed to send to socket %d: %s", conn->fd, strerror(-cqe->res));
+        }
+        output_queue_clear(&conn->out);
+    }
+
+    if (!conn->closed && !output_queue_empty(&conn->out)) {
+        mark_dirty(backend, conn);
+    }
+    maybe_free_conn(conn);
+}
+
+static void
+reap_completions(uring_backend_t *backend)
+{
+    unsigned head = *backend->cq_head;
+    unsigned tail = __atomic_load_n(backend->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &backend->cqes[head & backend->cq_mask];
+        void *ptr = (void *) (uintptr_t) (cqe->user_data & ~OP_MASK);
+
+        switch (cqe->user_data & OP_MASK) {
+            case OP_ACCEPT:
+                handle_accept(backend, cqe);
+                break;
+            case OP_RECV:
+                handle_recv(backend, ptr, cqe);
+                break;
+            case OP_SEND:
+                handle_send(backend, ptr, cqe);
+                break;
+            default:
+                break;
+        }
+
+        head++;
+        __atomic_store_n(backend->cq_head, head, __ATOMIC_RELEASE);
+        tail = __atomic_load_n(backend->cq_tail, __ATOMIC_ACQUIRE);
+    }
+}
+
+// Announces at most IO_ACCEPT_BATCH accepted sockets, oldest first
+static void
+announce_accepts(uring_backend_t *backend)
+{
+    int count = backend->pending_count < IO_ACCEPT_BATCH ? backend->pending_count : IO_ACCEPT_BATCH;
+    for (int i = 0; i < count; i++) {
+        int fd = backend->pending_fds[backend->pending_head++];
+        backend->pending_count--;
+        backend->stats->accepts++;
+        metrics_ingress_begin();
+        metrics_ingress_message();
+        backend->handlers.on_accept(backend->ctx, fd);
+        metrics_ingress_end();
+    }
+    if (backend->pending_count == 0) {
+        backend->pending_head = 0;
+    }
+    if (count > 0) {
+        io_backend_note_accepts(backend->listen_fd, count, &backend->accept_queue);
+    }
+}
+
+static int
+setup_buffer_ring(uring_backend_t *backend)
+{
+    backend->buf_ring_size = URING_RECV_BUFFERS * sizeof(struct io_uring_buf);
+    backend->buf_ring = mmap(NULL, backend->buf_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (backend->buf_ring == MAP_FAILED) {
+        backend->buf_ring = NULL;
+        return RET_ERROR;
+    }
+
+    backend->buf_base = malloc((size_t) URING_RECV_BUFFERS * URING_RECV_BUFFER_SIZE);
+    if (!backend->buf_base) {
+        return RET_ERROR;
+    }
+
+    struct io_uring_buf_reg reg = {0};
+    reg.ring_addr = (uint64_t) (uintptr_t) backend->buf_ring;
+    reg.ring_entries = URING_RECV_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, backend->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        log(WARN, "io_uring provided buffer ring unsupported: %s", strerror(errno));
+        return RET_ERROR;
+    }
+
+    backend->buf_tail = 0;
+    for (unsigned short bid = 0; bid < URING_RECV_BUFFERS; bid++) {
+        recycle_buffer(backend, bid);
+    }
+    return RET_SUCCESS;
+}
+
+static void uring_destroy(void *impl);
+
+static void *
+uring_create(int listen_fd, const io_handlers_t *handlers, void *ctx, io_stats_t *stats)
+{
+    uring_backend_t *backend = calloc(1, sizeof(uring_backend_t));
+    if (!backend) {
+        log(ERROR, "Failed to allocate memory for io_uring backend");
+        return NULL;
+    }
+    backend->listen_fd = listen_fd;
+    backend->handlers = *handlers;
+    backend->ctx = ctx;
+    backend->stats = stats;
+    backend->ring_fd = -1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    backend->ring_fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (backend->ring_fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        backend->ring_fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    }
+    if (backend->ring_fd < 0) {
+        log(WARN, "io_uring_setup() failed: %s", strerror(errno));
+        uring_destroy(backend);
+        return NULL;
+    }
+
+    unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & required) != required) {
+        log(WARN, "io_uring is missing required features (0x%x)", params.features);
+        uring_destroy(backend);
+        return NULL;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    backend->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    backend->ring_ptr = mmap(NULL, backend->ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, backend->ring_fd, IORING_OFF_SQ_RING);
+    backend->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    backend->sqes = mmap(NULL, backend->sqes_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, backend->ring_fd, IORING_OFF_SQES);
+    if (backend->ring_ptr == MAP_FAILED || backend->sqes == MAP_FAILED) {
+        log(WARN, "io_uring mmap() failed: %s", strerror(errno));
+        if (backend->ring_ptr == MAP_FAILED) {
+            backend->ring_ptr = NULL;
+        }
+        if (backend->sqes == MAP_FAILED) {
+            backend->sqes = NULL;
+        }
+        uring_destroy(backend);
+        return NULL;
+    }
+
+    char *ring = backend->ring_ptr;
+    backend->sq_head = (unsigned *) (ring + params.sq_off.head);
+    backend->sq_tail = (unsigned *) (ring + params.sq_off.tail);
+    backend->sq_array = (unsigned *) (ring + params.sq_off.array);
+    backend->sq_mask = *(unsigned *) (ring + params.sq_off.ring_mask);
+    backend->sq_entries = params.sq_entries;
+    backend->sq_local_tail = *backend->sq_tail;
+    backend->cq_head = (unsigned *) (ring + params.cq_off.head);
+    backend->cq_tail = (unsigned *) (ring + params.cq_off.tail);
+    backend->cq_mask = *(unsigned *) (ring + params.cq_off.ring_mask);
+    backend->cqes = (struct io_uring_cqe *) (ring + params.cq_off.cqes);
+
+    if (setup_buffer_ring(backend) < 0) {
+        uring_destroy(backend);
+        return NULL;
+    }
+
+    backend->conns = calloc(INITIAL_CONN_CAPACITY, sizeof(uring_conn_t *));
+    if (!backend->conns) {
+        uring_destroy(backend);
+        return NULL;
+    }
+    backend->conn_capacity = INITIAL_CONN_CAPACITY;
+
+    arm_accept(backend);
+    return backend;
+}
+
+static void
+uring_destroy(void *impl)
+{
+    uring_backend_t *backend = impl;
+    if (!backend) {
+        return;
+    }
+
+    for (int fd = 0; fd < backend->conn_capacity; fd++) {
+        if (backend->conns[fd]) {
+            close(fd);
+            output_queue_clear(&backend->conns[fd]->out);
+            frame_ring_destroy(backend->conns[fd]->ring);
+            free(backend->conns[fd]);
+        }
+    }
+    free(backend->conns);
+    for (int i = 0; i < backend->pending_count; i++) {
+        close(backend->pending_fds[backend->pending_head + i]);
+    }
+    free(backend->pending_fds);
+    if (backend->ring_fd >= 0) {
+        close(backend->ring_fd);
+    }
+    if (backend->buf_ring) {
+        munmap(backend->buf_ring, backend->buf_ring_size);
+    }
+    free(backend->buf_base);
+    if (backend->sqes) {
+        munmap(backend->sqes, backend->sqes_size);
+    }
+    if (backend->ring_ptr) {
+        munmap(backend->ring_ptr, backend->ring_size);
+    }
+    free(backend);
+}
+
+static int
+uring_watch(void *impl, int fd)
+{
+    uring_backend_t *backend = impl;
+    if (fd < 0) {
+        return RET_ERROR;
+    }
+
+    if (fd >= backend->conn_capacity) {
+        int capacity = backend->conn_capacity;
+        while (capacity <= fd) {
+            capacity *= 2;
+        }
+        uring_conn_t **conns = realloc(backend->conns, sizeof(uring_conn_t *) * capacity);
+        if (!conns) {
+            log(ERROR, "Failed to grow io_uring connection table");
+            return RET_ERROR;
+        }
+        memset(conns + backend->conn_capacity, 0,
+               sizeof(uring_conn_t *) * (capacity - backend->conn_capacity));
+        backend->conns = conns;
+        backend->conn_capacity = capacity;
+    }
+
+    uring_conn_t *conn = calloc(1, sizeof(uring_conn_t));
+    if (!conn) {
+        log(ERROR, "Failed to allocate memory for io_uring connection");
+        return RET_ERROR;
+    }
+    conn->ring = frame_ring_create();
+    if (!conn->ring) {
+        free(conn);
+        return RET_ERROR;
+    }
+    conn->fd = fd;
+    backend->conns[fd] = conn;
+    arm_recv(backend, conn);
+    return RET_SUCCESS;
+}
+
+static void
+uring_close(void *impl, int fd)
+{
+    uring_backend_t *backend = impl;
+    uring_conn_t *conn = fd >= 0 && fd < backend->conn_capacity ? backend->conns[fd] : NULL;
+    if (conn) {
+        // May run inside a completion handler for this conn, so release it
+        // from the next flush instead of here
+        close_conn(backend, conn);
+        mark_dirty(backend, conn);
+        return;
+    }
+    backend->stats->syscalls++;
+    close(fd);
+}
+
+static int
+uring_send(void *impl, int fd, shared_frame_t *frame)
+{
+    uring_backend_t *backend = impl;
+    uring_conn_t *conn = fd >= 0 && fd < backend->conn_capacity ? backend->conns[fd] : NULL;
+    if (!conn) {
+        // Not watched (e.g. a connection being rejected): plain send
+        backend->stats->syscalls++;
+        ssize_t rv = send(fd, frame->data, frame->len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (rv > 0) {
+            backend->stats->bytes_sent += rv;
+            metrics_add(COUNTER_BYTES_SENT, rv);
+        } else {
+            metrics_inc(COUNTER_SEND_ERRORS);
+        }
+        return rv < 0 ? RET_ERROR : RET_SUCCESS;
+    }
+
+    if (conn->overflow) {
+        return RET_ERROR;
+    }
+    if (output_queue_push(&conn->out, frame) < 0) {
+        // A burst of replies within one iteration: hand what we have to the
+        // kernel directly (only safe with no SENDMSG in flight, for ordering)
+        // before deciding the client is not reading
+        if (!conn->send_inflight) {
+            struct msghdr msg = {0};
+            msg.msg_iov = conn->iov;
+            msg.msg_iovlen = output_queue_iov(&conn->out, conn->iov, OUTPUT_QUEUE_IOV_MAX);
+            backend->stats->syscalls++;
+            ssize_t rv = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (rv > 0) {
+                backend->stats->bytes_sent += rv;
+                metrics_add(COUNTER_BYTES_SENT, rv);
+                output_queue_consume(&conn->out, rv);
+            }
+        }
+        if (output_queue_push(&conn->out, frame) < 0) {
+            conn->overflow = true;
+            mark_dirty(backend, conn);
+            return RET_ERROR;
+        }
+    }
+
+    mark_dirty(backend, conn);
+    return RET_SUCCESS;
+}
+
+static int
+uring_poll(void *impl, int timeout_ms)
+{
+    uring_backend_t *backend = impl;
+
+    flush_sends(backend);
+    // The SENDMSGs prepared above are submitted by this enter
+    metrics_latency_flush();
+    // Sockets still waiting to be announced: only collect what is ready
+    int ret = uring_enter(backend, 1, backend->pending_count > 0 ? 0 : timeout_ms);
+    reap_completions(backend);
+    // New players only after the rooms already playing were served
+    announce_accepts(backend);
+    return ret;
+}
+
+const io_backend_ops_t io_uring_backend_ops = {
+    .name = "io_uring",
+    .create = uring_create,
+    .destroy = uring_destroy,
+    .watch = uring_watch,
+    .close = uring_close,
+    .send = uring_send,
+    .poll = uring_poll,
+};
+
+#endif // WEREWOLF_USE_IO_URING
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "defs.h"
+#include "frame.h"
+#include "output_queue.h"
+
+#define SMALL_FRAME_PAYLOAD 240     // Most chat lines and announcements
+#define POOL_LIMIT 1024             // Free blocks kept per list
+
+typedef enum {
+    POOL_SMALL_FRAME,
+    POOL_FRAME,
+    POOL_CHUNK,
+    POOL_COUNT
+} pool_id_t;
+
+typedef struct pool_block_t {
+    struct pool_block_t *next;
+} pool_block_t;
+
+typedef struct {
+    pool_block_t *head;
+    int count;
+} block_pool_t;
+
+static const size_t block_sizes[POOL_COUNT] = {
+    [POOL_SMALL_FRAME] = sizeof(shared_frame_t) + FRAME_HEADER_SIZE + SMALL_FRAME_PAYLOAD,
+    [POOL_FRAME] = sizeof(shared_frame_t) + FRAME_HEADER_SIZE + FRAME_MAX_PAYLOAD,
+    [POOL_CHUNK] = sizeof(out_chunk_t),
+};
+static __thread block_pool_t pools[POOL_COUNT];
+
+static void *
+pool_get(pool_id_t id)
+{
+    block_pool_t *pool = &pools[id];
+    pool_block_t *block = pool->head;
+    if (!block) {
+        return malloc(block_sizes[id]);
+    }
+    pool->head = block->next;
+    pool->count--;
+    return block;
+}
+
+static void
+pool_put(pool_id_t id, void *ptr)
+{
+    block_pool_t *pool = &pools[id];
+    if (pool->count >= POOL_LIMIT) {
+        free(ptr);
+        return;
+    }
+    pool_block_t *block = ptr;
+    block->next = pool->head;
+    pool->head = block;
+    pool->count++;
+}
+
+shared_frame_t *
+shared_frame_create(const void *payload, size_t len)
+{
+    int pool = len <= SMALL_FRAME_PAYLOAD ? POOL_SMALL_FRAME : len <= FRAME_MAX_PAYLOAD ? POOL_FRAME : -1;
+    shared_frame_t *frame = pool >= 0 ? pool_get(pool) : malloc(sizeof(shared_frame_t) + FRAME_HEADER_SIZE + len);
+    if (!frame) {
+        log(ERROR, "Failed to allocate memory for frame");
+        return NULL;
+    }
+    frame_encode_header(frame->data, len);
+    memcpy(frame->data + FRAME_HEADER_SIZE, payload, len);
+    frame->len = FRAME_HEADER_SIZE + len;
+    frame->refs = 1;
+    frame->pool = pool;
+    return frame;
+}
+
+void
+shared_frame_unref(shared_frame_t *frame)
+{
+    if (--frame->refs == 0) {
+        if (frame->pool >= 0) {
+            pool_put(frame->pool, frame);
+        } else {
+            free(frame);
+        }
+    }
+}
+
+int
+output_queue_push(output_queue_t *queue, shared_frame_t *frame)
+{
+    if (queue->bytes + frame->len > OUTPUT_QUEUE_LIMIT) {
+        return RET_ERROR;
+    }
+
+    out_chunk_t *chunk = pool_get(POOL_CHUNK);
+    if (!chunk) {
+        log(ERROR, "Failed to allocate memory for output chunk");
+        return RET_ERROR;
+    }
+    frame->refs++;
+    chunk->frame = frame;
+    chunk->offset = 0;
+    chunk->next = NULL;
+
+    if (queue->tail) {
+        queue->tail->next = chunk;
+    } else {
+        queue->head = chunk;
+    }
+    queue->tail = chunk;
+    queue->bytes += frame->len;
+    return RET_SUCCESS;
+}
+
+int
+output_queue_iov(const output_queue_t *queue, struct iovec *iov, int max)
+{
+    int count = 0;
+    for (out_chunk_t *chunk = queue->head; chunk && count < max; chunk = chunk->next) {
+        iov[count].iov_base = chunk->frame->data + chunk->offset;
+        iov[count].iov_len = chunk->frame->len - chunk->offset;
+        count++;
+    }
+    return count;
+}
+
+static void
+pop_chunk(output_queue_t *queue)
+{
+    out_chunk_t *chunk = queue->head;
+    queue->head = chunk->next;
+    shared_frame_unref(chunk->frame);
+    pool_put(POOL_CHUNK, chunk);
+}
+
+void
+output_queue_consume(output_queue_t *queue, size_t written)
+{
+    queue->bytes -= written;
+    while (queue->head && written > 0) {
+        out_chunk_t *chunk = queue->head;
+        size_t remaining = chunk->frame->len - chunk->offset;
+        if (written < remaining) {
+            chunk->offset += written;
+            return;
+        }
+        written -= remaining;
+        pop_chunk(queue);
+    }
+    if (!queue->head) {
+        queue->tail = NULL;
+    }
+}
+
+void
+output_queue_clear(output_queue_t *queue)
+{
+    while (queue->head) {
+        pop_chunk(queue);
+    }
+    queue->tail = NULL;
+    queue->bytes = 0;
+}
+
+bool
+output_queue_empty(const output_queue_t *queue)
+{
+    return queue->head == NULL;
+}
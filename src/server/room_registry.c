@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "defs.h"
+#include "room_registry.h"
+#include "game_flow.h"
+
+#define INITIAL_SOCKET_CAPACITY 1024
+
+typedef struct room_registry_cdt {
+    int max_players;
+    int max_rooms;          // 0 means unlimited
+    int room_count;
+    int next_room_id;
+    room_t *rooms;          // All live rooms, most recent first
+    room_t *lobby;          // Room currently accepting players
+    room_t **by_socket;     // socket_id -> room, O(1) lookup
+    int socket_capacity;
+    timer_wheel_t timers;
+    journal_t journal;      // NULL when not recording
+} room_registry_cdt;
+
+static size_t
+room_arena_size(int max_players)
+{
+    return arena_footprint(sizeof(room_t)) +
+           game_manager_arena_size(max_players) +
+           CHANNEL_COUNT * arena_footprint(sizeof(uint64_t) * BITSET_WORDS(max_players)) +
+           game_flow_arena_size(max_players);
+}
+
+static room_t *
+room_create(room_registry_t registry)
+{
+    int max_players = registry->max_players;
+    arena_t arena = arena_create(room_arena_size(max_players));
+    if (!arena) {
+        return NULL;
+    }
+
+    room_t *room = arena_alloc(arena, sizeof(room_t));
+    if (!room) {
+        log(ERROR, "Failed to allocate memory for room");
+        arena_destroy(arena);
+        return NULL;
+    }
+    room->arena = arena;
+
+    room->game_manager = game_manager_create(arena, max_players);
+    if (!room->game_manager) {
+        arena_destroy(arena);
+        return NULL;
+    }
+
+    // Seats never pass max_players, so membership changes cannot allocate
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        room->channels[i].channel = (message_channel_t) i;
+        bitset_init_fixed(&room->channels[i].members,
+                          arena_alloc(arena, sizeof(uint64_t) * BITSET_WORDS(max_players)), max_players);
+    }
+
+    room->timers = registry->timers;
+    timer_init(&room->phase_timer, NULL, room);
+
+    room->id = ++registry->next_room_id;
+    if (registry->journal) {
+        game_manager_set_journal(room->game_manager, registry->journal, room->id);
+    }
+    room->prev = NULL;
+    room->next = registry->rooms;
+    if (registry->rooms) {
+        registry->rooms->prev = room;
+    }
+    registry->rooms = room;
+    registry->room_count++;
+
+    log(INFO, "Room %d opened (%d rooms)", room->id, registry->room_count);
+    return room;
+}
+
+static void
+room_destroy(room_registry_t registry, room_t *room)
+{
+    if (room->prev) {
+        room->prev->next = room->next;
+    } else {
+        registry->rooms = room->next;
+    }
+    if (room->next) {
+        room->next->prev = room->prev;
+    }
+    if (registry->lobby == room) {
+        registry->lobby = NULL;
+    }
+    registry->room_count--;
+
+    log(INFO, "Room %d closed (%d rooms)", room->id, registry->room_count);
+    timer_wheel_cancel(room->timers, &room->phase_timer);
+    game_manager_destroy(room->game_manager);
+    arena_destroy(room->arena);
+}
+
+room_registry_t
+room_registry_create(int max_players, int max_rooms, timer_wheel_t timers, journal_t journal)
+{
+    room_registry_cdt *registry = malloc(sizeof(room_registry_cdt));
+    if (!registry) {
+        log(ERROR, "Failed to allocate memory for room registry");
+        return NULL;
+    }
+
+    registry->by_socket = calloc(INITIAL_SOCKET_CAPACITY, sizeof(room_t *));
+    if (!registry->by_socket) {
+        log(ERROR, "Failed to allocate memory for room socket map");
+        free(registry);
+        return NULL;
+    }
+
+    registry->socket_capacity = INITIAL_SOCKET_CAPACITY;
+    registry->max_players = max_players;
+    registry->max_rooms = max_rooms;
+    registry->timers = timers;
+    registry->journal = journal;
+    registry->room_count = 0;
+    registry->next_room_id = 0;
+    registry->rooms = NULL;
+    registry->lobby = NULL;
+    return registry;
+}
+
+void
+room_registry_destroy(room_registry_t registry)
+{
+    if (!registry) {
+        return;
+    }
+
+    while (registry->rooms) {
+        room_destroy(registry, registry->rooms);
+    }
+    free(registry->by_socket);
+    free(registry);
+}
+
+room_t *
+room_registry_get_lobby(room_registry_t registry)
+{
+    if (!registry) {
+        return NULL;
+    }
+
+    if (registry->lobby) {
+        return registry->lobby;
+    }
+
+    if (registry->max_rooms > 0 && registry->room_count >= registry->max_rooms) {
+        log(WARN, "Room limit reached (%d rooms)", registry->max_rooms);
+        return NULL;
+    }
+
+    registry->lobby = room_create(registry);
+    return registry->lobby;
+}
+
+void
+room_registry_close_lobby(room_registry_t registry, room_t *room)
+{
+    if (registry && registry->lobby == room) {
+        registry->lobby = NULL;
+    }
+}
+
+void
+room_registry_release_if_empty(room_registry_t registry, room_t *room)
+{
+    if (!registry || !room || room == registry->lobby) {
+        return;
+    }
+
+    if (game_manager_get_player_count(room->game_manager) == 0) {
+        room_destroy(registry, room);
+    }
+}
+
+int
+room_registry_bind_socket(room_registry_t registry, int socket_id, room_t *room)
+{
+    if (!registry || socket_id < 0) {
+        return RET_ERROR;
+    }
+
+    if (socket_id >= registry->socket_capacity) {
+        int capacity = registry->socket_capacity;
+        while (capacity <= socket_id) {
+            capacity *= 2;
+        }
+        room_t **by_socket = realloc(registry->by_socket, sizeof(room_t *) * capacity);
+        if (!by_socket) {
+            log(ERROR, "Failed to grow room socket map");
+            return RET_ERROR;
+        }
+        memset(by_socket + registry->socket_capacity, 0,
+               sizeof(room_t *) * (capacity - registry->socket_capacity));
+        registry->by_socket = by_socket;
+        registry->socket_capacity = capacity;
+    }
+
+    registry->by_socket[socket_id] = room;
+    return RET_SUCCESS;
+}
+
+void
+room_registry_unbind_socket(room_registry_t registry, int socket_id)
+{
+    if (registry && socket_id >= 0 && socket_id < registry->socket_capacity) {
+        registry->by_socket[socket_id] = NULL;
+    }
+}
+
+room_t *
+room_registry_find_by_socket(room_registry_t registry, int socket_id)
+{
+    if (!registry || socket_id < 0 || socket_id >= registry->socket_capacity) {
+        return NULL;
+    }
+    return registry->by_socket[socket_id];
+}
+
+int
+room_registry_get_room_count(room_registry_t registry)
+{
+    return registry ? registry->room_count : 0;
+}
+
+room_t *
+room_registry_first(room_registry_t registry)
+{
+    return registry ? registry->rooms : NULL;
+}
@@ -6,10 +6,16 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <errno.h>
-#include <sys/select.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "tcp_server_util.h"
+#include "io_backend.h"
+#include "room_registry.h"
 #include "logger.h"
 #include "defs.h"
 #include "game_manager.h"
@@ -17,213 +23,467 @@
 #include "game_messanger.h"
 #include "game_util.h"
 #include "command_handler.h"
+#include "game_flow.h"
+#include "metrics.h"
+#include "admin_server.h"
+#include "timer_wheel.h"
+#include "wire.h"
+#include "journal.h"
 
 #define DEFAULT_PORT "8080"
 #define DEFAULT_MAX_PLAYERS 16
+#define DEFAULT_MAX_ROOMS 0
+#define DEFAULT_WORKERS 1
+#define MAX_WORKERS 256
 #define BUFFER_SIZE 1024
-
-static channel_subscription_t chat_channel = {CHANNEL_CHAT, {0}, 0};
-static channel_subscription_t werewolf_channel = {CHANNEL_WEREWOLF, {0}, 0};
-static channel_subscription_t announcement_channel = {CHANNEL_ANNOUNCEMENT, {0}, 0};
-static channel_subscription_t server_channel = {CHANNEL_SERVER, {0}, 0};
-
-void
-handle_client_data(int client_socket, game_manager_t game_manager, client_fd_list_t **client_fd_list)
+#define IO_STATS_INTERVAL_SEC 10
+#define DEFAULT_IDLE_TIMEOUT_SEC 60
+// Connection bursts queue here until the next accept batch; the kernel caps it
+// at net.core.somaxconn
+#define DEFAULT_BACKLOG 1024
+#define SHUTDOWN_KICK_NS 10000000   // Between wake-ups of a worker that has not stopped yet
+
+// One reactor: a listener, an io backend and the rooms it owns.
+// Workers never touch each other's server_t.
+typedef struct {
+    int id;
+    int server_socket;
+    int max_players;
+    io_backend_t io;
+    io_stats_t last_stats;  // Snapshot at the last io stats report
+    timer_wheel_t timers;   // Phase deadlines and client heartbeats of this worker
+    journal_t journal;      // NULL unless run with -j
+    room_registry_t rooms;
+    pthread_t thread;
+    atomic_bool stopped;    // Left server_run
+} server_t;
+
+// Set by SIGTERM/SIGINT; every worker leaves its loop at the next wake-up
+static volatile sig_atomic_t stopping = 0;
+static pthread_t main_thread;
+
+// on_close handler: the backend closes the socket once we return
+static void
+disconnect_client(void *ctx, int client_socket)
 {
-    char buffer[BUFFER_SIZE] = {0};
-    int valread = read(client_socket, buffer, BUFFER_SIZE - 1);
-    
-    if (valread <= 0) {
-        if (valread < 0) {
-            log(ERROR, "Read failed from client %d: %s", client_socket, strerror(errno));
-        }
-        // Client disconnected
-        log(INFO, "Client %d disconnected", client_socket);
-        close(client_socket);
-        *client_fd_list = remove_client_fd(*client_fd_list, client_socket);
-        game_manager_remove_player(game_manager, client_socket);
-        
-        unsubscribe_from_channel(&chat_channel, client_socket);
-        unsubscribe_from_channel(&werewolf_channel, client_socket);
-        unsubscribe_from_channel(&announcement_channel, client_socket);
-        unsubscribe_from_channel(&server_channel, client_socket);
+    server_t *server = ctx;
+    log(INFO, "Client %d disconnected", client_socket);
+    // The next connection on this fd starts on the text protocol
+    set_socket_wire_version(client_socket, 0);
+
+    room_t *room = room_registry_find_by_socket(server->rooms, client_socket);
+    if (!room) {
         return;
     }
+    room_registry_unbind_socket(server->rooms, client_socket);
+    metrics_gauge_add(GAUGE_CONNECTIONS, -1);
 
-    buffer[valread] = '\0';
-
-    // Ignore empty messages
-    char *trimmed = buffer;
-   while (*trimmed == ' ' || *trimmed == '\t' || *trimmed == '\n' || *trimmed == '\r') trimmed++;
-   if (*trimmed == '\0') {
-       return;
-   }
-
-    int sender_number = game_manager_get_player_number(game_manager, client_socket);
-    log(INFO, "Received from client %d (player %d): %s", client_socket, sender_number, buffer);
-
-    if (handle_if_command(buffer, client_socket, game_manager) > 0) {
-        return;
+    int seat = game_manager_get_player_seat(room->game_manager, client_socket);
+    if (seat >= 0) {
+        for (int i = 0; i < CHANNEL_COUNT; i++) {
+            unsubscribe_from_channel(&room->channels[i], seat);
+        }
     }
+    game_manager_remove_player(room->game_manager, client_socket);
+    if (game_manager_get_player_count(room->game_manager) > 0) {
+        // The leaver may have been the last vote missing, or decided the game
+        game_flow_check(room);
+    }
+    room_registry_release_if_empty(server->rooms, room);
+}
 
+// Plain chat: the whole room by day, the werewolves at night
+static void
+handle_chat(int client_socket, room_t *room, int sender_number, const char *buffer)
+{
+    game_manager_t game_manager = room->game_manager;
     if (sender_number <= 0) {
         log(ERROR, "Invalid player number for client %d", client_socket);
         return;
     }
 
-    char formatted[BUFFER_SIZE];
-    // Handle it better
-    switch (game_manager_get_phase(game_manager)) {
+    game_state_t phase = game_manager_get_phase(game_manager);
+    if (phase != GAME_STATE_LOBBY && phase != GAME_STATE_ENDED &&
+        !game_manager_is_player_alive(game_manager, client_socket)) {
+        send_server_notice(client_socket, NOTICE_DEAD_CANNOT_TALK);
+        return;
+    }
+
+    switch (phase) {
         case GAME_STATE_DAY:
+        case GAME_STATE_VOTING:
+        case GAME_STATE_ENDED:
             log(INFO, "Sending message to chat channel");
-            snprintf(formatted, BUFFER_SIZE, "%s", format_message(CHANNEL_CHAT, sender_number, buffer));
-            forward_message(&chat_channel, formatted);
+            forward_message(CHANNEL_CHAT, &room->channels[CHANNEL_CHAT].members,
+                            game_manager_get_seat_sockets(game_manager), sender_number, buffer);
             break;
         case GAME_STATE_NIGHT:
             log(INFO, "Sending message to werewolf channel");
-            snprintf(formatted, BUFFER_SIZE, "%s", format_message(CHANNEL_CHAT, sender_number, buffer));
             if (game_manager_is_player_werewolf(game_manager, client_socket)) {
-                send_message(client_socket, CHANNEL_WEREWOLF, buffer, sender_number);
+                forward_message(CHANNEL_WEREWOLF, &room->channels[CHANNEL_WEREWOLF].members,
+                                game_manager_get_seat_sockets(game_manager), sender_number, buffer);
                 break;
             }
-            char msg[BUFFER_SIZE] = "It is night time, you are not allowed to talk!";
-            snprintf(formatted, BUFFER_SIZE, "%s", format_server_message(msg));
-            send_message(client_socket, CHANNEL_SERVER, formatted, sender_number);
+            send_server_notice(client_socket, NOTICE_NIGHT_SILENCE);
             break;
-        // TODO: Add voting and ended phases
-        case GAME_STATE_VOTING:
-        case GAME_STATE_ENDED:
+        case GAME_STATE_LOBBY:
         default:
-
             break;
     }
+}
+
+static void
+handle_client_message(int client_socket, room_t *room, const char *buffer)
+{
+    game_manager_t game_manager = room->game_manager;
+
+    // Ignore empty messages
+    const char *trimmed = buffer;
+   while (*trimmed == ' ' || *trimmed == '\t' || *trimmed == '\n' || *trimmed == '\r') trimmed++;
+   if (*trimmed == '\0') {
+       return;
+   }
+
+    int sender_number = game_manager_get_player_number(game_manager, client_socket);
+    log(INFO, "Received from client %d (player %d): %s", client_socket, sender_number, buffer);
+
+    if (handle_if_command(buffer, client_socket, room) > 0) {
+        return;
+    }
+    handle_chat(client_socket, room, sender_number, buffer);
+}
 
+// Binary protocol: the record is already parsed, no command text to match
+static void
+handle_client_record(int client_socket, room_t *room, const char *payload, size_t len)
+{
+    wire_record_t record;
+    if (wire_decode(payload, len, &record) < 0) {
+        log(WARN, "Client %d sent a malformed record", client_socket);
+        return;
+    }
+    if (handle_wire_command(&record, client_socket, room) != 0 || record.text_len == 0) {
+        return;
+    }
+    handle_chat(client_socket, room,
+                game_manager_get_player_number(room->game_manager, client_socket), record.text);
+}
+
+// on_frame handler: one complete client message
+static void
+handle_client_frame(void *ctx, int client_socket, const char *payload, size_t len)
+{
+    server_t *server = ctx;
+    room_t *room = room_registry_find_by_socket(server->rooms, client_socket);
+    if (!room || len == 0) {
+        // Empty frames only answer heartbeats
+        return;
+    }
+
+    if (get_socket_wire_version(client_socket) > 0) {
+        handle_client_record(client_socket, room, payload, len);
+    } else if (!negotiate_wire_protocol(client_socket, payload, len)) {
+        handle_client_message(client_socket, room, payload);
+    }
 }
 
 static void 
 print_usage(const char *program_name) 
 {
-    fprintf(stderr, "Usage: %s [port] [max_players]\n", program_name);
+    fprintf(stderr, "Usage: %s [-w workers] [-m metrics_port] [-i idle_sec] [-b backlog] [-j dir] [-s] [port] [max_players] [max_rooms]\n", program_name);
+    fprintf(stderr, "  -w workers: Event loop threads, each with its own SO_REUSEPORT listener (default: %d)\n", DEFAULT_WORKERS);
+    fprintf(stderr, "  -m metrics_port: Serve Prometheus metrics on 127.0.0.1:metrics_port (default: off)\n");
+    fprintf(stderr, "  -i idle_sec: Heartbeat clients silent this long, drop them after as long again, 0 to disable (default: %d)\n",
+            DEFAULT_IDLE_TIMEOUT_SEC);
+    fprintf(stderr, "  -b backlog: Listen queue length per listener (default: %d)\n", DEFAULT_BACKLOG);
+    fprintf(stderr, "  -j dir: Record each worker's rooms to a journal in dir, for werewolf_replay (default: off)\n");
+    fprintf(stderr, "  -s: Speed Werewolf, shorter phase timers (%d/%d/%d seconds of night/day/voting instead of %d/%d/%d)\n",
+            GAME_TIMING_SPEED.night_sec, GAME_TIMING_SPEED.day_sec, GAME_TIMING_SPEED.voting_sec,
+            GAME_TIMING_STANDARD.night_sec, GAME_TIMING_STANDARD.day_sec, GAME_TIMING_STANDARD.voting_sec);
     fprintf(stderr, "  port: Port number to listen on (default: %s)\n", DEFAULT_PORT);
-    fprintf(stderr, "  max_players: Maximum number of players (default: %d)\n", DEFAULT_MAX_PLAYERS);
-    fprintf(stderr, "  Note: max_players must be between 6 and 16\n");
+    fprintf(stderr, "  max_players: Players per room (default: %d)\n", DEFAULT_MAX_PLAYERS);
+    fprintf(stderr, "  max_rooms: Maximum concurrent rooms, 0 for unlimited (default: %d)\n", DEFAULT_MAX_ROOMS);
+    fprintf(stderr, "  Note: max_players must be between 6 and 16, max_rooms is split across workers\n");
 }
 
+// on_accept handler
 static void 
-handle_new_connection(int client_socket, game_manager_t game_manager, 
-                       client_fd_list_t **client_fd_list, int max_players) 
+handle_new_connection(void *ctx, int client_socket) 
 {
-    if (game_manager_get_player_count(game_manager) > max_players) {
-        log(WARN, "Maximum players reached, rejecting connection");
-        close(client_socket);
+    server_t *server = ctx;
+    room_t *room = room_registry_get_lobby(server->rooms);
+    if (!room) {
+        log(INFO, "No room available, rejecting connection");
+        metrics_inc(COUNTER_CONNECTIONS_REJECTED);
+        send_message(client_socket, CHANNEL_ANNOUNCEMENT, 
+                    "The server is full, come back later!", 0);
+        io_backend_close(server->io, client_socket);
         return;
     }
 
-    if (game_manager_get_phase(game_manager) != GAME_STATE_LOBBY) {
-        log(INFO, "Game is not in lobby phase, rejecting connection");
-        send_message(client_socket, CHANNEL_ANNOUNCEMENT, 
-                    "The game has already started, come back later!", 
-                        game_manager_get_player_number(game_manager, client_socket));
-        unsubscribe_from_channel(&announcement_channel, client_socket);
-        unsubscribe_from_channel(&server_channel, client_socket);
-        unsubscribe_from_channel(&chat_channel, client_socket);
-        unsubscribe_from_channel(&werewolf_channel, client_socket);
-        close(client_socket);
+    game_manager_t game_manager = room->game_manager;
+    int seat = game_manager_add_player(game_manager, client_socket);
+    if (seat < 0) {
+        log(ERROR, "Failed to add new client");
+        metrics_inc(COUNTER_CONNECTIONS_REJECTED);
+        io_backend_close(server->io, client_socket);
         return;
     }
 
-    if (game_manager_add_player(game_manager, client_socket) == 0) {
-        *client_fd_list = add_client_fd(*client_fd_list, client_socket);
-        log(INFO, "New client added to list, total clients: %d", 
-            game_manager_get_player_count(game_manager));
-        
-        subscribe_to_channel(&chat_channel, client_socket);
-        subscribe_to_channel(&announcement_channel, client_socket);
-        subscribe_to_channel(&server_channel, client_socket);
-        int player_count = game_manager_get_player_count(game_manager);
-        if (player_count == max_players) {
-            log(INFO, "Enough players to start game (%d players), starting game...", player_count);
-            game_manager_start_game(game_manager);
-            
-            // Get player sockets and roles for notification
-            int *player_sockets = game_manager_get_players_sockets(game_manager);
-            game_role_t *player_roles = malloc(sizeof(game_role_t) * player_count);
-
-            for (int i = 0; i < player_count; i++) {
-                player_roles[i] = game_manager_get_player_role(game_manager, player_sockets[i]);
-                if (player_roles[i] == ROLE_WEREWOLF) {
-                    subscribe_to_channel(&werewolf_channel, player_sockets[i]);
-                }
-            }
+    if (room_registry_bind_socket(server->rooms, client_socket, room) < 0 ||
+        io_backend_watch(server->io, client_socket) < 0) {
+        room_registry_unbind_socket(server->rooms, client_socket);
+        game_manager_remove_player(game_manager, client_socket);
+        io_backend_close(server->io, client_socket);
+        return;
+    }
 
-            // char formatted[BUFFER_SIZE];
-            // char *msg = "The game has started!";
-            // char *announcement = format_message(CHANNEL_ANNOUNCEMENT, 0, msg);
-            // strncpy(formatted, announcement, BUFFER_SIZE - 1);
-            // formatted[BUFFER_SIZE - 1] = '\0'; 
-            // forward_message(&announcement_channel, formatted);
-            int werewolf_count = game_manager_get_werewolf_count(game_manager);
-            for (int i = 0; i < player_count; i++) {
-                char role_message[BUFFER_SIZE];
-                const char *role_name = role_by_name(player_roles[i]);
-                snprintf(role_message, BUFFER_SIZE, "You are a %s!", role_name);
-                send_message(player_sockets[i], CHANNEL_ANNOUNCEMENT, role_message, game_manager_get_player_number(game_manager, player_sockets[i]));
-                
-                if (player_roles[i] == ROLE_WEREWOLF && werewolf_count-1 > 0) {
-                    char team_message[BUFFER_SIZE] = "Your werewolf teammates are: ";
-                    for (int j = 0; j < player_count; j++) {
-                        if (i != j && player_roles[j] == ROLE_WEREWOLF) {
-                            char temp[32];
-                            snprintf(temp, sizeof(temp), "Player %d, ", player_sockets[j]);
-                            strncat(team_message, temp, BUFFER_SIZE - strlen(team_message) - 1);
-                        }
-                    }
-                    strncat(team_message, "\n", BUFFER_SIZE - strlen(team_message) - 1);
-                    send_message(player_sockets[i], CHANNEL_ANNOUNCEMENT, team_message, game_manager_get_player_number(game_manager, player_sockets[i]));
-                }
-            }
-            
-            free(player_sockets);
-            free(player_roles);
+    metrics_inc(COUNTER_CONNECTIONS_ACCEPTED);
+    metrics_gauge_add(GAUGE_CONNECTIONS, 1);
+    log(INFO, "New client added to room %d, total clients: %d", room->id,
+        game_manager_get_player_count(game_manager));
+
+    subscribe_to_channel(&room->channels[CHANNEL_CHAT], seat);
+    subscribe_to_channel(&room->channels[CHANNEL_ANNOUNCEMENT], seat);
+    subscribe_to_channel(&room->channels[CHANNEL_SERVER], seat);
+
+    if (game_manager_get_player_count(game_manager) == server->max_players) {
+        // Started rooms keep running; the next connection opens a new lobby
+        room_registry_close_lobby(server->rooms, room);
+        game_flow_start(room);
+    }
+}
+
+static const io_handlers_t server_handlers = {
+    .on_accept = handle_new_connection,
+    .on_frame = handle_client_frame,
+    .on_close = disconnect_client,
+};
+
+// game_messanger delivers through the worker's backend
+static int
+backend_send(void *ctx, int socket_id, const void *data, size_t len)
+{
+    return io_backend_send(ctx, socket_id, data, len);
+}
+
+static int
+backend_broadcast(void *ctx, const int *socket_ids, int count, const void *data, size_t len)
+{
+    return io_backend_broadcast(ctx, socket_ids, count, data, len);
+}
+
+static const message_transport_t backend_transport = {
+    .send = backend_send,
+    .broadcast = backend_broadcast,
+};
+
+static int
+server_init(server_t *server, int id, const char *port, int max_players, int max_rooms,
+            int idle_timeout_sec, int backlog, bool reuse_port, const char *journal_dir)
+{
+    server->id = id;
+    server->max_players = max_players;
+    server->journal = NULL;
+    if (journal_dir) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/werewolf-%ld-%d.wwj", journal_dir, (long) time(NULL), id);
+        if (!(server->journal = journal_open(path))) {
+            return RET_ERROR;
         }
-    } else {
-        log(ERROR, "Failed to add new client");
-        close(client_socket);
+        log(INFO, "Worker %d journaling to %s", id, path);
+    }
+
+    server->timers = timer_wheel_create(timer_now_ms());
+    if (!server->timers) {
+        journal_close(server->journal);
+        return RET_ERROR;
+    }
+    server->rooms = room_registry_create(max_players, max_rooms, server->timers, server->journal);
+    if (!server->rooms) {
+        log(ERROR, "Failed to create room registry");
+        timer_wheel_destroy(server->timers);
+        journal_close(server->journal);
+        return RET_ERROR;
     }
+
+    server->server_socket = setup_tcp_server("0.0.0.0", port, backlog, reuse_port);
+    if (server->server_socket < 0) {
+        log(ERROR, "Failed to setup server");
+        room_registry_destroy(server->rooms);
+        timer_wheel_destroy(server->timers);
+        journal_close(server->journal);
+        return RET_ERROR;
+    }
+
+    server->io = io_backend_create(server->server_socket, &server_handlers, server,
+                                   server->timers, idle_timeout_sec);
+    if (!server->io) {
+        log(ERROR, "Failed to setup io backend");
+        room_registry_destroy(server->rooms);
+        timer_wheel_destroy(server->timers);
+        journal_close(server->journal);
+        close(server->server_socket);
+        return RET_ERROR;
+    }
+    return RET_SUCCESS;
 }
 
-static void 
-setup_fd_sets(int server_socket, client_fd_list_t *client_fd_list, 
-                         fd_set *read_fds, int *max_fd, game_manager_t game_manager) 
+static void
+server_cleanup(server_t *server)
+{
+    io_backend_destroy(server->io);
+    room_registry_destroy(server->rooms);
+    timer_wheel_destroy(server->timers);
+    // After the rooms, which record their closing
+    journal_close(server->journal);
+    close(server->server_socket);
+}
+
+// Logs syscalls per delivered message since the previous report
+static void
+report_io_stats(server_t *server)
 {
-    FD_ZERO(read_fds);
-    FD_SET(server_socket, read_fds);
-    *max_fd = server_socket;
-
-    client_fd_list_t *current = client_fd_list;
-    while (current) {
-        if (!is_socket_connected(current->fd)) {
-            log(INFO, "Client %d disconnected", current->fd);
-            close(current->fd);
-            game_manager_remove_player(game_manager, current->fd);
-            client_fd_list = remove_client_fd(client_fd_list, current->fd);
-            current = client_fd_list;
-            continue;
+    const io_stats_t *stats = io_backend_get_stats(server->io);
+    uint64_t sends = stats->sends - server->last_stats.sends;
+    uint64_t syscalls = stats->syscalls - server->last_stats.syscalls;
+    if (sends == 0) {
+        return;
+    }
+
+    log(INFO, "Worker %d io (%s): %lu syscalls, %lu accepts, %lu reads, %lu frames in, %lu sends, %.2f syscalls/send",
+        server->id, io_backend_name(server->io), (unsigned long) syscalls,
+        (unsigned long) (stats->accepts - server->last_stats.accepts),
+        (unsigned long) (stats->recvs - server->last_stats.recvs),
+        (unsigned long) (stats->frames - server->last_stats.frames),
+        (unsigned long) sends, (double) syscalls / sends);
+    server->last_stats = *stats;
+}
+
+// Only the workers leave these signals unblocked, so this runs on one of them
+// and its poll returns EINTR. Worker 0 (the main thread) waits for the others,
+// so a signal that landed elsewhere is passed on to wake it too.
+static void
+request_stop(int signo)
+{
+    stopping = 1;
+    if (!pthread_equal(pthread_self(), main_thread)) {
+        pthread_kill(main_thread, signo);
+    }
+}
+
+static int
+handle_stop_signals(void)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigemptyset(&action.sa_mask);
+    // No SA_RESTART: the poll must return to check the flag
+    if (sigaction(SIGTERM, &action, NULL) < 0 || sigaction(SIGINT, &action, NULL) < 0) {
+        log(ERROR, "Failed to handle SIGTERM/SIGINT: %s", strerror(errno));
+        return RET_ERROR;
+    }
+    return RET_SUCCESS;
+}
+
+static void
+set_stop_signals_blocked(bool blocked)
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    pthread_sigmask(blocked ? SIG_BLOCK : SIG_UNBLOCK, &set, NULL);
+}
+
+static void *
+server_run(void *arg)
+{
+    server_t *server = arg;
+    set_message_transport(&backend_transport, server->io);
+
+    log(INFO, "Worker %d running %s backend", server->id, io_backend_name(server->io));
+    uint64_t now = timer_now_ms();
+    uint64_t next_report = now + IO_STATS_INTERVAL_SEC * 1000;
+    while (!stopping) {
+        // Sleep until the earliest phase deadline or stats report, whichever
+        // comes first; output queued by timers is flushed by the next poll
+        int timeout = (int) (next_report > now ? next_report - now : 0);
+        int timer_timeout = timer_wheel_timeout_ms(server->timers, now);
+        if (timer_timeout >= 0 && timer_timeout < timeout) {
+            timeout = timer_timeout;
         }
-        FD_SET(current->fd, read_fds);
-        if (current->fd > *max_fd) {
-            *max_fd = current->fd;
+        io_backend_poll(server->io, timeout);
+
+        now = timer_now_ms();
+        timer_wheel_advance(server->timers, now);
+        if (now >= next_report) {
+            report_io_stats(server);
+            next_report = now + IO_STATS_INTERVAL_SEC * 1000;
         }
-        current = current->next;
     }
+    atomic_store(&server->stopped, true);
+    return NULL;
 }
 
 int 
-main(int argc, const char *argv[]) 
+main(int argc, char *argv[]) 
 {
     close(STDIN_FILENO);
     const char *port = DEFAULT_PORT;
     int max_players = DEFAULT_MAX_PLAYERS;
+    int max_rooms = DEFAULT_MAX_ROOMS;
+    int workers = DEFAULT_WORKERS;
+    const char *metrics_port = NULL;
+    int idle_timeout_sec = DEFAULT_IDLE_TIMEOUT_SEC;
+    int backlog = DEFAULT_BACKLOG;
+    const char *journal_dir = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:m:i:b:j:sh")) != -1) {
+        switch (opt) {
+            case 'w':
+                workers = atoi(optarg);
+                if (workers < 1 || workers > MAX_WORKERS) {
+                    fprintf(stderr, "Error: Invalid workers value. Must be between 1 and %d.\n", MAX_WORKERS);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'm':
+                metrics_port = optarg;
+                break;
+            case 'i':
+                idle_timeout_sec = atoi(optarg);
+                if (idle_timeout_sec < 0) {
+                    fprintf(stderr, "Error: Invalid idle_sec value. Must be 0 or greater.\n");
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'b':
+                backlog = atoi(optarg);
+                if (backlog < 1) {
+                    fprintf(stderr, "Error: Invalid backlog value. Must be 1 or greater.\n");
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'j':
+                journal_dir = optarg;
+                break;
+            case 's':
+                game_flow_set_timing(&GAME_TIMING_SPEED);
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
     if (argc > 1) {
         port = argv[1];
     }
@@ -237,63 +497,81 @@ main(int argc, const char *argv[])
         }
     }
 
-    game_manager_t game_manager = game_manager_create(max_players);
-    if (!game_manager) {
-        log(ERROR, "Failed to create game manager");
-        return 1;
+    if (argc > 3) {
+        max_rooms = atoi(argv[3]);
+        if (max_rooms < 0) {
+            fprintf(stderr, "Error: Invalid max_rooms value. Must be 0 or greater.\n");
+            print_usage(argv[0]);
+            return 1;
+        }
     }
 
-    int server_socket = setup_tcp_server("0.0.0.0", port, max_players);
-    if (server_socket < 0) {
-        log(ERROR, "Failed to setup server");
-        game_manager_destroy(game_manager);
+    // Before any thread starts, so they all inherit the blocked SIGUSR1 and,
+    // until the workers start, SIGTERM/SIGINT
+    main_thread = pthread_self();
+    set_stop_signals_blocked(true);
+    if (handle_stop_signals() < 0) {
         return 1;
     }
+    admin_dump_on_sigusr1();
+    logger_start();
+    // Fixed lines are rendered once and shared read-only by the workers
+    if (prerender_server_notices() < 0 || game_flow_prerender(max_players) < 0) {
+        log(WARN, "Formatting fixed messages per send instead");
+    }
 
-    log(INFO, "Server started successfully, waiting for connections...");
-    log(INFO, "Maximum players: %d", max_players);
-
-    client_fd_list_t *client_fd_list = NULL;
-    fd_set read_fds;
-    int max_fd = server_socket;
-
-    while (1) {
-        setup_fd_sets(server_socket, client_fd_list, &read_fds, &max_fd, game_manager);
-
-        int activity = select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-        if (activity < 0) {
-            log(ERROR, "select() failed: %s", strerror(errno));
-            continue;
-        }
+    server_t *servers = calloc(workers, sizeof(server_t));
+    if (!servers) {
+        log(ERROR, "Failed to allocate memory for workers");
+        return 1;
+    }
 
-        if (FD_ISSET(server_socket, &read_fds)) {
-            int client_socket = accept_tcp_connection(server_socket);
-            if (client_socket > 0) {
-                handle_new_connection(client_socket, game_manager, &client_fd_list, max_players);
+    int rooms_per_worker = max_rooms > 0 ? (max_rooms + workers - 1) / workers : 0;
+    for (int i = 0; i < workers; i++) {
+        if (server_init(&servers[i], i, port, max_players, rooms_per_worker, idle_timeout_sec,
+                        backlog, workers > 1, journal_dir) < 0) {
+            while (i-- > 0) {
+                server_cleanup(&servers[i]);
             }
+            free(servers);
+            return 1;
         }
+    }
 
-        client_fd_list_t *current = client_fd_list;
-        while (current) {
-            int client_socket = current->fd;
-            client_fd_list_t *next = current->next;  // Save next before potential removal
+    if (metrics_port && admin_server_start(metrics_port) < 0) {
+        log(WARN, "Continuing without the metrics endpoint");
+    }
 
-            if (FD_ISSET(client_socket, &read_fds)) {
-                handle_client_data(client_socket, game_manager, &client_fd_list);
-            }
-            current = next;
+    log(INFO, "Server started successfully, waiting for connections...");
+    log(INFO, "Players per room: %d, workers: %d", max_players, workers);
+
+    // Worker 0 runs on the main thread
+    set_stop_signals_blocked(false);
+    for (int i = 1; i < workers; i++) {
+        if (pthread_create(&servers[i].thread, NULL, server_run, &servers[i]) != 0) {
+            log(FATAL, "Failed to start worker %d", i);
         }
     }
-
-    // Cleanup
-    while (client_fd_list) {
-        client_fd_list_t *next = client_fd_list->next;
-        close(client_fd_list->fd);
-        free(client_fd_list);
-        client_fd_list = next;
+    server_run(&servers[0]);
+    log(INFO, "Shutting down");
+
+    // A wake-up that arrives just before a worker goes back to sleep is lost,
+    // so keep waking each one until it is out of its loop
+    struct timespec kick = { .tv_sec = 0, .tv_nsec = SHUTDOWN_KICK_NS };
+    for (int i = 1; i < workers; i++) {
+        while (!atomic_load(&servers[i].stopped)) {
+            pthread_kill(servers[i].thread, SIGTERM);
+            nanosleep(&kick, NULL);
+        }
+        pthread_join(servers[i].thread, NULL);
+    }
+    for (int i = 0; i < workers; i++) {
+        server_cleanup(&servers[i]);
     }
-    game_manager_destroy(game_manager);
-    close(server_socket);
+    free(servers);
+
+    // Everything recorded and logged so far reaches the disk
+    journal_stop();
+    logger_stop();
     return 0;
 }
-
@@ -0,0 +1,530 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "logger.h"
+#include "defs.h"
+#include "arena.h"
+#include "rng.h"
+#include "game_manager.h"
+#include "game_config.h"
+
+#define DEFAULT_GAMES 100000
+#define DEFAULT_MIN_PLAYERS 6
+#define DEFAULT_MAX_PLAYERS 16
+#define DEFAULT_SEED 1
+#define SIM_MAX_PLAYERS 16
+#define SIM_MAX_ROUNDS 64       // A game still running after this many nights counts as unfinished
+#define GAMES_PER_BLOCK 4096
+
+/*
+ * Headless games for checking GAME_CONFIGS. Every game runs on a real
+ * game_manager (role assignment, werewolf kills, lynch votes and the win
+ * check) with bots casting the votes, and no sockets anywhere.
+ *
+ * Work is split into blocks of GAMES_PER_BLOCK games of one player count,
+ * each with its own generator seeded from (seed, players, block), and
+ * threads take blocks in turn. The totals only depend on the seed, not on
+ * the thread count or which thread ran what.
+ *
+ * Game length is counted in nights: a game that ends on the first night's
+ * kill or the first lynch is one night long.
+ */
+
+typedef struct sim_game_t sim_game_t;
+
+// Bots of one kind. Strategies see the roles of every seat, and are trusted
+// to only use what the voter would know.
+typedef struct {
+    const char *name;
+    const char *description;
+    // Before anyone votes in a night or lynch vote; optional
+    void (*begin_phase)(sim_game_t *game, game_state_t phase);
+    // Seat voter votes for, or -1 to abstain
+    int (*pick)(sim_game_t *game, int voter, game_state_t phase);
+    // After a phase closed and its victim, if any, is out; optional
+    void (*end_phase)(sim_game_t *game, const game_phase_result_t *result);
+} bot_strategy_t;
+
+struct sim_game_t {
+    game_manager_t game_manager;
+    rng_t *rng;
+    int players;
+    game_role_t roles[SIM_MAX_PLAYERS];
+    bool alive[SIM_MAX_PLAYERS];
+    // Unordered living seats, for O(1) random picks; villagers are every
+    // non-werewolf
+    int alive_seats[SIM_MAX_PLAYERS];
+    int alive_count;
+    int alive_villagers[SIM_MAX_PLAYERS];
+    int villager_count;
+    int wolf_target;        // Seat the pack agreed on this phase, -1 when none
+    int seer;               // Seat of the seer, -1 when there is none
+    bool investigated[SIM_MAX_PLAYERS];
+    int seer_found;         // Werewolf the seer saw tonight, -1 when none
+    int exposed;            // Werewolf the seer has revealed to the village, -1 when none
+};
+
+typedef struct {
+    long games;
+    long wins[3];           // By game_team_t; TEAM_NONE is unfinished
+    long rounds[SIM_MAX_ROUNDS + 1];
+} sim_result_t;
+
+typedef struct {
+    int min_players;
+    int max_players;
+    long games;             // Per player count
+    uint64_t seed;
+    const bot_strategy_t *strategy;
+    int blocks_per_count;
+    int next_block;         // Taken with __atomic_fetch_add
+} sim_config_t;
+
+typedef struct {
+    sim_config_t *config;
+    sim_result_t results[SIM_MAX_PLAYERS + 1];
+    pthread_t thread;
+} sim_worker_t;
+
+static double
+now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Picks shared by the strategies
+ */
+
+// Random living seat other than voter (-1 for nobody) that is not a
+// werewolf if spare_wolves; -1 when there is none
+static int
+random_alive(sim_game_t *game, int voter, bool spare_wolves)
+{
+    const int *seats = spare_wolves ? game->alive_villagers : game->alive_seats;
+    int count = spare_wolves ? game->villager_count : game->alive_count;
+    // Draw from all but the last entry, which stands in for the voter
+    bool listed = voter >= 0 && game->alive[voter] &&
+                  !(spare_wolves && game->roles[voter] == ROLE_WEREWOLF);
+    if (listed) {
+        count--;
+    }
+    if (count <= 0) {
+        return -1;
+    }
+    int seat = seats[rng_below(game->rng, count)];
+    return listed && seat == voter ? seats[count] : seat;
+}
+
+static int
+villager_pick(sim_game_t *game, int voter)
+{
+    if (game->exposed >= 0 && game->alive[game->exposed] && game->exposed != voter) {
+        return game->exposed;
+    }
+    return random_alive(game, voter, false);
+}
+
+/*
+ * random: everyone votes for a random living player; werewolves only
+ * spare each other at night, where the game forbids it anyway
+ */
+
+static int
+random_pick(sim_game_t *game, int voter, game_state_t phase)
+{
+    return random_alive(game, voter, phase == GAME_STATE_NIGHT);
+}
+
+/*
+ * pack: the werewolves agree on one villager per vote, night and day; the
+ * village votes at random
+ */
+
+static void
+pack_begin_phase(sim_game_t *game, game_state_t phase)
+{
+    game->wolf_target = random_alive(game, -1, true);
+}
+
+static int
+pack_pick(sim_game_t *game, int voter, game_state_t phase)
+{
+    if (game->roles[voter] == ROLE_WEREWOLF) {
+        return game->wolf_target;
+    }
+    return villager_pick(game, voter);
+}
+
+/*
+ * seer: pack werewolves, and a seer who checks one unchecked player a night
+ * and, on finding a werewolf, reveals it at dawn if still alive. The village
+ * then lynches that werewolf and the pack goes for the seer.
+ */
+
+static void
+seer_begin_phase(sim_game_t *game, game_state_t phase)
+{
+    pack_begin_phase(game, phase);
+    if (phase != GAME_STATE_NIGHT || game->seer < 0 || !game->alive[game->seer]) {
+        return;
+    }
+
+    if (game->exposed >= 0) {
+        game->wolf_target = game->seer;
+        return;
+    }
+
+    int candidates[SIM_MAX_PLAYERS];
+    int count = 0;
+    for (int i = 0; i < game->alive_count; i++) {
+        int seat = game->alive_seats[i];
+        if (seat != game->seer && !game->investigated[seat]) {
+            candidates[count++] = seat;
+        }
+    }
+    if (count > 0) {
+        int seat = candidates[rng_below(game->rng, count)];
+        game->investigated[seat] = true;
+        if (game->roles[seat] == ROLE_WEREWOLF) {
+            game->seer_found = seat;
+        }
+    }
+}
+
+static void
+seer_end_phase(sim_game_t *game, const game_phase_result_t *result)
+{
+    if (result->closed_phase == GAME_STATE_NIGHT && game->seer_found >= 0) {
+        if (game->alive[game->seer]) {
+            game->exposed = game->seer_found;
+        }
+        game->seer_found = -1;
+    }
+}
+
+static const bot_strategy_t strategies[] = {
+    {"random", "every vote goes to a random living player", NULL, random_pick, NULL},
+    {"pack", "werewolves agree on one target, the village votes at random", pack_begin_phase, pack_pick, NULL},
+    {"seer", "pack werewolves; the seer checks a player a night and reveals werewolves",
+     seer_begin_phase, pack_pick, seer_end_phase},
+};
+
+#define STRATEGY_COUNT (sizeof(strategies) / sizeof(strategies[0]))
+
+static const bot_strategy_t *
+find_strategy(const char *name)
+{
+    for (size_t i = 0; i < STRATEGY_COUNT; i++) {
+        if (strcmp(strategies[i].name, name) == 0) {
+            return &strategies[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Engine
+ */
+
+static void
+remove_seat(int *seats, int *count, int seat)
+{
+    for (int i = 0; i < *count; i++) {
+        if (seats[i] == seat) {
+            seats[i] = seats[--*count];
+            return;
+        }
+    }
+}
+
+static void
+remove_alive(sim_game_t *game, int seat)
+{
+    game->alive[seat] = false;
+    remove_seat(game->alive_seats, &game->alive_count, seat);
+    if (game->roles[seat] != ROLE_WEREWOLF) {
+        remove_seat(game->alive_villagers, &game->villager_count, seat);
+    }
+}
+
+static void
+cast_votes(sim_game_t *game, const bot_strategy_t *strategy, game_state_t phase)
+{
+    if (strategy->begin_phase) {
+        strategy->begin_phase(game, phase);
+    }
+    for (int i = 0; i < game->alive_count; i++) {
+        int voter = game->alive_seats[i];
+        if (phase == GAME_STATE_NIGHT && game->roles[voter] != ROLE_WEREWOLF) {
+            continue;
+        }
+        int target = strategy->pick(game, voter, phase);
+        if (target >= 0) {
+            // Seats were added in order, so the player number is seat + 1
+            game_manager_cast_vote(game->game_manager, voter, target + 1);
+        }
+    }
+}
+
+// Plays one game in arena; returns the winner and sets *rounds
+static game_team_t
+play_game(arena_t arena, rng_t *rng, int players, const bot_strategy_t *strategy, int *rounds)
+{
+    size_t mark = arena_mark(arena);
+    sim_game_t game = {
+        .rng = rng,
+        .players = players,
+        .wolf_target = -1,
+        .seer = -1,
+        .seer_found = -1,
+        .exposed = -1,
+    };
+    game.game_manager = game_manager_create(arena, players);
+    if (!game.game_manager) {
+        log(FATAL, "Failed to create a game of %d players", players);
+    }
+    game_manager_seed(game.game_manager, rng_next(rng));
+
+    // Socket ids are the seats
+    for (int seat = 0; seat < players; seat++) {
+        game_manager_add_player(game.game_manager, seat);
+    }
+    game_manager_start_game(game.game_manager);
+    for (int seat = 0; seat < players; seat++) {
+        game.roles[seat] = game_manager_get_player_role(game.game_manager, seat);
+        game.alive[seat] = true;
+        game.alive_seats[seat] = seat;
+        if (game.roles[seat] != ROLE_WEREWOLF) {
+            game.alive_villagers[game.villager_count++] = seat;
+        }
+        if (game.roles[seat] == ROLE_SEER) {
+            game.seer = seat;
+        }
+    }
+    game.alive_count = players;
+
+    game_team_t winner = TEAM_NONE;
+    *rounds = 0;
+    game_state_t phase;
+    while ((phase = game_manager_get_phase(game.game_manager)) != GAME_STATE_ENDED) {
+        if (phase == GAME_STATE_NIGHT) {
+            if (*rounds == SIM_MAX_ROUNDS) {
+                game_manager_end_game(game.game_manager);
+                break;
+            }
+            (*rounds)++;
+        }
+        if (phase == GAME_STATE_NIGHT || phase == GAME_STATE_VOTING) {
+            cast_votes(&game, strategy, phase);
+        }
+
+        game_phase_result_t result;
+        game_manager_advance_phase(game.game_manager, &result);
+        if (result.eliminated_number > 0) {
+            remove_alive(&game, result.eliminated_number - 1);
+        }
+        if (strategy->end_phase) {
+            strategy->end_phase(&game, &result);
+        }
+        winner = result.winner;
+    }
+
+    game_manager_destroy(game.game_manager);
+    arena_rewind(arena, mark);
+    return winner;
+}
+
+static void *
+sim_run(void *arg)
+{
+    sim_worker_t *worker = arg;
+    sim_config_t *config = worker->config;
+    arena_t arena = arena_create(game_manager_arena_size(SIM_MAX_PLAYERS));
+    if (!arena) {
+        log(FATAL, "Failed to allocate the game arena");
+    }
+
+    int counts = config->max_players - config->min_players + 1;
+    int total_blocks = counts * config->blocks_per_count;
+    int block;
+    while ((block = __atomic_fetch_add(&config->next_block, 1, __ATOMIC_RELAXED)) < total_blocks) {
+        int players = config->min_players + block / config->blocks_per_count;
+        int index = block % config->blocks_per_count;
+        long first = (long) index * GAMES_PER_BLOCK;
+        long games = config->games - first < GAMES_PER_BLOCK ? config->games - first : GAMES_PER_BLOCK;
+
+        rng_t rng;
+        rng_seed(&rng, config->seed ^ ((uint64_t) players << 56) ^ ((uint64_t) index * 0x9e3779b97f4a7c15ull));
+        sim_result_t *result = &worker->results[players];
+        for (long i = 0; i < games; i++) {
+            int rounds;
+            game_team_t winner = play_game(arena, &rng, players, config->strategy, &rounds);
+            result->games++;
+            result->wins[winner]++;
+            result->rounds[rounds]++;
+        }
+    }
+
+    arena_destroy(arena);
+    return NULL;
+}
+
+// Smallest round count covering fraction of the games
+static int
+rounds_percentile(const sim_result_t *result, double fraction)
+{
+    long target = (long) (result->games * fraction);
+    long seen = 0;
+    for (int r = 0; r <= SIM_MAX_ROUNDS; r++) {
+        seen += result->rounds[r];
+        if (seen > target) {
+            return r;
+        }
+    }
+    return SIM_MAX_ROUNDS;
+}
+
+static void
+print_result(int players, const sim_result_t *result, bool histogram)
+{
+    const game_config_t *config = get_game_config(players);
+    double games = result->games > 0 ? result->games : 1;
+    double total_rounds = 0;
+    int max_rounds = 0;
+    for (int r = 0; r <= SIM_MAX_ROUNDS; r++) {
+        total_rounds += (double) r * result->rounds[r];
+        if (result->rounds[r] > 0) {
+            max_rounds = r;
+        }
+    }
+
+    printf("players=%d werewolves=%d special_roles=%d games=%ld village_win=%.4f werewolf_win=%.4f "
+           "unfinished=%.4f nights_mean=%.2f nights_p50=%d nights_p90=%d nights_p99=%d nights_max=%d\n",
+           players, config ? config->num_werewolves : 0, config ? config->num_special_roles : 0,
+           result->games, result->wins[TEAM_VILLAGE] / games, result->wins[TEAM_WEREWOLVES] / games,
+           result->wins[TEAM_NONE] / games, total_rounds / games, rounds_percentile(result, 0.5),
+           rounds_percentile(result, 0.9), rounds_percentile(result, 0.99), max_rounds);
+
+    if (histogram) {
+        for (int r = 1; r <= max_rounds; r++) {
+            printf("  players=%d nights=%d games=%ld share=%.4f\n", players, r, result->rounds[r],
+                   result->rounds[r] / games);
+        }
+    }
+}
+
+static void
+print_usage(const char *program_name)
+{
+    fprintf(stderr, "Usage: %s [-n games] [-t threads] [-p players|min-max] [-s strategy] [-S seed] [-H]\n",
+            program_name);
+    fprintf(stderr, "  -n games: Games per player count (default: %d)\n", DEFAULT_GAMES);
+    fprintf(stderr, "  -t threads: Simulation threads (default: online cores)\n");
+    fprintf(stderr, "  -p players: Player count or range to simulate (default: %d-%d)\n",
+            DEFAULT_MIN_PLAYERS, DEFAULT_MAX_PLAYERS);
+    fprintf(stderr, "  -s strategy: Bots to play with (default: %s)\n", strategies[STRATEGY_COUNT - 1].name);
+    for (size_t i = 0; i < STRATEGY_COUNT; i++) {
+        fprintf(stderr, "      %s: %s\n", strategies[i].name, strategies[i].description);
+    }
+    fprintf(stderr, "  -S seed: Base seed; the same seed gives the same results (default: %d)\n", DEFAULT_SEED);
+    fprintf(stderr, "  -H: Also print the distribution of game lengths\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = online > 0 ? (int) online : 1;
+    bool histogram = false;
+    sim_config_t config = {
+        .min_players = DEFAULT_MIN_PLAYERS,
+        .max_players = DEFAULT_MAX_PLAYERS,
+        .games = DEFAULT_GAMES,
+        .seed = DEFAULT_SEED,
+        .strategy = &strategies[STRATEGY_COUNT - 1],
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:p:s:S:Hh")) != -1) {
+        switch (opt) {
+            case 'n': config.games = atol(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'p':
+                if (sscanf(optarg, "%d-%d", &config.min_players, &config.max_players) == 1) {
+                    config.max_players = config.min_players;
+                }
+                break;
+            case 's':
+                config.strategy = find_strategy(optarg);
+                if (!config.strategy) {
+                    fprintf(stderr, "Error: Unknown strategy %s.\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'S': config.seed = strtoull(optarg, NULL, 0); break;
+            case 'H': histogram = true; break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (config.games < 1 || threads < 1 || config.min_players < DEFAULT_MIN_PLAYERS ||
+        config.max_players > SIM_MAX_PLAYERS || config.min_players > config.max_players) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    set_log_level(WARN);
+    config.blocks_per_count = (int) ((config.games + GAMES_PER_BLOCK - 1) / GAMES_PER_BLOCK);
+
+    sim_worker_t *workers = calloc(threads, sizeof(sim_worker_t));
+    if (!workers) {
+        log(FATAL, "Failed to allocate workers");
+    }
+
+    double start = now_sec();
+    for (int i = 0; i < threads; i++) {
+        workers[i].config = &config;
+        if (pthread_create(&workers[i].thread, NULL, sim_run, &workers[i]) != 0) {
+            log(FATAL, "Failed to start thread %d", i);
+        }
+    }
+
+    sim_result_t results[SIM_MAX_PLAYERS + 1];
+    memset(results, 0, sizeof(results));
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        for (int p = config.min_players; p <= config.max_players; p++) {
+            const sim_result_t *from = &workers[i].results[p];
+            results[p].games += from->games;
+            for (int w = 0; w < 3; w++) {
+                results[p].wins[w] += from->wins[w];
+            }
+            for (int r = 0; r <= SIM_MAX_ROUNDS; r++) {
+                results[p].rounds[r] += from->rounds[r];
+            }
+        }
+    }
+    double elapsed = now_sec() - start;
+
+    long total = config.games * (config.max_players - config.min_players + 1);
+    printf("strategy=%s seed=%llu threads=%d games=%ld seconds=%.2f games_per_sec=%.0f "
+           "games_per_sec_per_thread=%.0f\n",
+           config.strategy->name, (unsigned long long) config.seed, threads, total, elapsed,
+           total / elapsed, total / elapsed / threads);
+    for (int p = config.min_players; p <= config.max_players; p++) {
+        print_result(p, &results[p], histogram);
+    }
+
+    free(workers);
+    return 0;
+}
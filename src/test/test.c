@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "logger.h"
+#include "arena.h"
+#include "game_manager.h"
+#include "game_messanger.h"
+#include "command_handler.h"
+#include "room_registry.h"
+#include "timer_wheel.h"
+
+#define SOCKET_BASE 1000    // Fake socket ids for rooms that never send
+#define CAPTURE_SOCKETS 16
+#define CAPTURE_SIZE 4096
+
+/*
+ * Regression checks for behaviour the servers cannot show on their own.
+ * Each case returns true when it passes and explains itself on stderr when
+ * it does not; the program exits 1 if any case failed.
+ */
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "  %s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return false; \
+        } \
+    } while (0)
+
+typedef struct {
+    const char *name;
+    bool (*run)(void);
+} test_case_t;
+
+static void
+sleep_ms(int ms)
+{
+    struct timespec ts = {ms / 1000, (long) (ms % 1000) * 1000000};
+    nanosleep(&ts, NULL);
+}
+
+static void
+note_fired(void *arg)
+{
+    *(uint64_t *) arg = timer_now_ms();
+}
+
+// A handler that arms a timer after a long poll, before the loop advances the
+// wheel, must still get the whole delay
+static bool
+test_timer_after_idle_poll(void)
+{
+    const uint64_t idle_ms = 300;
+    const uint64_t delay_ms = 200;
+
+    timer_wheel_t wheel = timer_wheel_create(timer_now_ms());
+    CHECK(wheel != NULL);
+    timer_wheel_advance(wheel, timer_now_ms());
+
+    sleep_ms(idle_ms);
+    uint64_t fired_ms = 0;
+    wheel_timer_t timer;
+    timer_init(&timer, note_fired, &fired_ms);
+    uint64_t scheduled_ms = timer_now_ms();
+    timer_wheel_schedule(wheel, &timer, delay_ms);
+
+    while (fired_ms == 0 && timer_now_ms() - scheduled_ms < delay_ms * 4) {
+        int timeout = timer_wheel_timeout_ms(wheel, timer_now_ms());
+        sleep_ms(timeout > 0 && timeout < 10 ? timeout : 10);
+        timer_wheel_advance(wheel, timer_now_ms());
+    }
+    timer_wheel_destroy(wheel);
+
+    CHECK(fired_ms != 0);
+    CHECK(fired_ms - scheduled_ms >= delay_ms);
+    return true;
+}
+
+// Everyone has voted, then a player two of them voted for leaves: those two
+// must vote again before the day vote can close
+static bool
+test_votes_for_leaver_withdrawn(void)
+{
+    const int players = 8;
+    arena_t arena = arena_create(game_manager_arena_size(players));
+    CHECK(arena != NULL);
+    game_manager_t game_manager = game_manager_create(arena, players);
+    CHECK(game_manager != NULL);
+    for (int i = 0; i < players; i++) {
+        CHECK(game_manager_add_player(game_manager, SOCKET_BASE + i) >= 0);
+    }
+
+    game_phase_result_t result = {.winner = TEAM_NONE};
+    CHECK(game_manager_start_game(game_manager) == 0);
+    while (game_manager_get_phase(game_manager) != GAME_STATE_VOTING) {
+        CHECK(game_manager_advance_phase(game_manager, &result) == 0);
+        CHECK(result.winner == TEAM_NONE);
+    }
+
+    // Players 1 and 2 vote for the leaver, everyone else for player 3, who
+    // votes for player 4
+    int leaver = SOCKET_BASE, favourite = SOCKET_BASE + 3;
+    int leaver_number = game_manager_get_player_number(game_manager, leaver);
+    int favourite_number = game_manager_get_player_number(game_manager, favourite);
+    for (int i = 0; i < players; i++) {
+        int socket_id = SOCKET_BASE + i;
+        int target = i == 1 || i == 2 ? leaver_number : favourite_number;
+        if (socket_id == favourite) {
+            target = game_manager_get_player_number(game_manager, SOCKET_BASE + 4);
+        }
+        CHECK(game_manager_cast_vote(game_manager, socket_id, target) == VOTE_ACCEPTED);
+    }
+    CHECK(game_manager_votes_complete(game_manager));
+
+    CHECK(game_manager_remove_player(game_manager, leaver) == 0);
+    CHECK(game_manager_get_votes_for(game_manager, leaver_number) == 0);
+    CHECK(!game_manager_votes_complete(game_manager));
+
+    CHECK(game_manager_cast_vote(game_manager, SOCKET_BASE + 1, favourite_number) == VOTE_ACCEPTED);
+    CHECK(!game_manager_votes_complete(game_manager));
+    CHECK(game_manager_cast_vote(game_manager, SOCKET_BASE + 2, favourite_number) == VOTE_ACCEPTED);
+    CHECK(game_manager_votes_complete(game_manager));
+    CHECK(game_manager_get_votes_for(game_manager, favourite_number) == players - 2);
+
+    game_manager_destroy(game_manager);
+    arena_destroy(arena);
+    return true;
+}
+
+/*
+ * Message capture: a transport that appends what each fake socket is sent
+ * to its own buffer instead of writing it anywhere
+ */
+
+static char captured[CAPTURE_SOCKETS][CAPTURE_SIZE];
+
+static int
+capture_send(void *ctx, int socket_id, const void *data, size_t len)
+{
+    int index = socket_id - SOCKET_BASE;
+    if (index < 0 || index >= CAPTURE_SOCKETS) {
+        return -1;
+    }
+    size_t used = strlen(captured[index]);
+    if (len >= CAPTURE_SIZE - used) {
+        len = CAPTURE_SIZE - used - 1;
+    }
+    memcpy(captured[index] + used, data, len);
+    captured[index][used + len] = '\0';
+    return (int) len;
+}
+
+static int
+capture_broadcast(void *ctx, const int *socket_ids, int count, const void *data, size_t len)
+{
+    for (int i = 0; i < count; i++) {
+        capture_send(ctx, socket_ids[i], data, len);
+    }
+    return count;
+}
+
+static const message_transport_t capture_transport = {
+    .send = capture_send,
+    .broadcast = capture_broadcast,
+};
+
+static void
+capture_clear(void)
+{
+    memset(captured, 0, sizeof(captured));
+}
+
+static bool
+was_sent(int socket_id, const char *text)
+{
+    return strstr(captured[socket_id - SOCKET_BASE], text) != NULL;
+}
+
+// The socket of the first living player for whom is_werewolf holds
+static int
+find_player(game_manager_t game_manager, int players, bool is_werewolf)
+{
+    for (int i = 0; i < players; i++) {
+        int socket_id = SOCKET_BASE + i;
+        if (game_manager_is_player_alive(game_manager, socket_id) &&
+            game_manager_is_player_werewolf(game_manager, socket_id) == is_werewolf) {
+            return socket_id;
+        }
+    }
+    return -1;
+}
+
+// Whispers follow the chat rules: the dead cannot talk and night is silent.
+// The dead cannot vote either
+static bool
+test_whisper_dead_and_night(void)
+{
+    const int players = 8;
+    timer_wheel_t timers = timer_wheel_create(timer_now_ms());
+    CHECK(timers != NULL);
+    room_registry_t rooms = room_registry_create(players, 0, timers, NULL);
+    CHECK(rooms != NULL);
+    room_t *room = room_registry_get_lobby(rooms);
+    CHECK(room != NULL);
+    game_manager_t game_manager = room->game_manager;
+    for (int i = 0; i < players; i++) {
+        CHECK(game_manager_add_player(game_manager, SOCKET_BASE + i) >= 0);
+    }
+    set_message_transport(&capture_transport, NULL);
+
+    // Day one: the village lynches a villager
+    game_phase_result_t result = {.winner = TEAM_NONE};
+    CHECK(game_manager_start_game(game_manager) == 0);
+    while (game_manager_get_phase(game_manager) != GAME_STATE_VOTING) {
+        CHECK(game_manager_advance_phase(game_manager, &result) == 0);
+    }
+    int dead = find_player(game_manager, players, false);
+    CHECK(dead >= 0);
+    int dead_number = game_manager_get_player_number(game_manager, dead);
+    for (int i = 0; i < players; i++) {
+        int socket_id = SOCKET_BASE + i;
+        int target = socket_id == dead ? dead_number % players + 1 : dead_number;
+        CHECK(game_manager_cast_vote(game_manager, socket_id, target) == VOTE_ACCEPTED);
+    }
+    CHECK(game_manager_advance_phase(game_manager, &result) == 0);
+    CHECK(result.eliminated_socket == dead);
+    CHECK(game_manager_get_phase(game_manager) == GAME_STATE_NIGHT);
+
+    int wolf = find_player(game_manager, players, true);
+    int villager = find_player(game_manager, players, false);
+    CHECK(wolf >= 0 && villager >= 0);
+    int villager_number = game_manager_get_player_number(game_manager, villager);
+    char command[64];
+
+    // Night: nobody whispers, the dead least of all
+    capture_clear();
+    snprintf(command, sizeof(command), "/whisper %d psst", villager_number);
+    CHECK(handle_if_command(command, dead, room) == 1);
+    CHECK(was_sent(dead, "The dead cannot talk."));
+    CHECK(handle_if_command(command, wolf, room) == 1);
+    CHECK(was_sent(wolf, "It is night time"));
+    CHECK(!was_sent(villager, "psst"));
+
+    // Day: the living whisper again, the dead still cannot
+    CHECK(game_manager_advance_phase(game_manager, &result) == 0);
+    CHECK(game_manager_get_phase(game_manager) == GAME_STATE_DAY);
+    capture_clear();
+    CHECK(handle_if_command(command, dead, room) == 1);
+    CHECK(was_sent(dead, "The dead cannot talk."));
+    CHECK(!was_sent(villager, "psst"));
+    CHECK(handle_if_command(command, wolf, room) == 1);
+    CHECK(was_sent(villager, "psst"));
+
+    // Nor do the dead vote, by day as by night
+    snprintf(command, sizeof(command), "/vote %d", villager_number);
+    CHECK(handle_if_command(command, dead, room) == 1);
+    CHECK(was_sent(dead, "Dead players cannot vote."));
+
+    set_message_transport(NULL, NULL);
+    room_registry_destroy(rooms);
+    timer_wheel_destroy(timers);
+    return true;
+}
+
+static const test_case_t test_cases[] = {
+    {"timer_wheel/schedule_after_idle_poll", test_timer_after_idle_poll},
+    {"game_manager/votes_for_leaver_withdrawn", test_votes_for_leaver_withdrawn},
+    {"command_handler/whisper_dead_and_night", test_whisper_dead_and_night},
+};
+
+#define TEST_CASE_COUNT ((int) (sizeof(test_cases) / sizeof(test_cases[0])))
+
+int
+main(int argc, char *argv[])
+{
+    const char *filter = argc > 1 ? argv[1] : NULL;
+
+    // The code under test logs at INFO; keep the report readable
+    set_log_level(WARN);
+
+    int failed = 0;
+    for (int i = 0; i < TEST_CASE_COUNT; i++) {
+        if (filter && !strstr(test_cases[i].name, filter)) {
+            continue;
+        }
+        bool passed = test_cases[i].run();
+        printf("%-50s %s\n", test_cases[i].name, passed ? "ok" : "FAIL");
+        failed += !passed;
+    }
+    return failed ? 1 : 0;
+}
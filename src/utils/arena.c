@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "arena.h"
+
+typedef struct arena_cdt {
+    size_t capacity;
+    size_t used;
+    _Alignas(ARENA_ALIGNMENT) char data[];
+} arena_cdt;
+
+size_t
+arena_footprint(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+}
+
+arena_t
+arena_create(size_t capacity)
+{
+    capacity = arena_footprint(capacity);
+    arena_cdt *arena = malloc(sizeof(arena_cdt) + capacity);
+    if (!arena) {
+        log(ERROR, "Failed to allocate %zu byte arena", capacity);
+        return NULL;
+    }
+    arena->capacity = capacity;
+    arena->used = 0;
+    return arena;
+}
+
+void
+arena_destroy(arena_t arena)
+{
+    free(arena);
+}
+
+void *
+arena_alloc(arena_t arena, size_t size)
+{
+    size_t footprint = arena_footprint(size);
+    if (!arena || footprint > arena->capacity - arena->used) {
+        log(ERROR, "Arena out of space for %zu bytes", size);
+        return NULL;
+    }
+    void *block = arena->data + arena->used;
+    arena->used += footprint;
+    // Rewound scratch may have left data behind
+    memset(block, 0, size);
+    return block;
+}
+
+size_t
+arena_mark(arena_t arena)
+{
+    return arena->used;
+}
+
+void
+arena_rewind(arena_t arena, size_t mark)
+{
+    if (mark <= arena->used) {
+        arena->used = mark;
+    }
+}
+
+size_t
+arena_used(arena_t arena)
+{
+    return arena ? arena->used : 0;
+}
+
+size_t
+arena_capacity(arena_t arena)
+{
+    return arena ? arena->capacity : 0;
+}
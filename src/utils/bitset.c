@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "defs.h"
+#include "bitset.h"
+
+#define WORD_BITS 64
+
+static int
+grow(bitset_t *set, int word_count)
+{
+    if (word_count <= set->word_count) {
+        return RET_SUCCESS;
+    }
+    if (set->fixed) {
+        log(ERROR, "Bitset of %d words cannot grow to %d", set->word_count, word_count);
+        return RET_ERROR;
+    }
+
+    uint64_t *words = realloc(set->words, sizeof(uint64_t) * word_count);
+    if (!words) {
+        log(ERROR, "Failed to grow bitset to %d words", word_count);
+        return RET_ERROR;
+    }
+    memset(words + set->word_count, 0, sizeof(uint64_t) * (word_count - set->word_count));
+    set->words = words;
+    set->word_count = word_count;
+    return RET_SUCCESS;
+}
+
+int
+bitset_reserve(bitset_t *set, int bits)
+{
+    return grow(set, (bits + WORD_BITS - 1) / WORD_BITS);
+}
+
+void
+bitset_init_fixed(bitset_t *set, uint64_t *words, int bits)
+{
+    set->word_count = BITSET_WORDS(bits);
+    set->words = words;
+    set->fixed = true;
+    memset(words, 0, sizeof(uint64_t) * set->word_count);
+}
+
+void
+bitset_free(bitset_t *set)
+{
+    if (!set->fixed) {
+        free(set->words);
+    }
+    set->words = NULL;
+    set->word_count = 0;
+}
+
+int
+bitset_set(bitset_t *set, int bit)
+{
+    if (bit < 0 || grow(set, bit / WORD_BITS + 1) < 0) {
+        return RET_ERROR;
+    }
+    set->words[bit / WORD_BITS] |= 1ULL << (bit % WORD_BITS);
+    return RET_SUCCESS;
+}
+
+void
+bitset_clear(bitset_t *set, int bit)
+{
+    if (bit >= 0 && bit / WORD_BITS < set->word_count) {
+        set->words[bit / WORD_BITS] &= ~(1ULL << (bit % WORD_BITS));
+    }
+}
+
+bool
+bitset_test(const bitset_t *set, int bit)
+{
+    return bit >= 0 && bit / WORD_BITS < set->word_count &&
+           (set->words[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+}
+
+void
+bitset_clear_all(bitset_t *set)
+{
+    if (set->words) {
+        memset(set->words, 0, sizeof(uint64_t) * set->word_count);
+    }
+}
+
+int
+bitset_count(const bitset_t *set)
+{
+    int count = 0;
+    for (int i = 0; i < set->word_count; i++) {
+        count += __builtin_popcountll(set->words[i]);
+    }
+    return count;
+}
+
+int
+bitset_next(const bitset_t *set, int from)
+{
+    if (from < 0) {
+        from = 0;
+    }
+
+    int index = from / WORD_BITS;
+    if (index >= set->word_count) {
+        return -1;
+    }
+
+    uint64_t word = set->words[index] & (~0ULL << (from % WORD_BITS));
+    while (1) {
+        if (word) {
+            return index * WORD_BITS + __builtin_ctzll(word);
+        }
+        if (++index >= set->word_count) {
+            return -1;
+        }
+        word = set->words[index];
+    }
+}
+
+// Words past the end of a set read as zero
+static inline uint64_t
+word_at(const bitset_t *set, int index)
+{
+    return index < set->word_count ? set->words[index] : 0;
+}
+
+int
+bitset_and(bitset_t *dst, const bitset_t *a, const bitset_t *b)
+{
+    int count = a->word_count > b->word_count ? a->word_count : b->word_count;
+    if (grow(dst, count) < 0) {
+        return RET_ERROR;
+    }
+    for (int i = 0; i < dst->word_count; i++) {
+        dst->words[i] = word_at(a, i) & word_at(b, i);
+    }
+    return RET_SUCCESS;
+}
+
+int
+bitset_or(bitset_t *dst, const bitset_t *a, const bitset_t *b)
+{
+    int count = a->word_count > b->word_count ? a->word_count : b->word_count;
+    if (grow(dst, count) < 0) {
+        return RET_ERROR;
+    }
+    for (int i = 0; i < dst->word_count; i++) {
+        dst->words[i] = word_at(a, i) | word_at(b, i);
+    }
+    return RET_SUCCESS;
+}
+
+int
+bitset_and_not(bitset_t *dst, const bitset_t *a, const bitset_t *b)
+{
+    if (grow(dst, a->word_count) < 0) {
+        return RET_ERROR;
+    }
+    for (int i = 0; i < dst->word_count; i++) {
+        dst->words[i] = word_at(a, i) & ~word_at(b, i);
+    }
+    return RET_SUCCESS;
+}
@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "logger.h"
+#include "defs.h"
+#include "event_loop.h"
+
+#ifdef WEREWOLF_USE_SELECT
+
+#include <sys/select.h>
+
+typedef struct event_loop_cdt {
+    fd_set read_set;
+    fd_set write_set;
+    int max_fd;
+} event_loop_cdt;
+
+event_loop_t
+event_loop_create(void)
+{
+    event_loop_cdt *loop = malloc(sizeof(event_loop_cdt));
+    if (!loop) {
+        log(ERROR, "Failed to allocate memory for event loop");
+        return NULL;
+    }
+    FD_ZERO(&loop->read_set);
+    FD_ZERO(&loop->write_set);
+    loop->max_fd = -1;
+    return loop;
+}
+
+void
+event_loop_destroy(event_loop_t loop)
+{
+    free(loop);
+}
+
+int
+event_loop_add(event_loop_t loop, int fd, uint32_t events)
+{
+    if (!loop || fd < 0 || fd >= FD_SETSIZE) {
+        log(ERROR, "Cannot watch fd %d with select() (FD_SETSIZE is %d)", fd, FD_SETSIZE);
+        return RET_ERROR;
+    }
+
+    if (events & EVENT_READ) {
+        FD_SET(fd, &loop->read_set);
+    }
+    if (events & EVENT_WRITE) {
+        FD_SET(fd, &loop->write_set);
+    }
+    if (fd > loop->max_fd) {
+        loop->max_fd = fd;
+    }
+    return RET_SUCCESS;
+}
+
+int
+event_loop_modify(event_loop_t loop, int fd, uint32_t events)
+{
+    if (!loop || fd < 0 || fd >= FD_SETSIZE) {
+        return RET_ERROR;
+    }
+
+    FD_CLR(fd, &loop->read_set);
+    FD_CLR(fd, &loop->write_set);
+    return event_loop_add(loop, fd, events);
+}
+
+int
+event_loop_remove(event_loop_t loop, int fd)
+{
+    if (!loop || fd < 0 || fd >= FD_SETSIZE) {
+        return RET_ERROR;
+    }
+
+    FD_CLR(fd, &loop->read_set);
+    FD_CLR(fd, &loop->write_set);
+    while (loop->max_fd >= 0 && !FD_ISSET(loop->max_fd, &loop->read_set) &&
+           !FD_ISSET(loop->max_fd, &loop->write_set)) {
+        loop->max_fd--;
+    }
+    return RET_SUCCESS;
+}
+
+int
+event_loop_wait(event_loop_t loop, event_t *events, int max_events, int timeout_ms)
+{
+    // The master sets are copied, not rebuilt, on every wakeup
+    fd_set read_fds = loop->read_set;
+    fd_set write_fds = loop->write_set;
+    struct timeval tv;
+    struct timeval *tvp = NULL;
+
+    if (timeout_ms >= 0) {
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        tvp = &tv;
+    }
+
+    int ready = select(loop->max_fd + 1, &read_fds, &write_fds, NULL, tvp);
+    if (ready < 0) {
+        if (errno != EINTR) {
+            log(ERROR, "select() failed: %s", strerror(errno));
+        }
+        return RET_ERROR;
+    }
+
+    int count = 0;
+    for (int fd = 0; fd <= loop->max_fd && count < max_events && ready > 0; fd++) {
+        uint32_t flags = 0;
+        if (FD_ISSET(fd, &read_fds)) {
+            flags |= EVENT_READ;
+        }
+        if (FD_ISSET(fd, &write_fds)) {
+            flags |= EVENT_WRITE;
+        }
+        if (flags) {
+            events[count].fd = fd;
+            events[count].events = flags;
+            count++;
+            ready--;
+        }
+    }
+    return count;
+}
+
+const char *
+event_loop_backend(void)
+{
+    return "select";
+}
+
+#else // epoll
+
+#include <sys/epoll.h>
+
+typedef struct event_loop_cdt {
+    int epoll_fd;
+    struct epoll_event ready[EVENT_LOOP_MAX_EVENTS];
+} event_loop_cdt;
+
+static uint32_t
+to_epoll_events(uint32_t events)
+{
+    // RDHUP: a peer that shut down its side is reported like a hangup
+    uint32_t epoll_events = EPOLLET | EPOLLRDHUP;
+    if (events & EVENT_READ) {
+        epoll_events |= EPOLLIN;
+    }
+    if (events & EVENT_WRITE) {
+        epoll_events |= EPOLLOUT;
+    }
+    return epoll_events;
+}
+
+event_loop_t
+event_loop_create(void)
+{
+    event_loop_cdt *loop = malloc(sizeof(event_loop_cdt));
+    if (!loop) {
+        log(ERROR, "Failed to allocate memory for event loop");
+        return NULL;
+    }
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        log(ERROR, "epoll_create1() failed: %s", strerror(errno));
+        free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void
+event_loop_destroy(event_loop_t loop)
+{
+    if (!loop) {
+        return;
+    }
+    close(loop->epoll_fd);
+    free(loop);
+}
+
+int
+event_loop_add(event_loop_t loop, int fd, uint32_t events)
+{
+    if (!loop || fd < 0) {
+        return RET_ERROR;
+    }
+
+    struct epoll_event ev = {0};
+    ev.events = to_epoll_events(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        log(ERROR, "epoll_ctl(ADD, %d) failed: %s", fd, strerror(errno));
+        return RET_ERROR;
+    }
+    return RET_SUCCESS;
+}
+
+int
+event_loop_modify(event_loop_t loop, int fd, uint32_t events)
+{
+    if (!loop || fd < 0) {
+        return RET_ERROR;
+    }
+
+    struct epoll_event ev = {0};
+    ev.events = to_epoll_events(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        log(ERROR, "epoll_ctl(MOD, %d) failed: %s", fd, strerror(errno));
+        return RET_ERROR;
+    }
+    return RET_SUCCESS;
+}
+
+int
+event_loop_remove(event_loop_t loop, int fd)
+{
+    if (!loop || fd < 0) {
+        return RET_ERROR;
+    }
+
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL) < 0) {
+        // ENOENT: the fd was never registered, e.g. a rejected connection
+        if (errno != ENOENT) {
+            log(ERROR, "epoll_ctl(DEL, %d) failed: %s", fd, strerror(errno));
+        }
+        return RET_ERROR;
+    }
+    return RET_SUCCESS;
+}
+
+int
+event_loop_wait(event_loop_t loop, event_t *events, int max_events, int timeout_ms)
+{
+    if (max_events > EVENT_LOOP_MAX_EVENTS) {
+        max_events = EVENT_LOOP_MAX_EVENTS;
+    }
+
+    int ready = epoll_wait(loop->epoll_fd, loop->ready, max_events, timeout_ms);
+    if (ready < 0) {
+        if (errno != EINTR) {
+            log(ERROR, "epoll_wait() failed: %s", strerror(errno));
+        }
+        return RET_ERROR;
+    }
+
+    for (int i = 0; i < ready; i++) {
+        uint32_t flags = 0;
+        if (loop->ready[i].events & EPOLLIN) {
+            flags |= EVENT_READ;
+        }
+        if (loop->ready[i].events & EPOLLOUT) {
+            flags |= EVENT_WRITE;
+        }
+        if (loop->ready[i].events & (EPOLLHUP | EPOLLRDHUP)) {
+            flags |= EVENT_HUP;
+        }
+        if (loop->ready[i].events & EPOLLERR) {
+            flags |= EVENT_ERROR;
+        }
+        events[i].fd = loop->ready[i].data.fd;
+        events[i].events = flags;
+    }
+    return ready;
+}
+
+const char *
+event_loop_backend(void)
+{
+    return "epoll";
+}
+
+#endif // WEREWOLF_USE_SELECT
@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include "logger.h"
+#include "defs.h"
+#include "frame.h"
+
+#define RING_MASK (FRAME_RING_SIZE - 1)
+
+typedef struct frame_ring_cdt {
+    size_t head;            // Next byte to parse (free-running)
+    size_t tail;            // Next byte to fill (free-running)
+    int saved_index;        // Byte overwritten by the last in-place NUL, -1 if none
+    char saved_byte;
+    char data[FRAME_RING_SIZE + 1];   // +1 so a frame ending at the edge can be NUL terminated
+} frame_ring_cdt;
+
+// Wrapped frames are reassembled here
+static __thread char scratch[FRAME_MAX_PAYLOAD + 1];
+
+void
+frame_encode_header(char header[FRAME_HEADER_SIZE], size_t len)
+{
+    header[0] = (char) ((len >> 8) & 0xff);
+    header[1] = (char) (len & 0xff);
+}
+
+ssize_t
+frame_send(int fd, const void *payload, size_t len, int flags)
+{
+    if (len > FRAME_MAX_PAYLOAD) {
+        log(ERROR, "Frame of %zu bytes exceeds the %d byte limit", len, FRAME_MAX_PAYLOAD);
+        return RET_ERROR;
+    }
+
+    char header[FRAME_HEADER_SIZE];
+    frame_encode_header(header, len);
+
+    struct iovec iov[2] = {
+        { .iov_base = header, .iov_len = FRAME_HEADER_SIZE },
+        { .iov_base = (void *) payload, .iov_len = len },
+    };
+    struct msghdr msg = {0};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    return sendmsg(fd, &msg, flags);
+}
+
+frame_ring_t
+frame_ring_create(void)
+{
+    frame_ring_cdt *ring = malloc(sizeof(frame_ring_cdt));
+    if (!ring) {
+        log(ERROR, "Failed to allocate memory for frame ring");
+        return NULL;
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    ring->saved_index = -1;
+    return ring;
+}
+
+void
+frame_ring_destroy(frame_ring_t ring)
+{
+    free(ring);
+}
+
+// Undoes the NUL written after the last in-place payload
+static void
+restore_saved(frame_ring_cdt *ring)
+{
+    if (ring->saved_index >= 0) {
+        ring->data[ring->saved_index] = ring->saved_byte;
+        ring->saved_index = -1;
+    }
+}
+
+int
+frame_ring_reserve(frame_ring_t ring, struct iovec iov[2])
+{
+    restore_saved(ring);
+    if (ring->head == ring->tail) {
+        // Empty: rewind so the next frames land contiguously
+        ring->head = ring->tail = 0;
+    }
+
+    size_t space = FRAME_RING_SIZE - (ring->tail - ring->head);
+    if (space == 0) {
+        return 0;
+    }
+
+    size_t start = ring->tail & RING_MASK;
+    size_t first = FRAME_RING_SIZE - start;
+    if (first > space) {
+        first = space;
+    }
+    iov[0].iov_base = ring->data + start;
+    iov[0].iov_len = first;
+    if (space == first) {
+        return 1;
+    }
+    iov[1].iov_base = ring->data;
+    iov[1].iov_len = space - first;
+    return 2;
+}
+
+void
+frame_ring_commit(frame_ring_t ring, size_t len)
+{
+    ring->tail += len;
+}
+
+size_t
+frame_ring_push(frame_ring_t ring, const void *data, size_t len)
+{
+    struct iovec iov[2];
+    int count = frame_ring_reserve(ring, iov);
+    size_t copied = 0;
+
+    for (int i = 0; i < count && copied < len; i++) {
+        size_t n = len - copied < iov[i].iov_len ? len - copied : iov[i].iov_len;
+        memcpy(iov[i].iov_base, (const char *) data + copied, n);
+        copied += n;
+    }
+    frame_ring_commit(ring, copied);
+    return copied;
+}
+
+int
+frame_ring_next(frame_ring_t ring, const char **payload, size_t *len)
+{
+    restore_saved(ring);
+
+    size_t used = ring->tail - ring->head;
+    if (used < FRAME_HEADER_SIZE) {
+        return 0;
+    }
+
+    size_t frame_len = ((size_t) (unsigned char) ring->data[ring->head & RING_MASK] << 8) |
+                       (unsigned char) ring->data[(ring->head + 1) & RING_MASK];
+    if (frame_len > FRAME_MAX_PAYLOAD) {
+        return RET_ERROR;
+    }
+    if (used < FRAME_HEADER_SIZE + frame_len) {
+        return 0;
+    }
+
+    size_t start = (ring->head + FRAME_HEADER_SIZE) & RING_MASK;
+    if (start + frame_len <= FRAME_RING_SIZE) {
+        size_t end = start + frame_len;
+        ring->saved_index = (int) end;
+        ring->saved_byte = ring->data[end];
+        ring->data[end] = '\0';
+        *payload = ring->data + start;
+    } else {
+        size_t first = FRAME_RING_SIZE - start;
+        memcpy(scratch, ring->data + start, first);
+        memcpy(scratch + first, ring->data, frame_len - first);
+        scratch[frame_len] = '\0';
+        *payload = scratch;
+    }
+
+    *len = frame_len;
+    ring->head += FRAME_HEADER_SIZE + frame_len;
+    return 1;
+}
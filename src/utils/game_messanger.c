@@ -3,9 +3,54 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
 #include "logger.h"
 #include "game_messanger.h"
 #include "defs.h"
+#include "frame.h"
+#include "metrics.h"
+#include "wire.h"
+
+#define INITIAL_WIRE_CAPACITY 1024
+
+static __thread const message_transport_t *transport = NULL;
+static __thread void *transport_ctx = NULL;
+// socket_id -> negotiated wire version, 0 (text) for sockets never listed
+static __thread uint8_t *wire_versions = NULL;
+static __thread int wire_capacity = 0;
+
+void
+set_message_transport(const message_transport_t *new_transport, void *ctx)
+{
+    transport = new_transport;
+    transport_ctx = ctx;
+}
+
+static int
+transport_send(int socket_id, const void *data, size_t len)
+{
+    if (transport) {
+        return transport->send(transport_ctx, socket_id, data, len);
+    }
+    return frame_send(socket_id, data, len, 0);
+}
+
+static int
+transport_broadcast(const int *socket_ids, int count, const void *data, size_t len)
+{
+    if (transport) {
+        return transport->broadcast(transport_ctx, socket_ids, count, data, len);
+    }
+
+    int delivered = 0;
+    for (int i = 0; i < count; i++) {
+        if (frame_send(socket_ids[i], data, len, 0) >= 0) {
+            delivered++;
+        }
+    }
+    return delivered;
+}
 
 const char *
 channel_name(message_channel_t channel)
@@ -44,70 +89,368 @@ parse_message_channel(const char *message)
         return CHANNEL_COUNT;
     }
 
-    char channel[32] = {0};
-    strncpy(channel, message + 1, end_bracket - message - 1);
-
-    if (strcmp(channel, "ANNOUNCEMENT") == 0) return CHANNEL_ANNOUNCEMENT;
-    if (strcmp(channel, "CHAT") == 0) return CHANNEL_CHAT;
-    if (strcmp(channel, "WEREWOLF") == 0) return CHANNEL_WEREWOLF;
-    if (strcmp(channel, "SERVER") == 0) return CHANNEL_SERVER;
-    if (strcmp(channel, "WHISPER") == 0) return CHANNEL_WHISPER;
+    // Compared in place; names longer than any channel never match
+    const char *name = message + 1;
+    size_t name_len = end_bracket - name;
+    for (int channel = 0; channel < CHANNEL_COUNT; channel++) {
+        const char *candidate = channel_name(channel);
+        if (strncmp(candidate, name, name_len) == 0 && candidate[name_len] == '\0') {
+            return channel;
+        }
+    }
 
     return CHANNEL_COUNT;
 }
 
-char *
-format_server_message(const char *message)
+// Appends len bytes, or as many as fit before end
+static char *
+append(char *out, const char *end, const char *data, size_t len)
+{
+    size_t room = end - out;
+    if (len > room) {
+        len = room;
+    }
+    memcpy(out, data, len);
+    return out + len;
+}
+
+// Appends a NUL terminated string in one pass, cut to fit
+static char *
+append_str(char *out, const char *end, const char *str)
+{
+    while (out < end && *str) {
+        *out++ = *str++;
+    }
+    return out;
+}
+
+static char *
+append_int(char *out, const char *end, long long number)
+{
+    char digits[24];
+    int n = sizeof(digits);
+    unsigned long long value = number < 0 ? -(unsigned long long) number : (unsigned long long) number;
+    do {
+        digits[--n] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value);
+    if (number < 0) {
+        digits[--n] = '-';
+    }
+    return append(out, end, digits + n, sizeof(digits) - n);
+}
+
+#define APPEND_LITERAL(out, end, literal) append(out, end, literal, sizeof(literal) - 1)
+
+// The formatters below write into out (NUL terminated, cut to fit size) and
+// return the length written without the NUL
+static size_t
+finish(char *start, char *out, size_t size)
+{
+    *out = '\0';
+    return out - start;
+}
+
+size_t
+format_server_message(char *out, size_t size, const char *message)
 {
-    static char formatted[BUFFER_SIZE];
-    snprintf(formatted, BUFFER_SIZE, "[SERVER] %s\n", message);
-    return formatted;
+    if (size == 0) {
+        return 0;
+    }
+    const char *end = out + size - 1;
+    char *p = APPEND_LITERAL(out, end, "[SERVER] ");
+    p = append_str(p, end, message);
+    p = APPEND_LITERAL(p, end, "\n");
+    return finish(out, p, size);
 }
 
-char *
-format_message(message_channel_t channel, int player_number, const char *message) 
+size_t
+format_message(char *out, size_t size, message_channel_t channel, int player_number, const char *message)
 {
-    static char formatted[BUFFER_SIZE];
-    snprintf(formatted, BUFFER_SIZE, "[%s] Player %d: %s\n", 
-             channel_name(channel), player_number, message);
-    return formatted;
+    if (size == 0) {
+        return 0;
+    }
+    const char *end = out + size - 1;
+    char *p = APPEND_LITERAL(out, end, "[");
+    p = append_str(p, end, channel_name(channel));
+    p = APPEND_LITERAL(p, end, "] Player ");
+    p = append_int(p, end, player_number);
+    p = APPEND_LITERAL(p, end, ": ");
+    p = append_str(p, end, message);
+    p = APPEND_LITERAL(p, end, "\n");
+    return finish(out, p, size);
 }
 
+static size_t
+format_whisper_message(char *out, size_t size, int from_id, int to_id, const char *message)
+{
+    if (size == 0) {
+        return 0;
+    }
+    const char *end = out + size - 1;
+    char *p = APPEND_LITERAL(out, end, "[WHISPER] From Player ");
+    p = append_int(p, end, from_id);
+    p = APPEND_LITERAL(p, end, " to Player ");
+    p = append_int(p, end, to_id);
+    p = APPEND_LITERAL(p, end, ": ");
+    p = append_str(p, end, message);
+    p = APPEND_LITERAL(p, end, "\n");
+    return finish(out, p, size);
+}
 
+// Binary record as the text protocol would have shown it; NULL if the
+// record names no channel
 static char *
-format_whisper_message(int from_id, int to_id, const char *message)
+render_record(char *p, const char *end, const wire_record_t *record)
 {
-    static char formatted[BUFFER_SIZE];
-    snprintf(formatted, BUFFER_SIZE, "[WHISPER] From Player %d to Player %d: %s\n",
-             from_id, to_id, message);
-    return formatted;
+    if (record->channel >= CHANNEL_COUNT) {
+        return NULL;
+    }
+
+    message_channel_t channel = (message_channel_t) record->channel;
+    p = append_str(p, end, get_channel_color(channel));
+    if (record->opcode == WIRE_OP_WHISPER) {
+        p = APPEND_LITERAL(p, end, "[WHISPER] From Player ");
+        p = append_int(p, end, record->player);
+        p = APPEND_LITERAL(p, end, " to Player ");
+        p = append_int(p, end, record->target);
+        p = APPEND_LITERAL(p, end, ": ");
+    } else if (record->player == 0) {
+        p = APPEND_LITERAL(p, end, "[SERVER] ");
+    } else {
+        p = APPEND_LITERAL(p, end, "[");
+        p = append_str(p, end, channel_name(channel));
+        p = APPEND_LITERAL(p, end, "] Player ");
+        p = append_int(p, end, record->player);
+        p = APPEND_LITERAL(p, end, ": ");
+    }
+    p = append(p, end, record->text, record->text_len);
+    return APPEND_LITERAL(p, end, "\n\033[0m");
+}
+
+// A text frame, colored by the channel its line starts with
+static char *
+render_line(char *p, const char *end, const char *payload, size_t len)
+{
+    message_channel_t channel = parse_message_channel(payload);
+    if (channel != CHANNEL_COUNT) {
+        p = append_str(p, end, get_channel_color(channel));
+    }
+    p = append(p, end, payload, len);
+    if (channel != CHANNEL_COUNT) {
+        p = APPEND_LITERAL(p, end, "\033[0m");
+    }
+    return p;
+}
+
+typedef struct message_decoder_cdt {
+    frame_ring_t ring;
+    int wire_version;       // Set by the server's handshake reply
+} message_decoder_cdt;
+
+message_decoder_t
+message_decoder_create(void)
+{
+    message_decoder_cdt *decoder = malloc(sizeof(message_decoder_cdt));
+    if (!decoder) {
+        log(ERROR, "Failed to allocate message decoder");
+        return NULL;
+    }
+    decoder->ring = frame_ring_create();
+    if (!decoder->ring) {
+        free(decoder);
+        return NULL;
+    }
+    decoder->wire_version = 0;
+    return decoder;
+}
+
+void
+message_decoder_destroy(message_decoder_t decoder)
+{
+    if (decoder) {
+        frame_ring_destroy(decoder->ring);
+        free(decoder);
+    }
+}
+
+ssize_t
+message_decoder_read(message_decoder_t decoder, int socket_id)
+{
+    struct iovec iov[2];
+    int count = frame_ring_reserve(decoder->ring, iov);
+    if (count == 0) {
+        // Only if frames were left unrendered
+        errno = ENOBUFS;
+        return -1;
+    }
+    ssize_t valread = readv(socket_id, iov, count);
+    if (valread > 0) {
+        frame_ring_commit(decoder->ring, valread);
+    }
+    return valread;
 }
 
 int
-read_and_format_message(int socket_id, char *buffer, size_t buffer_size)
+message_decoder_render(message_decoder_t decoder, char *out, size_t size, int *heartbeats)
 {
-    if (socket_id < 0 || !buffer || buffer_size == 0) {
-        log(ERROR, "Invalid parameters for read_and_format_message");
+    if (!decoder || !out || size == 0) {
+        log(ERROR, "Invalid parameters for message_decoder_render");
+        errno = EINVAL;
         return -1;
     }
 
-    int valread = read(socket_id, buffer, buffer_size - 1);
-    if (valread <= 0) {
-        return valread;
+    const char *end = out + size - 1;
+    char *p = out;
+    const char *payload;
+    size_t len;
+    int rv = 0;
+    while ((size_t) (end - p) >= MESSAGE_RENDER_MAX && (rv = frame_ring_next(decoder->ring, &payload, &len)) > 0) {
+        if (len == 0) {
+            if (heartbeats) {
+                (*heartbeats)++;
+            }
+            continue;
+        }
+
+        // The server's handshake reply: records from here on
+        int version = wire_decode_hello(payload, len);
+        if (version >= 0) {
+            decoder->wire_version = version;
+            continue;
+        }
+
+        if (decoder->wire_version == 0) {
+            p = render_line(p, end, payload, len);
+            continue;
+        }
+        wire_record_t record;
+        if (wire_decode(payload, len, &record) < 0 || !(p = render_record(p, end, &record))) {
+            errno = EPROTO;
+            return -1;
+        }
+    }
+    if (rv < 0) {
+        // A frame longer than any the server sends: the stream is unusable
+        errno = EMSGSIZE;
+        return -1;
     }
+    return (int) finish(out, p, size);
+}
 
-    buffer[valread] = '\0';
-    message_channel_t channel = parse_message_channel(buffer);
-    
-    if (channel != CHANNEL_COUNT) {
-        // Format the message with color
-        char temp[BUFFER_SIZE];
-        snprintf(temp, BUFFER_SIZE, "%s%s\033[0m", 
-                get_channel_color(channel), buffer);
-        strncpy(buffer, temp, buffer_size);
+int
+message_decoder_wire_version(message_decoder_t decoder)
+{
+    return decoder ? decoder->wire_version : 0;
+}
+
+int
+set_socket_wire_version(int socket_id, int version)
+{
+    if (socket_id < 0) {
+        return RET_ERROR;
     }
+    if (socket_id >= wire_capacity) {
+        int capacity = wire_capacity ? wire_capacity : INITIAL_WIRE_CAPACITY;
+        while (capacity <= socket_id) {
+            capacity *= 2;
+        }
+        uint8_t *grown = realloc(wire_versions, capacity);
+        if (!grown) {
+            log(ERROR, "Failed to grow wire version table");
+            return RET_ERROR;
+        }
+        memset(grown + wire_capacity, 0, capacity - wire_capacity);
+        wire_versions = grown;
+        wire_capacity = capacity;
+    }
+    wire_versions[socket_id] = (uint8_t) version;
+    return RET_SUCCESS;
+}
 
-    return valread;
+int
+get_socket_wire_version(int socket_id)
+{
+    return socket_id >= 0 && socket_id < wire_capacity ? wire_versions[socket_id] : 0;
+}
+
+int
+negotiate_wire_protocol(int socket_id, const char *payload, size_t len)
+{
+    int offered = wire_decode_hello(payload, len);
+    if (offered < 0) {
+        return 0;
+    }
+
+    int version = offered < WIRE_VERSION ? offered : WIRE_VERSION;
+    char reply[WIRE_HELLO_SIZE];
+    wire_encode_hello(reply, version);
+    // The reply is the last text-protocol frame this socket gets
+    if (transport_send(socket_id, reply, sizeof(reply)) < 0 ||
+        set_socket_wire_version(socket_id, version) < 0) {
+        log(ERROR, "Failed to switch socket %d to the binary protocol", socket_id);
+        return 1;
+    }
+    log(INFO, "Client %d speaks binary protocol v%d", socket_id, version);
+    return 1;
+}
+
+// Binary form of a message into out; long text is cut to fit
+static size_t
+encode_record(char *out, size_t size, wire_opcode_t opcode, message_channel_t channel,
+              int player_number, int target_number, const char *message)
+{
+    size_t text_len = strlen(message);
+    if (text_len > size - WIRE_MAX_HEADER) {
+        text_len = size - WIRE_MAX_HEADER;
+    }
+    wire_record_t record = {
+        .opcode = opcode,
+        .channel = channel,
+        .player = player_number > 0 ? player_number : 0,
+        .target = target_number > 0 ? target_number : 0,
+        .text = message,
+        .text_len = text_len,
+    };
+    return wire_encode(out, size, &record);
+}
+
+// Text form: "[CHANNEL] Player n: ..." from a player, "[SERVER] ..." from the
+// server (player_number 0)
+static size_t
+render_text(char *out, size_t size, wire_opcode_t opcode, message_channel_t channel,
+            int player_number, int target_number, const char *message)
+{
+    if (opcode == WIRE_OP_WHISPER) {
+        return format_whisper_message(out, size, player_number, target_number, message);
+    }
+    if (player_number) {
+        return format_message(out, size, channel, player_number, message);
+    }
+    return format_server_message(out, size, message);
+}
+
+// Renders a message in the protocol of version (0: text) into out, sized for
+// one frame plus the NUL the text form adds
+static size_t
+render(char out[FRAME_MAX_PAYLOAD + 1], int version, wire_opcode_t opcode, message_channel_t channel,
+       int player_number, int target_number, const char *message)
+{
+    if (version > 0) {
+        return encode_record(out, FRAME_MAX_PAYLOAD, opcode, channel, player_number, target_number, message);
+    }
+    return render_text(out, FRAME_MAX_PAYLOAD + 1, opcode, channel, player_number, target_number, message);
+}
+
+// One message to one socket, in the protocol that socket speaks
+static int
+deliver(int socket_id, wire_opcode_t opcode, message_channel_t channel, int player_number,
+        int target_number, const char *message)
+{
+    char data[FRAME_MAX_PAYLOAD + 1];
+    size_t len = render(data, get_socket_wire_version(socket_id), opcode, channel,
+                        player_number, target_number, message);
+    return transport_send(socket_id, data, len);
 }
 
 int 
@@ -118,8 +461,9 @@ send_message(int socket_id, message_channel_t channel, const char *message, int
         return -1;
     }
 
-    char *formatted = format_message(channel, player_number, message);
-    int rv = send(socket_id, formatted, strlen(formatted) + 1, 0);
+    metrics_inc(COUNTER_MESSAGES + channel);
+    metrics_latency_note(channel);
+    int rv = deliver(socket_id, WIRE_OP_MESSAGE, channel, player_number, 0, message);
     if (rv < 0) {
         log(ERROR, "Failed to send message to socket %d", socket_id);
         return -1;
@@ -127,6 +471,23 @@ send_message(int socket_id, message_channel_t channel, const char *message, int
     return rv;
 }
 
+int
+send_server_message(int socket_id, const char *message)
+{
+    if (socket_id < 0 || !message) {
+        log(ERROR, "Invalid parameters for send_server_message");
+        return -1;
+    }
+
+    metrics_inc(COUNTER_MESSAGES + CHANNEL_SERVER);
+    metrics_latency_note(CHANNEL_SERVER);
+    int rv = deliver(socket_id, WIRE_OP_MESSAGE, CHANNEL_SERVER, 0, 0, message);
+    if (rv < 0) {
+        log(ERROR, "Failed to send server message to socket %d", socket_id);
+        return -1;
+    }
+    return rv;
+}
 
 int 
 send_whisper(int from_socket_id, int to_socket_id, int from_player_number, int to_player_number, const char *message) 
@@ -136,16 +497,33 @@ send_whisper(int from_socket_id, int to_socket_id, int from_player_number, int t
         return -1;
     }
 
-    char *formatted = format_whisper_message(from_player_number, to_player_number, message);
-    log(INFO, "Sending whisper to socket %d: %s", to_socket_id, formatted);
-    int rv = send(to_socket_id, formatted, strlen(formatted), 0);
+    log(INFO, "Sending whisper from player %d to socket %d: %s", from_player_number, to_socket_id, message);
+    metrics_inc(COUNTER_MESSAGES + CHANNEL_WHISPER);
+    metrics_latency_note(CHANNEL_WHISPER);
+    // The sender gets the same line back as confirmation. Rendered once when
+    // both speak the same protocol.
+    int to_version = get_socket_wire_version(to_socket_id);
+    if (to_version == get_socket_wire_version(from_socket_id)) {
+        char data[FRAME_MAX_PAYLOAD + 1];
+        size_t len = render(data, to_version, WIRE_OP_WHISPER, CHANNEL_WHISPER, from_player_number,
+                            to_player_number, message);
+        int sockets[] = { to_socket_id, from_socket_id };
+        int delivered = transport_broadcast(sockets, 2, data, len);
+        if (delivered < 2) {
+            log(ERROR, "Failed to deliver whisper from socket %d to socket %d", from_socket_id, to_socket_id);
+            return -1;
+        }
+        return delivered;
+    }
+
+    int rv = deliver(to_socket_id, WIRE_OP_WHISPER, CHANNEL_WHISPER, from_player_number,
+                     to_player_number, message);
     if (rv < 0) {
         log(ERROR, "Failed to send whisper to socket %d", to_socket_id);
         return -1;
     }
-
-    char *confirmation = format_whisper_message(from_player_number, to_player_number, message);
-    rv = send(from_socket_id, confirmation, strlen(confirmation), 0);
+    rv = deliver(from_socket_id, WIRE_OP_WHISPER, CHANNEL_WHISPER, from_player_number,
+                 to_player_number, message);
     if (rv < 0) {
         log(ERROR, "Failed to send whisper confirmation to socket %d", from_socket_id);
         return -1;
@@ -156,76 +534,176 @@ send_whisper(int from_socket_id, int to_socket_id, int from_player_number, int t
 
 
 int 
-forward_message(channel_subscription_t *subscription, const char *message) 
+forward_message(message_channel_t channel, const bitset_t *seats, const int *seat_sockets,
+                int player_number, const char *message)
 {
-    if (!subscription || !message) {
+    // Recipient fds, grown to the largest fan-out seen by this thread. Text
+    // clients fill it from the front and binary ones from the back.
+    static __thread int *socket_ids = NULL;
+    static __thread int capacity = 0;
+
+    if (!seats || !seat_sockets || !message) {
         log(ERROR, "Invalid parameters for forward_message");
         return -1;
     }
 
-    for (int i = 1; i < subscription->subscription_count; i++) {
-        if (send(subscription->socket_ids[i], message, strlen(message), 0) < 0) {
-            log(ERROR, "Failed to forward message to subscriber %d", 
-            subscription->socket_ids[i]);
+    int needed = seats->word_count * 64;
+    if (needed > capacity) {
+        int *grown = realloc(socket_ids, sizeof(int) * needed);
+        if (!grown) {
+            log(ERROR, "Failed to allocate memory for recipients");
+            return -1;
+        }
+        socket_ids = grown;
+        capacity = needed;
+    }
+
+    int text_count = 0;
+    int binary_count = 0;
+    for (int seat = bitset_next(seats, 0); seat >= 0; seat = bitset_next(seats, seat + 1)) {
+        int socket_id = seat_sockets[seat];
+        if (socket_id < 0) {
+            continue;
+        }
+        if (get_socket_wire_version(socket_id) > 0) {
+            socket_ids[capacity - ++binary_count] = socket_id;
+        } else {
+            socket_ids[text_count++] = socket_id;
         }
     }
+    int count = text_count + binary_count;
+    metrics_inc(COUNTER_MESSAGES + channel);
+    metrics_observe(HISTOGRAM_FANOUT, count);
+    metrics_latency_note(channel);
+    if (count == 0) {
+        return 0;
+    }
+
+    // Each form is encoded once and shared by its recipients
+    char data[FRAME_MAX_PAYLOAD + 1];
+    int delivered = 0;
+    if (text_count > 0) {
+        size_t len = render(data, 0, WIRE_OP_MESSAGE, channel, player_number, 0, message);
+        delivered += transport_broadcast(socket_ids, text_count, data, len);
+    }
+    if (binary_count > 0) {
+        size_t len = render(data, WIRE_VERSION, WIRE_OP_MESSAGE, channel, player_number, 0, message);
+        delivered += transport_broadcast(socket_ids + capacity - binary_count, binary_count, data, len);
+    }
+    if (delivered < count) {
+        log(ERROR, "Failed to forward message to %d of %d subscribers", count - delivered, count);
+    }
     return 0;
 }
 
-// Subscribe a socket to a channel
-int 
-subscribe_to_channel(channel_subscription_t *subscription, int socket_id) 
+int
+prerender_message(prerendered_message_t *out, message_channel_t channel, int player_number,
+                  const char *message)
 {
-    if (!subscription || socket_id < 0) {
-        log(ERROR, "Invalid parameters for subscribe_to_channel");
+    if (!out || !message) {
+        log(ERROR, "Invalid parameters for prerender_message");
+        return RET_ERROR;
+    }
+
+    size_t text_len = render_text(out->text, sizeof(out->text), WIRE_OP_MESSAGE, channel,
+                                  player_number, 0, message);
+    size_t record_len = encode_record(out->record, sizeof(out->record), WIRE_OP_MESSAGE, channel,
+                                      player_number, 0, message);
+    // A full buffer means the text was cut
+    if (text_len >= sizeof(out->text) - 1 || record_len == 0 || record_len == sizeof(out->record)) {
+        log(ERROR, "Message too long to prerender: %s", message);
+        out->text_len = 0;
+        return RET_ERROR;
+    }
+    out->channel = channel;
+    out->text_len = text_len;
+    out->record_len = record_len;
+    return RET_SUCCESS;
+}
+
+int
+send_prerendered(int socket_id, const prerendered_message_t *message)
+{
+    if (socket_id < 0 || !message || message->text_len == 0) {
+        log(ERROR, "Invalid parameters for send_prerendered");
         return -1;
     }
 
-    if (subscription->subscription_count >= MAX_SUBSCRIPTIONS) {
-        log(ERROR, "Channel subscription limit reached");
+    metrics_inc(COUNTER_MESSAGES + message->channel);
+    metrics_latency_note(message->channel);
+    int rv = get_socket_wire_version(socket_id) > 0
+        ? transport_send(socket_id, message->record, message->record_len)
+        : transport_send(socket_id, message->text, message->text_len);
+    if (rv < 0) {
+        log(ERROR, "Failed to send message to socket %d", socket_id);
         return -1;
     }
+    return rv;
+}
 
-    if (is_subscribed(subscription, socket_id)) {
-        log(WARN, "Socket %d already subscribed to channel", socket_id);
-        return 0;
+static const char *const notice_texts[NOTICE_COUNT] = {
+    [NOTICE_NIGHT_SILENCE] = "It is night time, you are not allowed to talk!",
+    [NOTICE_DEAD_CANNOT_TALK] = "The dead cannot talk.",
+    [NOTICE_YOU_ARE_DEAD] = "You are dead. You can keep watching, but not talk or vote.",
+    [NOTICE_NO_VOTE] = "There is no vote right now.",
+    [NOTICE_NIGHT_VOTE] = "Only werewolves vote at night.",
+    [NOTICE_DEAD_CANNOT_VOTE] = "Dead players cannot vote.",
+    [NOTICE_VOTE_USAGE] = "Usage: /vote <player number>",
+    [NOTICE_WEREWOLVES_ONLY] = "Only living werewolves can use /ww.",
+};
+// Written once by prerender_server_notices(), then only read by the workers
+static prerendered_message_t notices[NOTICE_COUNT];
+
+int
+prerender_server_notices(void)
+{
+    for (int i = 0; i < NOTICE_COUNT; i++) {
+        if (prerender_message(&notices[i], CHANNEL_SERVER, 0, notice_texts[i]) < 0) {
+            return RET_ERROR;
+        }
     }
+    return RET_SUCCESS;
+}
 
-    subscription->socket_ids[subscription->subscription_count++] = socket_id;
-    return 0;
+int
+send_server_notice(int socket_id, server_notice_t notice)
+{
+    if (notice < 0 || notice >= NOTICE_COUNT) {
+        log(ERROR, "Invalid parameters for send_server_notice");
+        return -1;
+    }
+    if (notices[notice].text_len == 0) {
+        return send_server_message(socket_id, notice_texts[notice]);
+    }
+    return send_prerendered(socket_id, &notices[notice]);
 }
 
+// Subscribe a seat to a channel
 int 
-unsubscribe_from_channel(channel_subscription_t *subscription, int socket_id) 
+subscribe_to_channel(channel_subscription_t *subscription, int seat) 
 {
-    if (!subscription || socket_id < 0) {
-        log(ERROR, "Invalid parameters for unsubscribe_from_channel");
+    if (!subscription || seat < 0) {
+        log(ERROR, "Invalid parameters for subscribe_to_channel");
         return -1;
     }
 
-    for (int i = 0; i < subscription->subscription_count; i++) {
-        if (subscription->socket_ids[i] == socket_id) {
-            subscription->socket_ids[i] = 
-                subscription->socket_ids[--subscription->subscription_count];
-            return 0;
-        }
+    return bitset_set(&subscription->members, seat);
+}
+
+int 
+unsubscribe_from_channel(channel_subscription_t *subscription, int seat) 
+{
+    if (!subscription || seat < 0) {
+        log(ERROR, "Invalid parameters for unsubscribe_from_channel");
+        return -1;
     }
 
-    log(WARN, "Socket %d not found in channel subscription", socket_id);
-    return -1;
+    bitset_clear(&subscription->members, seat);
+    return 0;
 }
 
 bool 
-is_subscribed(channel_subscription_t *subscription, int socket_id) 
+is_subscribed(const channel_subscription_t *subscription, int seat) 
 {
-    if (!subscription || socket_id < 0) {
-        return false;
-    }
-
-    for (int i = 0; i < subscription->subscription_count; i++) {
-        if (subscription->socket_ids[i] == socket_id) {
-            return true;
-        }
-    }
-    return false;
-}
\ No newline at end of file
+    return subscription && bitset_test(&subscription->members, seat);
+}
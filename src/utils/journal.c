@@ -0,0 +1,410 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "logger.h"
+#include "defs.h"
+#include "journal.h"
+
+#define JOURNAL_RING_SIZE (1 << 20)     // Bytes per journal, power of two
+#define JOURNAL_MAX 256                 // Open journals, one per worker
+#define JOURNAL_IDLE_SLEEP_NS (10 * 1000 * 1000)
+#define JOURNAL_PATH_MAX 256
+
+// Fields each event carries, in encoding order
+#define FIELD_SOCKET 0x01
+#define FIELD_VALUE 0x02
+#define FIELD_RESULT 0x04
+#define FIELD_SEED 0x08
+#define FIELD_TEXT 0x10
+
+static const uint8_t event_fields[JOURNAL_EVENT_COUNT] = {
+    [JOURNAL_OPEN] = FIELD_VALUE | FIELD_SEED,
+    [JOURNAL_SEED] = FIELD_SEED,
+    [JOURNAL_JOIN] = FIELD_SOCKET,
+    [JOURNAL_LEAVE] = FIELD_SOCKET,
+    [JOURNAL_START] = 0,
+    [JOURNAL_VOTE] = FIELD_SOCKET | FIELD_VALUE | FIELD_RESULT,
+    [JOURNAL_ADVANCE] = FIELD_VALUE | FIELD_RESULT,
+    [JOURNAL_END] = 0,
+    [JOURNAL_COMMAND] = FIELD_SOCKET | FIELD_VALUE | FIELD_RESULT | FIELD_TEXT,
+    [JOURNAL_CLOSE] = 0,
+};
+
+typedef struct journal_cdt {
+    int fd;
+    char path[JOURNAL_PATH_MAX];
+    _Atomic size_t head;        // Writer thread position (free-running)
+    _Atomic size_t tail;        // Producer position (free-running)
+    _Atomic unsigned long stalls;   // Appends that had to wait for ring space
+    unsigned long reported;         // Stalls already announced, writer thread only
+    uint8_t data[JOURNAL_RING_SIZE];
+} journal_cdt;
+
+static journal_t journals[JOURNAL_MAX];
+static pthread_mutex_t journals_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic bool running = false;
+static pthread_t writer;
+
+/*
+ * Encoding
+ */
+
+static size_t
+put_varint(uint8_t *out, uint64_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t) value;
+    return n;
+}
+
+// Returns the bytes read, 0 if the data ends inside the varint, RET_ERROR
+// past ten bytes
+static int
+get_varint(const uint8_t **cursor, const uint8_t *end, uint64_t *value)
+{
+    const uint8_t *start = *cursor;
+    const uint8_t *p = start;
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        result |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            *cursor = p;
+            return (int) (p - start);
+        }
+    }
+    return p == end ? 0 : RET_ERROR;
+}
+
+static uint64_t
+zigzag(int64_t value)
+{
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t
+unzigzag(uint64_t value)
+{
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+size_t
+journal_encode(uint8_t *out, size_t size, const journal_record_t *record)
+{
+    if (record->type == 0 || record->type >= JOURNAL_EVENT_COUNT) {
+        return 0;
+    }
+    uint8_t fields = event_fields[record->type];
+    size_t text_len = (fields & FIELD_TEXT) ? record->text_len : 0;
+    if (text_len > JOURNAL_TEXT_MAX) {
+        text_len = JOURNAL_TEXT_MAX;
+    }
+    // Every field at its widest, so the varints need no bounds checks
+    if (size < JOURNAL_RECORD_MAX - JOURNAL_TEXT_MAX + text_len) {
+        return 0;
+    }
+
+    size_t n = 0;
+    out[n++] = record->type;
+    n += put_varint(out + n, record->room);
+    if (fields & FIELD_SOCKET) {
+        n += put_varint(out + n, zigzag(record->socket));
+    }
+    if (fields & FIELD_VALUE) {
+        n += put_varint(out + n, zigzag(record->value));
+    }
+    if (fields & FIELD_RESULT) {
+        n += put_varint(out + n, zigzag(record->result));
+    }
+    if (fields & FIELD_SEED) {
+        n += put_varint(out + n, record->seed);
+    }
+    if (fields & FIELD_TEXT) {
+        n += put_varint(out + n, text_len);
+        memcpy(out + n, record->text, text_len);
+        n += text_len;
+    }
+    return n;
+}
+
+// Reads the next varint into out, or returns what get_varint did from the
+// enclosing decoder
+#define GET_FIELD(out, convert) \
+    do { \
+        uint64_t raw = 0; \
+        int ret = get_varint(&p, end, &raw); \
+        if (ret <= 0) { \
+            return ret; \
+        } \
+        out = convert(raw); \
+    } while (0)
+
+#define AS_IS(raw) (raw)
+
+int
+journal_decode(const uint8_t *data, size_t len, journal_record_t *record)
+{
+    if (len == 0) {
+        return 0;
+    }
+    const uint8_t *p = data;
+    const uint8_t *end = data + len;
+
+    memset(record, 0, sizeof(*record));
+    record->type = *p++;
+    if (record->type == 0 || record->type >= JOURNAL_EVENT_COUNT) {
+        return RET_ERROR;
+    }
+    uint8_t fields = event_fields[record->type];
+
+    uint64_t room;
+    GET_FIELD(room, AS_IS);
+    if (room > UINT32_MAX) {
+        return RET_ERROR;
+    }
+    record->room = (uint32_t) room;
+    if (fields & FIELD_SOCKET) {
+        GET_FIELD(record->socket, unzigzag);
+    }
+    if (fields & FIELD_VALUE) {
+        GET_FIELD(record->value, unzigzag);
+    }
+    if (fields & FIELD_RESULT) {
+        GET_FIELD(record->result, unzigzag);
+    }
+    if (fields & FIELD_SEED) {
+        GET_FIELD(record->seed, AS_IS);
+    }
+    if (fields & FIELD_TEXT) {
+        uint64_t text_len;
+        GET_FIELD(text_len, AS_IS);
+        if (text_len > JOURNAL_TEXT_MAX) {
+            return RET_ERROR;
+        }
+        if ((size_t) (end - p) < text_len) {
+            return 0;
+        }
+        record->text = (const char *) p;
+        record->text_len = text_len;
+        p += text_len;
+    }
+    return (int) (p - data);
+}
+
+int64_t
+journal_decode_header(const uint8_t *data, size_t len)
+{
+    if (len < JOURNAL_HEADER_SIZE || memcmp(data, JOURNAL_MAGIC, 3) != 0 || data[3] != JOURNAL_VERSION) {
+        return RET_ERROR;
+    }
+    uint64_t opened_ms = 0;
+    for (int i = 0; i < 8; i++) {
+        opened_ms |= (uint64_t) data[4 + i] << (8 * i);
+    }
+    return (int64_t) opened_ms;
+}
+
+/*
+ * Writer thread
+ */
+
+static int
+write_all(int fd, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return RET_ERROR;
+        }
+        data += written;
+        len -= written;
+    }
+    return RET_SUCCESS;
+}
+
+// Writes out everything queued; returns the bytes written. journals_lock held.
+static size_t
+drain(journal_t journal)
+{
+    size_t head = atomic_load_explicit(&journal->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&journal->tail, memory_order_acquire);
+    size_t pending = tail - head;
+    if (pending > 0) {
+        size_t offset = head & (JOURNAL_RING_SIZE - 1);
+        size_t first = JOURNAL_RING_SIZE - offset < pending ? JOURNAL_RING_SIZE - offset : pending;
+        if (write_all(journal->fd, journal->data + offset, first) < 0 ||
+            write_all(journal->fd, journal->data, pending - first) < 0) {
+            log(ERROR, "Journal %s write failed: %s", journal->path, strerror(errno));
+        }
+        // Released even on failure so the game never blocks on a dead disk
+        atomic_store_explicit(&journal->head, tail, memory_order_release);
+    }
+
+    unsigned long stalls = atomic_load_explicit(&journal->stalls, memory_order_relaxed);
+    if (stalls != journal->reported) {
+        log(WARN, "Journal %s: %lu events waited for ring space", journal->path, stalls - journal->reported);
+        journal->reported = stalls;
+    }
+    return pending;
+}
+
+static size_t
+drain_all(void)
+{
+    size_t written = 0;
+    pthread_mutex_lock(&journals_lock);
+    for (int i = 0; i < JOURNAL_MAX; i++) {
+        if (journals[i]) {
+            written += drain(journals[i]);
+        }
+    }
+    pthread_mutex_unlock(&journals_lock);
+    return written;
+}
+
+static void *
+writer_run(void *arg)
+{
+    struct timespec idle = { .tv_sec = 0, .tv_nsec = JOURNAL_IDLE_SLEEP_NS };
+    while (atomic_load_explicit(&running, memory_order_acquire)) {
+        // Batches build up while the thread sleeps
+        if (drain_all() < JOURNAL_RING_SIZE / 4) {
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+void
+journal_stop(void)
+{
+    if (atomic_exchange(&running, false)) {
+        pthread_join(writer, NULL);
+        drain_all();
+    }
+}
+
+/*
+ * Producer side
+ */
+
+journal_t
+journal_open(const char *path)
+{
+    journal_cdt *journal = calloc(1, sizeof(journal_cdt));
+    if (!journal) {
+        log(ERROR, "Failed to allocate journal");
+        return NULL;
+    }
+    snprintf(journal->path, sizeof(journal->path), "%s", path);
+
+    journal->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (journal->fd < 0) {
+        log(ERROR, "Failed to open journal %s: %s", path, strerror(errno));
+        free(journal);
+        return NULL;
+    }
+
+    uint8_t header[JOURNAL_HEADER_SIZE];
+    memcpy(header, JOURNAL_MAGIC, 3);
+    header[3] = JOURNAL_VERSION;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t opened_ms = (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    for (int i = 0; i < 8; i++) {
+        header[4 + i] = (uint8_t) (opened_ms >> (8 * i));
+    }
+    if (write_all(journal->fd, header, sizeof(header)) < 0) {
+        log(ERROR, "Failed to write journal %s: %s", path, strerror(errno));
+        close(journal->fd);
+        free(journal);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&journals_lock);
+    int slot = 0;
+    while (slot < JOURNAL_MAX && journals[slot]) {
+        slot++;
+    }
+    if (slot == JOURNAL_MAX) {
+        pthread_mutex_unlock(&journals_lock);
+        log(ERROR, "Too many open journals");
+        close(journal->fd);
+        free(journal);
+        return NULL;
+    }
+    journals[slot] = journal;
+    pthread_mutex_unlock(&journals_lock);
+
+    if (!atomic_exchange(&running, true)) {
+        if (pthread_create(&writer, NULL, writer_run, NULL) != 0) {
+            atomic_store(&running, false);
+            log(ERROR, "Failed to start journal thread");
+            journal_close(journal);
+            return NULL;
+        }
+        atexit(journal_stop);
+    }
+    return journal;
+}
+
+void
+journal_close(journal_t journal)
+{
+    if (!journal) {
+        return;
+    }
+
+    pthread_mutex_lock(&journals_lock);
+    drain(journal);
+    for (int i = 0; i < JOURNAL_MAX; i++) {
+        if (journals[i] == journal) {
+            journals[i] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&journals_lock);
+    close(journal->fd);
+    free(journal);
+}
+
+void
+journal_append(journal_t journal, const journal_record_t *record)
+{
+    uint8_t encoded[JOURNAL_RECORD_MAX];
+    size_t len = journal_encode(encoded, sizeof(encoded), record);
+    if (len == 0) {
+        log(ERROR, "Journal %s: cannot encode event %d", journal->path, record->type);
+        return;
+    }
+
+    size_t tail = atomic_load_explicit(&journal->tail, memory_order_relaxed);
+    if (JOURNAL_RING_SIZE - (tail - atomic_load_explicit(&journal->head, memory_order_acquire)) < len) {
+        atomic_fetch_add_explicit(&journal->stalls, 1, memory_order_relaxed);
+        while (JOURNAL_RING_SIZE - (tail - atomic_load_explicit(&journal->head, memory_order_acquire)) < len) {
+            sched_yield();
+        }
+    }
+
+    // The file is a byte stream, so a record may wrap around the ring's end
+    size_t offset = tail & (JOURNAL_RING_SIZE - 1);
+    size_t first = JOURNAL_RING_SIZE - offset < len ? JOURNAL_RING_SIZE - offset : len;
+    memcpy(journal->data + offset, encoded, first);
+    memcpy(journal->data, encoded + first, len - first);
+    atomic_store_explicit(&journal->tail, tail + len, memory_order_release);
+}
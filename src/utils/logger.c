@@ -1,7 +1,47 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
 #include "logger.h"
 
+#define LOG_LINE_MAX 2048
+#define LOG_RING_SIZE (1 << 20)     // Bytes per thread, power of two
+#define LOG_MAX_THREADS 64
+#define LOG_BATCH_SIZE (64 * 1024)
+#define LOG_IDLE_SLEEP_NS (10 * 1000 * 1000)
+
+#ifndef CLOCK_REALTIME_COARSE
+#define CLOCK_REALTIME_COARSE CLOCK_REALTIME
+#endif
+
 LOG_LEVEL current_level = DEBUG;
 
+// One record in a ring; text follows, records are padded to 8 bytes
+typedef struct {
+    uint32_t size;          // Whole record including padding, 0 marks a wrap
+    uint16_t text_len;
+    uint8_t level;
+    time_t timestamp;
+} log_record_t;
+
+typedef struct {
+    _Atomic size_t head;    // Consumer position (free-running)
+    _Atomic size_t tail;    // Producer position (free-running)
+    _Atomic unsigned long dropped;
+    unsigned long reported;     // Drops already announced, consumer only
+    char data[LOG_RING_SIZE];
+} log_ring_t;
+
+static log_ring_t *rings[LOG_MAX_THREADS];
+static _Atomic int ring_count = 0;
+static _Atomic bool running = false;
+static pthread_t flusher;
+
+static __thread log_ring_t *thread_ring = NULL;
+static __thread bool thread_ring_failed = false;
+
 void
 set_log_level(LOG_LEVEL new_lvl) {
     if (new_lvl >= DEBUG && new_lvl <= FATAL)
@@ -15,3 +55,313 @@ level_desc(LOG_LEVEL level) {
         return "UNKNOWN";
     return desc[level];
 }
+
+// "<timestamp>\t[<LEVEL>] " for synchronous lines
+static int
+format_prefix(char *out, size_t size, time_t t, LOG_LEVEL level)
+{
+    struct tm tm;
+    localtime_r(&t, &tm);
+    return snprintf(out, size, "%d-%02d-%02dT%02d:%02d:%02dZ\t[%s] ",
+                    tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                    tm.tm_hour, tm.tm_min, tm.tm_sec, level_desc(level));
+}
+
+static void
+write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        len -= written;
+    }
+}
+
+// flush: for lines written while the flusher runs, which writes straight to
+// the fds; stdio could otherwise hold them back until exit
+static void
+write_sync(LOG_LEVEL level, bool flush, const char *fmt, va_list args)
+{
+    FILE *out = level >= ERROR ? stderr : stdout;
+    char prefix[64];
+    format_prefix(prefix, sizeof(prefix), time(NULL), level);
+    flockfile(out);
+    fputs(prefix, out);
+    vfprintf(out, fmt, args);
+    fputc('\n', out);
+    if (flush) {
+        fflush(out);
+    }
+    funlockfile(out);
+}
+
+static void
+write_sync_line(LOG_LEVEL level, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    write_sync(level, true, fmt, args);
+    va_end(args);
+}
+
+// A thread past LOG_MAX_THREADS (or whose ring cannot be allocated) logs
+// synchronously, which is slower but loses nothing
+static log_ring_t *
+get_thread_ring(void)
+{
+    if (thread_ring || thread_ring_failed) {
+        return thread_ring;
+    }
+
+    int index = atomic_fetch_add(&ring_count, 1);
+    if (index >= LOG_MAX_THREADS || !(thread_ring = calloc(1, sizeof(log_ring_t)))) {
+        static atomic_bool warned = false;
+        thread_ring_failed = true;
+        if (!atomic_exchange(&warned, true)) {
+            write_sync_line(WARN, "No log ring for thread %d (%d rings), it and any later ones log synchronously",
+                            index + 1, LOG_MAX_THREADS);
+        }
+        return NULL;
+    }
+    rings[index] = thread_ring;
+    return thread_ring;
+}
+
+static void
+ring_push(log_ring_t *ring, LOG_LEVEL level, const char *text, size_t len)
+{
+    size_t size = (sizeof(log_record_t) + len + 7) & ~(size_t) 7;
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t offset = tail & (LOG_RING_SIZE - 1);
+    size_t to_end = LOG_RING_SIZE - offset;
+
+    // Records never wrap: skip to the start when the tail is too short
+    size_t needed = size + (to_end < size ? to_end : 0);
+    if (LOG_RING_SIZE - (tail - head) < needed) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    if (to_end < size) {
+        if (to_end >= sizeof(uint32_t)) {
+            ((log_record_t *) (ring->data + offset))->size = 0;
+        }
+        tail += to_end;
+        offset = 0;
+    }
+
+    log_record_t *record = (log_record_t *) (ring->data + offset);
+    record->size = size;
+    record->text_len = len;
+    record->level = level;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    record->timestamp = now.tv_sec;
+    memcpy(record + 1, text, len);
+
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+}
+
+void
+log_write(LOG_LEVEL level, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+
+    if (level == FATAL) {
+        logger_stop();
+    }
+
+    log_ring_t *ring = atomic_load_explicit(&running, memory_order_acquire) ? get_thread_ring() : NULL;
+    if (!ring) {
+        write_sync(level, thread_ring_failed, fmt, args);
+        va_end(args);
+        return;
+    }
+
+    static __thread char line[LOG_LINE_MAX];
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (len < 0) {
+        return;
+    }
+    if (len >= LOG_LINE_MAX) {
+        len = LOG_LINE_MAX - 1;
+    }
+    ring_push(ring, level, line, len);
+}
+
+/*
+ * Flusher side
+ */
+
+typedef struct {
+    int fd;
+    size_t len;
+    char data[LOG_BATCH_SIZE];
+} log_batch_t;
+
+static log_batch_t out_batch = { .fd = STDOUT_FILENO };
+static log_batch_t err_batch = { .fd = STDERR_FILENO };
+
+static void
+batch_flush(log_batch_t *batch)
+{
+    write_all(batch->fd, batch->data, batch->len);
+    batch->len = 0;
+}
+
+static void
+batch_append(LOG_LEVEL level, time_t timestamp, const char *text, size_t len)
+{
+    static time_t cached_second = -1;
+    static char cached_stamp[64];
+    static int cached_len = 0;
+
+    if (timestamp != cached_second) {
+        // Level is appended separately so the cache holds the time only
+        struct tm tm;
+        localtime_r(&timestamp, &tm);
+        cached_len = snprintf(cached_stamp, sizeof(cached_stamp), "%d-%02d-%02dT%02d:%02d:%02dZ\t[",
+                              tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                              tm.tm_hour, tm.tm_min, tm.tm_sec);
+        cached_second = timestamp;
+    }
+
+    log_batch_t *batch = level >= ERROR ? &err_batch : &out_batch;
+    const char *desc = level_desc(level);
+    size_t desc_len = strlen(desc);
+    size_t needed = cached_len + desc_len + 2 + len + 1;
+    if (batch->len + needed > LOG_BATCH_SIZE) {
+        batch_flush(batch);
+    }
+
+    char *p = batch->data + batch->len;
+    memcpy(p, cached_stamp, cached_len);
+    p += cached_len;
+    memcpy(p, desc, desc_len);
+    p += desc_len;
+    *p++ = ']';
+    *p++ = ' ';
+    memcpy(p, text, len);
+    p += len;
+    *p++ = '\n';
+    batch->len = p - batch->data;
+}
+
+static void
+report_drops(log_ring_t *ring)
+{
+    unsigned long dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    if (dropped != ring->reported) {
+        char text[96];
+        int len = snprintf(text, sizeof(text), "Logger dropped %lu lines (ring full)", dropped - ring->reported);
+        batch_append(WARN, time(NULL), text, len);
+        ring->reported = dropped;
+    }
+}
+
+// Returns the number of records written
+static int
+drain_rings(void)
+{
+    int drained = 0;
+    int count = atomic_load_explicit(&ring_count, memory_order_acquire);
+    if (count > LOG_MAX_THREADS) {
+        count = LOG_MAX_THREADS;
+    }
+
+    for (int i = 0; i < count; i++) {
+        log_ring_t *ring = rings[i];
+        if (!ring) {
+            continue;   // Registered but not yet published
+        }
+
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        while (head != tail) {
+            size_t offset = head & (LOG_RING_SIZE - 1);
+            size_t to_end = LOG_RING_SIZE - offset;
+            log_record_t *record = (log_record_t *) (ring->data + offset);
+            if (to_end < sizeof(log_record_t) || record->size == 0) {
+                head += to_end;
+                continue;
+            }
+            batch_append(record->level, record->timestamp, (const char *) (record + 1), record->text_len);
+            head += record->size;
+            drained++;
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+        report_drops(ring);
+    }
+
+    if (out_batch.len) {
+        batch_flush(&out_batch);
+    }
+    if (err_batch.len) {
+        batch_flush(&err_batch);
+    }
+    return drained;
+}
+
+static void *
+flusher_run(void *arg)
+{
+    struct timespec idle = { .tv_sec = 0, .tv_nsec = LOG_IDLE_SLEEP_NS };
+    while (atomic_load_explicit(&running, memory_order_acquire)) {
+        if (drain_rings() == 0) {
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+int
+logger_start(void)
+{
+    if (atomic_load(&running)) {
+        return 0;
+    }
+
+    // stdio buffers could hold lines written before the switch
+    fflush(stdout);
+    fflush(stderr);
+
+    atomic_store(&running, true);
+    if (pthread_create(&flusher, NULL, flusher_run, NULL) != 0) {
+        atomic_store(&running, false);
+        log(ERROR, "Failed to start logger thread, logging synchronously");
+        return -1;
+    }
+    atexit(logger_stop);
+    return 0;
+}
+
+void
+logger_stop(void)
+{
+    static pthread_mutex_t stop_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&stop_lock);
+    if (atomic_exchange(&running, false)) {
+        pthread_join(flusher, NULL);
+        drain_rings();
+    }
+    pthread_mutex_unlock(&stop_lock);
+}
+
+unsigned long
+logger_dropped(void)
+{
+    unsigned long dropped = 0;
+    int count = atomic_load_explicit(&ring_count, memory_order_acquire);
+    for (int i = 0; i < count && i < LOG_MAX_THREADS; i++) {
+        if (rings[i]) {
+            dropped += atomic_load_explicit(&rings[i]->dropped, memory_order_relaxed);
+        }
+    }
+    return dropped;
+}
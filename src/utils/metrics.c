@@ -0,0 +1,440 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "metrics.h"
+
+#define METRICS_MAX_THREADS 256
+#define SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define LATENCY_PENDING_MAX 1024
+
+typedef struct {
+    _Atomic uint64_t counters[COUNTER_COUNT];
+    _Atomic int64_t gauges[GAUGE_COUNT];
+    _Atomic uint64_t buckets[HISTOGRAM_COUNT][METRICS_BUCKETS];
+    _Atomic uint64_t sums[HISTOGRAM_COUNT];
+    _Atomic uint64_t maxes[HISTOGRAM_COUNT];
+} metrics_shard_t;
+
+// A message that produced output on channel, waiting for the flush
+typedef struct {
+    uint64_t ingress_ns;
+    uint64_t message;
+    message_channel_t channel;
+} latency_note_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+} metric_desc_t;
+
+static metrics_shard_t *shards[METRICS_MAX_THREADS];
+static _Atomic int shard_count = 0;
+
+// Threads past METRICS_MAX_THREADS share this one; updates may then race
+static metrics_shard_t overflow_shard;
+
+static __thread metrics_shard_t *thread_shard = NULL;
+
+static __thread uint64_t ingress_ns = 0;     // 0 outside of a handler
+static __thread uint64_t ingress_message = 0;
+static __thread latency_note_t pending[LATENCY_PENDING_MAX];
+static __thread int pending_count = 0;
+
+static const char *phase_labels[] = {"lobby", "night", "day", "voting", "ended"};
+static const char *channel_labels[] = {"announcement", "chat", "werewolf", "whisper", "server"};
+
+static const struct {
+    const char *label;
+    double q;
+} latency_quantiles[] = {
+    {"0.5", 0.5}, {"0.99", 0.99}, {"0.999", 0.999}, {"1", 1.0},
+};
+
+static metrics_shard_t *
+get_shard(void)
+{
+    if (thread_shard) {
+        return thread_shard;
+    }
+
+    int index = atomic_fetch_add(&shard_count, 1);
+    if (index >= METRICS_MAX_THREADS || !(thread_shard = calloc(1, sizeof(metrics_shard_t)))) {
+        log(WARN, "Metrics shard unavailable, sharing the overflow shard");
+        thread_shard = &overflow_shard;
+        return thread_shard;
+    }
+    shards[index] = thread_shard;
+    return thread_shard;
+}
+
+// Single writer per shard: a relaxed load + store is enough and avoids a
+// locked read-modify-write
+static inline void
+shard_add(_Atomic uint64_t *value, uint64_t delta)
+{
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + delta,
+                          memory_order_relaxed);
+}
+
+void
+metrics_add(metric_counter_t counter, uint64_t value)
+{
+    shard_add(&get_shard()->counters[counter], value);
+}
+
+void
+metrics_gauge_add(metric_gauge_t gauge, int64_t delta)
+{
+    _Atomic int64_t *value = &get_shard()->gauges[gauge];
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + delta,
+                          memory_order_relaxed);
+}
+
+static int
+bucket_index(uint64_t value)
+{
+    if (value < SUB_BUCKETS) {
+        return (int) value;
+    }
+    int shift = 63 - __builtin_clzll(value) - METRICS_SUB_BUCKET_BITS;
+    int index = SUB_BUCKETS + shift * SUB_BUCKETS + (int) ((value >> shift) & (SUB_BUCKETS - 1));
+    return index < METRICS_BUCKETS ? index : METRICS_BUCKETS - 1;
+}
+
+// Largest value that lands in bucket index
+static uint64_t
+bucket_upper_bound(int index)
+{
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    int shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    int sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    return ((uint64_t) (SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void
+metrics_observe(metric_histogram_t histogram, uint64_t value)
+{
+    metrics_shard_t *shard = get_shard();
+    shard_add(&shard->buckets[histogram][bucket_index(value)], 1);
+    shard_add(&shard->sums[histogram], value);
+    if (value > atomic_load_explicit(&shard->maxes[histogram], memory_order_relaxed)) {
+        atomic_store_explicit(&shard->maxes[histogram], value, memory_order_relaxed);
+    }
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void
+metrics_ingress_begin(void)
+{
+    ingress_ns = now_ns();
+}
+
+void
+metrics_ingress_message(void)
+{
+    ingress_message++;
+}
+
+void
+metrics_ingress_end(void)
+{
+    ingress_ns = 0;
+}
+
+void
+metrics_latency_note(message_channel_t channel)
+{
+    if (!ingress_ns) {
+        return;
+    }
+
+    // Several sends for one message (a whisper and its echo, a role burst)
+    // count once, completed by the last of them
+    for (int i = pending_count - 1; i >= 0 && pending[i].message == ingress_message; i--) {
+        if (pending[i].channel == channel) {
+            return;
+        }
+    }
+
+    if (pending_count == LATENCY_PENDING_MAX) {
+        metrics_latency_flush();
+    }
+    pending[pending_count].ingress_ns = ingress_ns;
+    pending[pending_count].message = ingress_message;
+    pending[pending_count].channel = channel;
+    pending_count++;
+}
+
+void
+metrics_latency_flush(void)
+{
+    if (pending_count == 0) {
+        return;
+    }
+
+    uint64_t now = now_ns();
+    for (int i = 0; i < pending_count; i++) {
+        metrics_observe(HISTOGRAM_LATENCY_US + pending[i].channel, (now - pending[i].ingress_ns) / 1000);
+    }
+    pending_count = 0;
+}
+
+/*
+ * Rendering
+ */
+
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t len;
+} render_t;
+
+static void __attribute__((format(printf, 2, 3)))
+emit(render_t *out, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    size_t room = out->len < out->size ? out->size - out->len : 0;
+    int n = vsnprintf(room ? out->buffer + out->len : NULL, room, fmt, args);
+    va_end(args);
+    if (n > 0) {
+        out->len += n;
+    }
+}
+
+static void
+emit_header(render_t *out, const char *name, const char *type, const char *help)
+{
+    emit(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static uint64_t
+sum_counter(int counter)
+{
+    uint64_t total = atomic_load_explicit(&overflow_shard.counters[counter], memory_order_relaxed);
+    int count = atomic_load(&shard_count);
+    for (int i = 0; i < count && i < METRICS_MAX_THREADS; i++) {
+        if (shards[i]) {
+            total += atomic_load_explicit(&shards[i]->counters[counter], memory_order_relaxed);
+        }
+    }
+    return total;
+}
+
+static int64_t
+sum_gauge(int gauge)
+{
+    int64_t total = atomic_load_explicit(&overflow_shard.gauges[gauge], memory_order_relaxed);
+    int count = atomic_load(&shard_count);
+    for (int i = 0; i < count && i < METRICS_MAX_THREADS; i++) {
+        if (shards[i]) {
+            total += atomic_load_explicit(&shards[i]->gauges[gauge], memory_order_relaxed);
+        }
+    }
+    return total;
+}
+
+typedef struct {
+    uint64_t buckets[METRICS_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} histogram_snapshot_t;
+
+static void
+add_shard_histogram(histogram_snapshot_t *snapshot, metrics_shard_t *shard, int histogram)
+{
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        uint64_t n = atomic_load_explicit(&shard->buckets[histogram][b], memory_order_relaxed);
+        snapshot->buckets[b] += n;
+        snapshot->count += n;
+    }
+    snapshot->sum += atomic_load_explicit(&shard->sums[histogram], memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&shard->maxes[histogram], memory_order_relaxed);
+    if (max > snapshot->max) {
+        snapshot->max = max;
+    }
+}
+
+static void
+sum_histogram(int histogram, histogram_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    add_shard_histogram(snapshot, &overflow_shard, histogram);
+
+    int count = atomic_load(&shard_count);
+    for (int i = 0; i < count && i < METRICS_MAX_THREADS; i++) {
+        if (shards[i]) {
+            add_shard_histogram(snapshot, shards[i], histogram);
+        }
+    }
+}
+
+// Upper bound of the bucket holding the q-th quantile, capped at the max
+static uint64_t
+snapshot_quantile(const histogram_snapshot_t *snapshot, double q)
+{
+    if (snapshot->count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t) (q * snapshot->count);
+    if (rank >= snapshot->count) {
+        rank = snapshot->count - 1;
+    }
+    uint64_t seen = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        seen += snapshot->buckets[b];
+        if (seen > rank) {
+            uint64_t bound = bucket_upper_bound(b);
+            return bound < snapshot->max ? bound : snapshot->max;
+        }
+    }
+    return snapshot->max;
+}
+
+// Cumulative buckets, only where the count changes, plus +Inf
+static void
+emit_histogram(render_t *out, const char *name, const char *labels, int histogram)
+{
+    histogram_snapshot_t snapshot;
+    sum_histogram(histogram, &snapshot);
+    uint64_t sum = snapshot.sum;
+
+    const char *sep = labels[0] ? "," : "";
+    uint64_t cumulative = 0;
+    for (int b = 0; b < METRICS_BUCKETS - 1; b++) {
+        if (snapshot.buckets[b] == 0) {
+            continue;
+        }
+        cumulative += snapshot.buckets[b];
+        emit(out, "%s_bucket{%s%sle=\"%llu\"} %llu\n", name, labels, sep,
+             (unsigned long long) bucket_upper_bound(b), (unsigned long long) cumulative);
+    }
+    cumulative += snapshot.buckets[METRICS_BUCKETS - 1];
+    emit(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long) cumulative);
+    if (labels[0]) {
+        emit(out, "%s_sum{%s} %llu\n", name, labels, (unsigned long long) sum);
+        emit(out, "%s_count{%s} %llu\n", name, labels, (unsigned long long) cumulative);
+    } else {
+        emit(out, "%s_sum %llu\n", name, (unsigned long long) sum);
+        emit(out, "%s_count %llu\n", name, (unsigned long long) cumulative);
+    }
+}
+
+static void
+emit_counter(render_t *out, const char *name, const char *help, int counter)
+{
+    emit_header(out, name, "counter", help);
+    emit(out, "%s %llu\n", name, (unsigned long long) sum_counter(counter));
+}
+
+size_t
+metrics_render(char *buffer, size_t size)
+{
+    render_t out = { .buffer = buffer, .size = size, .len = 0 };
+    char labels[64];
+
+    emit_counter(&out, "werewolf_connections_accepted_total", "Connections seated in a room",
+                 COUNTER_CONNECTIONS_ACCEPTED);
+    emit_counter(&out, "werewolf_connections_rejected_total", "Connections turned away (no open room)",
+                 COUNTER_CONNECTIONS_REJECTED);
+
+    emit_header(&out, "werewolf_connections", "gauge", "Connected players");
+    emit(&out, "werewolf_connections %lld\n", (long long) sum_gauge(GAUGE_CONNECTIONS));
+
+    emit_header(&out, "werewolf_accept_queue_depth", "gauge",
+                "Connections waiting in the listen queues after the last accept batch");
+    emit(&out, "werewolf_accept_queue_depth %lld\n", (long long) sum_gauge(GAUGE_ACCEPT_QUEUE));
+    emit_header(&out, "werewolf_accept_batch_connections", "histogram", "Connections accepted per wakeup");
+    emit_histogram(&out, "werewolf_accept_batch_connections", "", HISTOGRAM_ACCEPT_BATCH);
+
+    emit_header(&out, "werewolf_messages_total", "counter", "Messages sent, by channel");
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        emit(&out, "werewolf_messages_total{channel=\"%s\"} %llu\n", channel_labels[c],
+             (unsigned long long) sum_counter(COUNTER_MESSAGES + c));
+    }
+
+    emit_counter(&out, "werewolf_bytes_sent_total", "Bytes written to client sockets", COUNTER_BYTES_SENT);
+    emit_counter(&out, "werewolf_send_eagain_total", "Sends that found the socket buffer full",
+                 COUNTER_SEND_EAGAIN);
+    emit_counter(&out, "werewolf_send_errors_total", "Sends that failed", COUNTER_SEND_ERRORS);
+
+    emit_header(&out, "werewolf_rooms", "gauge", "Rooms by game phase");
+    for (int p = 0; p <= GAME_STATE_ENDED; p++) {
+        emit(&out, "werewolf_rooms{phase=\"%s\"} %lld\n", phase_labels[p],
+             (long long) sum_gauge(GAUGE_ROOMS + p));
+    }
+
+    emit_header(&out, "werewolf_fanout_recipients", "histogram", "Recipients per broadcast");
+    emit_histogram(&out, "werewolf_fanout_recipients", "", HISTOGRAM_FANOUT);
+
+    emit_header(&out, "werewolf_phase_duration_ms", "histogram", "Time rooms spent in each phase");
+    for (int p = 0; p <= GAME_STATE_ENDED; p++) {
+        snprintf(labels, sizeof(labels), "phase=\"%s\"", phase_labels[p]);
+        emit_histogram(&out, "werewolf_phase_duration_ms", labels, HISTOGRAM_PHASE_DURATION_MS + p);
+    }
+
+    emit_header(&out, "werewolf_message_latency_us", "histogram",
+                "Ingress to last reply handed to the kernel, by channel");
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        snprintf(labels, sizeof(labels), "channel=\"%s\"", channel_labels[c]);
+        emit_histogram(&out, "werewolf_message_latency_us", labels, HISTOGRAM_LATENCY_US + c);
+    }
+
+    emit_header(&out, "werewolf_message_latency_quantile_us", "gauge",
+                "Latency quantiles by channel (quantile 1 is the max)");
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        histogram_snapshot_t snapshot;
+        sum_histogram(HISTOGRAM_LATENCY_US + c, &snapshot);
+        for (size_t q = 0; q < sizeof(latency_quantiles) / sizeof(latency_quantiles[0]); q++) {
+            emit(&out, "werewolf_message_latency_quantile_us{channel=\"%s\",quantile=\"%s\"} %llu\n",
+                 channel_labels[c], latency_quantiles[q].label,
+                 (unsigned long long) snapshot_quantile(&snapshot, latency_quantiles[q].q));
+        }
+    }
+
+    emit_header(&out, "werewolf_log_dropped_total", "counter", "Log lines dropped because a ring was full");
+    emit(&out, "werewolf_log_dropped_total %lu\n", logger_dropped());
+
+    return out.len;
+}
+
+void
+metrics_summarize(metric_histogram_t histogram, metrics_summary_t *summary)
+{
+    histogram_snapshot_t snapshot;
+    sum_histogram(histogram, &snapshot);
+    summary->count = snapshot.count;
+    summary->p50 = snapshot_quantile(&snapshot, 0.5);
+    summary->p99 = snapshot_quantile(&snapshot, 0.99);
+    summary->p999 = snapshot_quantile(&snapshot, 0.999);
+    summary->max = snapshot.max;
+}
+
+void
+metrics_log_latency(void)
+{
+    // Straight to stderr rather than through the logger: release builds
+    // compile INFO out, and this is a dump someone asked for
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        metrics_summary_t summary;
+        metrics_summarize(HISTOGRAM_LATENCY_US + c, &summary);
+        fprintf(stderr, "Latency %-12s count %llu  p50 %lluus  p99 %lluus  p999 %lluus  max %lluus\n",
+                channel_labels[c], (unsigned long long) summary.count, (unsigned long long) summary.p50,
+                (unsigned long long) summary.p99, (unsigned long long) summary.p999,
+                (unsigned long long) summary.max);
+    }
+}
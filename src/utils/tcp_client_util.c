@@ -6,7 +6,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/socket.h>
-#include <sys/select.h>
+#include <poll.h>
 #include "logger.h"
 #include "defs.h"
 #include "util.h"
@@ -101,16 +101,10 @@ tcp_client_socket(const char *host, const char *port)
 
         if (connect(sockfd, paddr->ai_addr, paddr->ai_addrlen) < 0) {
             if (errno == EINPROGRESS) {
-                // Connection in progress, wait for it to complete
-                fd_set write_fds;
-                struct timeval tv;
-                tv.tv_sec = CONNECT_TIMEOUT_SEC;
-                tv.tv_usec = 0;
-
-                FD_ZERO(&write_fds);
-                FD_SET(sockfd, &write_fds);
-
-                int ret = select(sockfd + 1, NULL, &write_fds, NULL, &tv);
+                // Connection in progress, wait for it to complete.
+                // poll() rather than select() so fds above FD_SETSIZE work.
+                struct pollfd pfd = { .fd = sockfd, .events = POLLOUT };
+                int ret = poll(&pfd, 1, CONNECT_TIMEOUT_SEC * 1000);
                 if (ret <= 0) {
                     log(ERROR, "Connection timeout");
                     close(sockfd);
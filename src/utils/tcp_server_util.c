@@ -1,3 +1,4 @@
+#define _GNU_SOURCE  // SO_REUSEPORT, accept4
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -5,70 +6,13 @@
 #include <errno.h>
 #include <string.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <stdlib.h>
 #include "logger.h"
 #include "defs.h"
 #include "util.h" 
 #include "tcp_server_util.h"
 
-static char addr_buff[MAX_ADDR_BUFF];
-
-client_fd_list_t *
-add_client_fd(client_fd_list_t *client_fd_list, int client_socket)
-{
-    client_fd_list_t *new_node = malloc(sizeof(client_fd_list_t));
-    if (!new_node) {
-        log(ERROR, "Failed to allocate memory for new client");
-        return client_fd_list;
-    }
-    new_node->fd = client_socket;
-    new_node->next = client_fd_list;
-    return new_node;
-}
-
-client_fd_list_t *
-remove_client_fd(client_fd_list_t *client_fd_list, int client_socket)
-{
-    if (!client_fd_list) {
-        return NULL;
-    }
-
-    if (client_fd_list->fd == client_socket) {
-        client_fd_list_t *next = client_fd_list->next;
-        log(INFO, "Removing client %d from list", client_socket);
-        free(client_fd_list);
-        return next;
-    }
-
-    client_fd_list_t *current = client_fd_list;
-    while (current->next) {
-        if (current->next->fd == client_socket) {
-            client_fd_list_t *next = current->next->next;
-            log(INFO, "Removing client %d from list", client_socket);
-            free(current->next);
-            current->next = next;
-            break;
-        }
-        current = current->next;
-    }
-    return client_fd_list;
-}
-
-bool
-is_socket_connected(int sockfd)
-{
-    int error = 0;
-    socklen_t len = sizeof(error);
-    int retval = getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &len);
-    if (retval != 0) {
-        return false;
-    }
-    if (error != 0) {
-        return false;
-    }
-    return true;
-}
-
 int
 validate_server_input(const char *host, const char *service)
 {
@@ -94,7 +38,7 @@ validate_server_input(const char *host, const char *service)
 }
 
 int
-set_server_socket_options(int sockfd, int family)
+set_server_socket_options(int sockfd, int family, bool reuse_port)
 {
     int optval = 1;
 
@@ -104,6 +48,12 @@ set_server_socket_options(int sockfd, int family)
         return RET_ERROR;
     }
 
+    // Several listeners on the same port; the kernel spreads connections across them
+    if (reuse_port && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) < 0) {
+        log(ERROR, "setsockopt(SO_REUSEPORT) failed: %s", strerror(errno));
+        return RET_ERROR;
+    }
+
     // For IPv6, set IPV6_V6ONLY to true
     if (family == AF_INET6) {
         if (setsockopt(sockfd, SOL_IPV6, IPV6_V6ONLY, &optval, sizeof(optval)) < 0) {
@@ -120,41 +70,52 @@ set_server_socket_options(int sockfd, int family)
 }
 
 int
-accept_tcp_connection(int server_socket)
+accept_tcp_connections(int server_socket, int *client_sockets, int max)
 {
+    char addr_buff[MAX_ADDR_BUFF];
     struct sockaddr_storage client_addr;
-    socklen_t client_addr_len = sizeof(client_addr);
-
-    int client_socket = accept(server_socket, (struct sockaddr *) &client_addr, &client_addr_len);
-    if (client_socket < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            // No pending connections
-            return RET_ERROR;
+    int count = 0;
+
+    while (count < max) {
+        socklen_t client_addr_len = sizeof(client_addr);
+        // Non-blocking and close-on-exec in the same call, no fcntl round trips
+        int client_socket = accept4(server_socket, (struct sockaddr *) &client_addr, &client_addr_len,
+                                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log(ERROR, "accept4() failed: %s", strerror(errno));
+            }
+            break;
         }
-        log(ERROR, "accept() failed: %s", strerror(errno));
-        return RET_ERROR;
-    }
 
-    if (set_nonblocking(client_socket) < 0) {
-        close(client_socket);
-        return RET_ERROR;
+        if (DEBUG >= LOG_MIN_LEVEL && current_level <= DEBUG &&
+            print_socket_address((struct sockaddr *) &client_addr, addr_buff) == RET_SUCCESS) {
+            log(DEBUG, "New connection from %s", addr_buff);
+        }
+        client_sockets[count++] = client_socket;
     }
+    return count;
+}
 
-    if (set_socket_timeout(client_socket, MAX_TIMEOUT) < 0) { 
-        close(client_socket);
+int
+accept_queue_depth(int server_socket)
+{
+    // On a listener, tcpi_unacked is the accept queue length
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    if (getsockopt(server_socket, IPPROTO_TCP, TCP_INFO, &info, &len) < 0) {
         return RET_ERROR;
     }
-
-    if (print_socket_address((struct sockaddr *) &client_addr, addr_buff) == RET_SUCCESS) {
-        log(INFO, "New connection from %s", addr_buff);
-    }
-
-    return client_socket;
+    return (int) info.tcpi_unacked;
 }
 
 int
-setup_tcp_server(const char *host, const char *service, int max_backlog)
+setup_tcp_server(const char *host, const char *service, int max_backlog, bool reuse_port)
 {
+    char addr_buff[MAX_ADDR_BUFF];
     if (validate_server_input(host, service) < 0) {
         return RET_ERROR;
     }
@@ -181,7 +142,7 @@ setup_tcp_server(const char *host, const char *service, int max_backlog)
             continue;
         }
 
-        if (set_server_socket_options(sockfd, aip->ai_family) < 0) {
+        if (set_server_socket_options(sockfd, aip->ai_family, reuse_port) < 0) {
             close(sockfd);
             continue;
         }
@@ -0,0 +1,262 @@
+#include <stdlib.h>
+#include <time.h>
+#include "logger.h"
+#include "timer_wheel.h"
+
+#define SLOT_BITS 6
+#define SLOTS (1 << SLOT_BITS)
+#define SLOT_MASK (SLOTS - 1)
+#define MAX_DELAY_TICKS ((1ull << (SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+typedef struct timer_wheel_cdt {
+    // Slot lists are circular with the slot itself as the sentinel
+    wheel_timer_t slots[TIMER_WHEEL_LEVELS][SLOTS];
+    uint64_t occupied[TIMER_WHEEL_LEVELS];  // One bit per non-empty slot
+    uint64_t current;       // Next tick to process; everything before has fired
+    uint64_t now_ms;        // Time of the last advance
+    int count;
+} timer_wheel_cdt;
+
+uint64_t
+timer_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+timer_wheel_t
+timer_wheel_create(uint64_t now_ms)
+{
+    timer_wheel_cdt *wheel = malloc(sizeof(timer_wheel_cdt));
+    if (!wheel) {
+        log(ERROR, "Failed to allocate memory for timer wheel");
+        return NULL;
+    }
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int i = 0; i < SLOTS; i++) {
+            wheel->slots[level][i].next = &wheel->slots[level][i];
+            wheel->slots[level][i].prev = &wheel->slots[level][i];
+        }
+        wheel->occupied[level] = 0;
+    }
+    wheel->now_ms = now_ms;
+    wheel->current = now_ms / TIMER_WHEEL_TICK_MS;
+    wheel->count = 0;
+    return wheel;
+}
+
+// Pending timers belong to their owners; they are just forgotten
+void
+timer_wheel_destroy(timer_wheel_t wheel)
+{
+    free(wheel);
+}
+
+void
+timer_init(wheel_timer_t *timer, timer_callback_t callback, void *arg)
+{
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+static void
+unlink_timer(timer_wheel_t wheel, wheel_timer_t *timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+
+    int level = timer->slot / SLOTS;
+    int index = timer->slot % SLOTS;
+    wheel_timer_t *head = &wheel->slots[level][index];
+    if (head->next == head) {
+        wheel->occupied[level] &= ~(1ull << index);
+    }
+    wheel->count--;
+}
+
+// Files timer under the finest level whose range covers its deadline
+static void
+link_timer(timer_wheel_t wheel, wheel_timer_t *timer)
+{
+    uint64_t delta = timer->expires - wheel->current;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    int index = (int) ((timer->expires >> (SLOT_BITS * level)) & SLOT_MASK);
+
+    wheel_timer_t *head = &wheel->slots[level][index];
+    timer->slot = level * SLOTS + index;
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+    wheel->occupied[level] |= 1ull << index;
+    wheel->count++;
+}
+
+void
+timer_wheel_schedule(timer_wheel_t wheel, wheel_timer_t *timer, uint64_t delay_ms)
+{
+    if (timer_pending(timer)) {
+        unlink_timer(wheel, timer);
+    }
+
+    // From the clock, not the last advance: handlers run after a poll that
+    // may have slept for seconds. Rounded up so a timer never fires early.
+    uint64_t expires = (timer_now_ms() + delay_ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    if (expires < wheel->current) {
+        expires = wheel->current;
+    }
+    if (expires - wheel->current > MAX_DELAY_TICKS) {
+        expires = wheel->current + MAX_DELAY_TICKS;
+    }
+    timer->expires = expires;
+    link_timer(wheel, timer);
+}
+
+void
+timer_wheel_cancel(timer_wheel_t wheel, wheel_timer_t *timer)
+{
+    if (timer_pending(timer)) {
+        unlink_timer(wheel, timer);
+    }
+}
+
+// Re-files every timer of a coarse slot, which lands them a level lower
+static void
+cascade(timer_wheel_t wheel, int level, int index)
+{
+    wheel_timer_t *head = &wheel->slots[level][index];
+    while (head->next != head) {
+        wheel_timer_t *timer = head->next;
+        unlink_timer(wheel, timer);
+        link_timer(wheel, timer);
+    }
+}
+
+static int
+fire_slot(timer_wheel_t wheel, int index)
+{
+    // Detached first: a callback may arm a timer 64 ticks out, which files
+    // into this same slot and must not fire in this pass
+    wheel_timer_t *head = &wheel->slots[0][index];
+    wheel_timer_t due;
+    due.next = head->next;
+    due.prev = head->prev;
+    due.next->prev = &due;
+    due.prev->next = &due;
+    head->next = head;
+    head->prev = head;
+    wheel->occupied[0] &= ~(1ull << index);
+
+    // Callbacks see the tick as done, so a timer they arm lands in a later one
+    wheel->current++;
+    int fired = 0;
+    while (due.next != &due) {
+        wheel_timer_t *timer = due.next;
+        unlink_timer(wheel, timer);
+        timer->callback(timer->arg);
+        fired++;
+    }
+    return fired;
+}
+
+int
+timer_wheel_advance(timer_wheel_t wheel, uint64_t now_ms)
+{
+    uint64_t target = now_ms / TIMER_WHEEL_TICK_MS;
+    int fired = 0;
+    if (now_ms > wheel->now_ms) {
+        wheel->now_ms = now_ms;
+    }
+
+    while (wheel->current <= target) {
+        if (wheel->count == 0) {
+            wheel->current = target + 1;
+            break;
+        }
+
+        uint64_t tick = wheel->current;
+        if ((tick & SLOT_MASK) == 0) {
+            for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                int index = (int) ((tick >> (SLOT_BITS * level)) & SLOT_MASK);
+                cascade(wheel, level, index);
+                if (index != 0) {
+                    break;
+                }
+            }
+        }
+
+        int index = (int) (tick & SLOT_MASK);
+        if (wheel->occupied[0] & (1ull << index)) {
+            fired += fire_slot(wheel, index);
+        } else if (wheel->occupied[0] == 0) {
+            // Nothing until the next cascade: skip to it
+            uint64_t next = (tick | SLOT_MASK) + 1;
+            wheel->current = next < target + 1 ? next : target + 1;
+        } else {
+            wheel->current++;
+        }
+    }
+    return fired;
+}
+
+uint64_t
+timer_wheel_now_ms(timer_wheel_t wheel)
+{
+    return wheel->now_ms;
+}
+
+// Distance from index to the next occupied slot at or after it, circularly
+static int
+next_occupied(uint64_t occupied, int index)
+{
+    uint64_t rotated = (occupied >> index) | (index ? occupied << (SLOTS - index) : 0);
+    return __builtin_ctzll(rotated);
+}
+
+int
+timer_wheel_timeout_ms(timer_wheel_t wheel, uint64_t now_ms)
+{
+    if (wheel->count == 0) {
+        return -1;
+    }
+
+    uint64_t due = UINT64_MAX;
+    if (wheel->occupied[0]) {
+        due = wheel->current + next_occupied(wheel->occupied[0], (int) (wheel->current & SLOT_MASK));
+    }
+    // A coarse slot needs attention when it cascades, at the start of its span
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        if (!wheel->occupied[level]) {
+            continue;
+        }
+        int shift = SLOT_BITS * level;
+        uint64_t block = wheel->current >> shift;
+        int index = (int) (block & SLOT_MASK);
+        // The slot at index itself only comes round again a full turn later
+        int distance = next_occupied(wheel->occupied[level], (index + 1) & SLOT_MASK) + 1;
+        uint64_t cascade_tick = (block + distance) << shift;
+        if ((wheel->current & ((1ull << shift) - 1)) == 0 &&
+            (wheel->occupied[level] & (1ull << index))) {
+            cascade_tick = wheel->current;      // Its cascade is the very next tick
+        }
+        if (cascade_tick < due) {
+            due = cascade_tick;
+        }
+    }
+
+    uint64_t due_ms = due * TIMER_WHEEL_TICK_MS;
+    if (due_ms <= now_ms) {
+        return 0;
+    }
+    uint64_t timeout = due_ms - now_ms;
+    return timeout > 1000000000 ? 1000000000 : (int) timeout;
+}
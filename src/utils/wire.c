@@ -0,0 +1,104 @@
+#include <string.h>
+#include "defs.h"
+#include "wire.h"
+
+#define HELLO_MAGIC_0 'W'
+#define HELLO_MAGIC_1 'W'
+
+void
+wire_encode_hello(char out[WIRE_HELLO_SIZE], int version)
+{
+    out[0] = WIRE_OP_HELLO;
+    out[1] = HELLO_MAGIC_0;
+    out[2] = HELLO_MAGIC_1;
+    out[3] = (char) version;
+}
+
+int
+wire_decode_hello(const char *payload, size_t len)
+{
+    if (len != WIRE_HELLO_SIZE || payload[0] != WIRE_OP_HELLO ||
+        payload[1] != HELLO_MAGIC_0 || payload[2] != HELLO_MAGIC_1 || payload[3] <= 0) {
+        return RET_ERROR;
+    }
+    return (unsigned char) payload[3];
+}
+
+static size_t
+put_varint(uint8_t *out, uint32_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t) value;
+    return n;
+}
+
+static int
+get_varint(const uint8_t **cursor, const uint8_t *end, uint32_t *value)
+{
+    const uint8_t *p = *cursor;
+    // Player numbers and most lengths fit in one byte
+    if (p < end && *p < 0x80) {
+        *value = *p;
+        *cursor = p + 1;
+        return RET_SUCCESS;
+    }
+
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        result |= (uint32_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            *cursor = p;
+            return RET_SUCCESS;
+        }
+    }
+    return RET_ERROR;
+}
+
+size_t
+wire_encode(char *out, size_t size, const wire_record_t *record)
+{
+    uint8_t header[WIRE_MAX_HEADER];
+    size_t n = 0;
+    header[n++] = record->opcode;
+    header[n++] = record->channel;
+    n += put_varint(header + n, record->player);
+    n += put_varint(header + n, record->target);
+    n += put_varint(header + n, (uint32_t) record->text_len);
+
+    if (n + record->text_len > size) {
+        return 0;
+    }
+    memcpy(out, header, n);
+    memcpy(out + n, record->text, record->text_len);
+    return n + record->text_len;
+}
+
+int
+wire_decode(const char *payload, size_t len, wire_record_t *record)
+{
+    const uint8_t *p = (const uint8_t *) payload;
+    const uint8_t *end = p + len;
+    uint32_t text_len;
+
+    if (len < 2 || p[0] == WIRE_OP_HELLO || p[0] >= WIRE_OP_COUNT) {
+        return RET_ERROR;
+    }
+    record->opcode = p[0];
+    record->channel = p[1];
+    p += 2;
+    if (get_varint(&p, end, &record->player) < 0 ||
+        get_varint(&p, end, &record->target) < 0 ||
+        get_varint(&p, end, &text_len) < 0 ||
+        text_len != (size_t) (end - p)) {
+        return RET_ERROR;
+    }
+    record->text = (const char *) p;
+    record->text_len = text_len;
+    return RET_SUCCESS;
+}